@@ -13,12 +13,26 @@ namespace klee {
 
 extern llvm::cl::opt<bool> UseFastCexSolver;
 
+extern llvm::cl::opt<bool> UseRealRelaxationSolver;
+
+extern llvm::cl::opt<bool> UseIntegralFloatSolver;
+
 extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver; 
 
+extern llvm::cl::opt<bool> UseAdaptiveSolverChain;
+
+/// Number of queries over which the adaptive solver chain measures a layer.
+/// Defined in lib/Solver.
+extern llvm::cl::opt<unsigned> AdaptiveSolverWindow;
+
+/// Growth in megabytes after which a Z3 context is recreated.
+/// Defined in lib/Solver.
+extern llvm::cl::opt<unsigned> MaxZ3ContextMemory;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
   
 extern llvm::cl::opt<int> MinQueryTimeToLog;
@@ -29,6 +43,14 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+/// Flush subnormal float and double values to zero (FTZ/DAZ) in constant
+/// folding, external calls and the Z3 encoding. Defined in lib/Expr.
+extern llvm::cl::opt<bool> FlushDenormals;
+
+/// Fold fabs and fneg through float bitcasts as sign-bit operations, which
+/// assumes bitcasts keep NaN payloads. Defined in lib/Expr.
+extern llvm::cl::opt<bool> BitPreservingNaN;
+
 ///The different query logging solvers that can switched on/off
 enum QueryLoggingSolverType
 {
@@ -42,8 +42,13 @@ struct StackFrame {
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
+  /// The registers of the frame, owned by the RegisterStack of the state.
   Cell *locals;
 
+  /// The address of the block holding the fixed-size allocas of the entry
+  /// block, or zero until the first of them executes.
+  uint64_t frameAddress;
+
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
   /// quickly compute the context sensitive minimum distance to an
@@ -58,9 +63,32 @@ struct StackFrame {
   // of intrinsic lowering.
   MemoryObject *varargs;
 
-  StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
+  StackFrame(KInstIterator caller, KFunction *kf, Cell *locals);
+};
+
+/// The register files of the frames of a state. They are carved out of
+/// chunks that never move and are released in LIFO order, so that calls
+/// and returns do not allocate.
+class RegisterStack {
+  struct Chunk {
+    Cell *cells;
+    unsigned size, used;
+  };
+  std::vector<Chunk> chunks;
+  /// The chunk registers are allocated from.
+  unsigned top;
+
+  RegisterStack(const RegisterStack &);
+  RegisterStack &operator=(const RegisterStack &);
+
+public:
+  RegisterStack() : top(0) {}
+  ~RegisterStack();
+
+  /// Returns \a n registers holding no value.
+  Cell *allocate(unsigned n);
+  /// Releases the \a n registers allocated last, at \a cells.
+  void release(Cell *cells, unsigned n);
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -74,6 +102,8 @@ private:
 
   std::map<std::string, std::string> fnAliases;
 
+  RegisterStack registers;
+
 public:
   // Execution - Control Flow specific
 
@@ -139,6 +169,14 @@ public:
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
 
+  /// @brief Position of this state in the executor's StateSet
+  unsigned stateSetSlot;
+
+  /// @brief Instruction and call path node at which this state is counted in
+  /// the States statistic, maintained by the StatsTracker
+  const InstructionInfo *countedInfo;
+  CallPathNode *countedCallPathNode;
+
   /// @brief Ordered list of symbolics: used to generate test cases.
   //
   // FIXME: Move to a shared list structure (not critical).
@@ -148,14 +186,24 @@ public:
   std::set<std::string> arrayNames;
 
   std::string getFnAlias(std::string fn);
+  bool hasFnAliases() const { return !fnAliases.empty(); }
   void addFnAlias(std::string old_fn, std::string new_fn);
   void removeFnAlias(std::string fn);
 
   llvm::APFloat::roundingMode roundingMode;
+  /// @brief The FE_* rounding mode as an Int32 expression while it is
+  /// symbolic (-symbolic-rounding-mode), null while roundingMode holds it
+  ref<Expr> symbolicRoundingMode;
   fenv_t fEnv;
 
+  /// @brief Set once the state executed an x86_fp80 instruction with double
+  /// precision (-long-double-as-double)
+  bool longDoubleDowngraded;
+
 private:
-  ExecutionState() : uniqueID(0), ptreeNode(0), roundingMode(llvm::APFloat::rmNearestTiesToEven) {
+  ExecutionState() : uniqueID(0), ptreeNode(0), stateSetSlot(0),
+                     countedInfo(0), countedCallPathNode(0), roundingMode(llvm::APFloat::rmNearestTiesToEven),
+                     longDoubleDowngraded(false) {
     fegetenv(&fEnv);
   }
 
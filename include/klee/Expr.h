@@ -214,7 +214,10 @@ public:
     FMin,
     FMax,
 
-    LastKind=FMax,
+    // Fused arithmetic
+    FFma,
+
+    LastKind=FFma,
 
     CastKindFirst=ZExt,
     CastKindLast=ExplicitInt,
@@ -1000,6 +1003,7 @@ public:
   int compareContents(const Expr &b) const {
     const CastRoundExpr &eb = static_cast<const CastRoundExpr&>(b);
     if (width != eb.width) return width < eb.width ? -1 : 1;
+    if (round != eb.round) return round < eb.round ? -1 : 1;
     return 0;
   }
 
@@ -1447,6 +1451,7 @@ public:
   int compareContents(const Expr &b) const {
     const FCastRoundExpr &eb = static_cast<const FCastRoundExpr&>(b);
     if (width != eb.width) return width < eb.width ? -1 : 1;
+    if (round != eb.round) return round < eb.round ? -1 : 1;
     return 0;
   }
 
@@ -1583,7 +1588,8 @@ public:
 	                                                                                            \
   protected:                                                                                    \
     virtual int compareContents(const Expr &b) const {                                          \
-      /* No attributes to compare. */                                                           \
+      const FUnaryRoundExpr &eb = static_cast<const FUnaryRoundExpr&>(b);                       \
+      if (round != eb.round) return round < eb.round ? -1 : 1;                                  \
       return 0;                                                                                 \
     }                                                                                           \
 };
@@ -1701,7 +1707,8 @@ public:
 	                                                                                                 \
   protected:                                                                                         \
     virtual int compareContents(const Expr &b) const {                                               \
-      /* No attributes to compare. */                                                                \
+      const FBinaryRoundExpr &eb = static_cast<const FBinaryRoundExpr&>(b);                          \
+      if (round != eb.round) return round < eb.round ? -1 : 1;                                       \
       return 0;                                                                                      \
     }                                                                                                \
 };                                                                                                   \
@@ -1771,6 +1778,65 @@ protected:
   }
 };
 
+/// Class representing a fused multiply-add, i.e. left * right + addend
+/// rounded only once.
+class FFmaExpr : public FNonConstantExpr {
+public:
+  static const Kind kind = FFma;
+  static const unsigned numKids = 3;
+
+public:
+  ref<Expr> left, right, addend;
+  llvm::APFloat::roundingMode round;
+
+public:
+  static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r,
+                         const ref<Expr> &a, llvm::APFloat::roundingMode rm) {
+    ref<Expr> res(new FFmaExpr(l, r, a, rm));
+    res->computeHash();
+    return res;
+  }
+
+  static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r,
+                          const ref<Expr> &a, llvm::APFloat::roundingMode rm);
+
+  Width getWidth() const { return left->getWidth(); }
+  Kind getKind() const { return FFma; }
+  llvm::APFloat::roundingMode getRoundingMode() const { return round; }
+
+  unsigned getNumKids() const { return numKids; }
+  ref<Expr> getKid(unsigned i) const {
+    switch (i) {
+    case 0: return left;
+    case 1: return right;
+    case 2: return addend;
+    default: return 0;
+    }
+  }
+
+  virtual ref<Expr> rebuild(ref<Expr> kids[]) const {
+    return create(kids[0], kids[1], kids[2], round);
+  }
+
+private:
+  FFmaExpr(const ref<Expr> &l, const ref<Expr> &r, const ref<Expr> &a,
+           llvm::APFloat::roundingMode rm)
+    : left(l), right(r), addend(a), round(rm) {}
+
+public:
+  static bool classof(const Expr *E) {
+    return E->getKind() == Expr::FFma;
+  }
+  static bool classof(const FFmaExpr *) { return true; }
+
+protected:
+  virtual int compareContents(const Expr &b) const {
+    const FFmaExpr &eb = static_cast<const FFmaExpr&>(b);
+    if (round != eb.round) return round < eb.round ? -1 : 1;
+    return 0;
+  }
+};
+
 class FConstantExpr : public FExpr {
 public:
   static const Kind kind = FConstant;
@@ -1857,6 +1923,8 @@ public:
   ref<FConstantExpr> FMul(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM);
   ref<FConstantExpr> FDiv(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM);
   ref<FConstantExpr> FRem(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM);
+  ref<FConstantExpr> FFma(const ref<FConstantExpr> &RHS, const ref<FConstantExpr> &Addend,
+                          llvm::APFloat::roundingMode RM);
   ref<FConstantExpr> FMin(const ref<FConstantExpr> &RHS);
   ref<FConstantExpr> FMax(const ref<FConstantExpr> &RHS);
 
@@ -94,6 +94,7 @@ namespace klee {
     virtual ref<Expr> FRem(const ref<Expr> &LHS, const ref<Expr> &RHS, llvm::APFloat::roundingMode RM) = 0;
     virtual ref<Expr> FMin(const ref<Expr> &LHS, const ref<Expr> &RHS) = 0;
     virtual ref<Expr> FMax(const ref<Expr> &LHS, const ref<Expr> &RHS) = 0;
+    virtual ref<Expr> FFma(const ref<Expr> &LHS, const ref<Expr> &RHS, const ref<Expr> &Addend, llvm::APFloat::roundingMode RM) = 0;
 
     // Utility functions
 
@@ -10,10 +10,41 @@
 #ifndef __UTIL_IMMUTABLETREE_H__
 #define __UTIL_IMMUTABLETREE_H__
 
+#include <algorithm>
 #include <cassert>
-#include <vector>
+#include <cstddef>
 
 namespace klee {
+  /// Free list for the nodes of one type of tree. Trees are copied and
+  /// modified at a high rate as states fork and write memory, so node storage
+  /// is recycled instead of going back to malloc every time.
+  template<class T>
+  class NodePool {
+    static void *freeList;
+
+  public:
+    static void *allocate() {
+      if (void *p = freeList) {
+        freeList = *static_cast<void**>(p);
+        return p;
+      }
+      return ::operator new(sizeof(T));
+    }
+    static void release(void *p) {
+      *static_cast<void**>(p) = freeList;
+      freeList = p;
+    }
+  };
+
+  template<class T>
+  void *NodePool<T>::freeList = 0;
+
+  /// A persistent ordered tree: every modification returns a new tree that
+  /// shares all untouched nodes with the old one. It is a B+-tree, with the
+  /// values in the leaves and, in the inner nodes, the minimum key of every
+  /// child next to the child pointer, so that a lookup scans a few small
+  /// arrays instead of chasing a pointer per comparison and a modification
+  /// copies O(log n) nodes with a large fanout.
   template<class K, class V, class KOV, class CMP>
   class ImmutableTree {
   public:
@@ -60,10 +91,31 @@ namespace klee {
     static size_t getAllocated() { return allocated; }
 
   private:
+    enum {
+      LeafCapacity = 16,
+      Fanout = 16,
+      // enough for more than 8^15 values with half full nodes
+      MaxDepth = 16
+    };
+
     class Node;
+    class Leaf;
+    class Inner;
 
-    Node *node;
+    Node *node; // null for the empty tree
     ImmutableTree(Node *_node);
+
+    static bool less(const key_type &a, const key_type &b) {
+      return key_compare()(a, b);
+    }
+    static const key_type &keyOf(const value_type &v) {
+      return key_of_value()(v);
+    }
+
+    static Node *insert(Node *n, const value_type &v, bool overwrite,
+                        Node *&split);
+    static Node *remove(Node *n, const key_type &k);
+    static void rebalance(Node *a, Node *b, Node *&outA, Node *&outB);
   };
 
   /***/
@@ -71,358 +123,388 @@ namespace klee {
   template<class K, class V, class KOV, class CMP>
   class ImmutableTree<K,V,KOV,CMP>::Node {
   public:
-    static Node terminator;
-    Node *left, *right;
-    value_type value;
-    unsigned height, references;
+    unsigned references;
+    /// Number of values in a leaf, or of children of an inner node.
+    unsigned count;
+    /// Number of values in the subtree.
+    size_t size;
+    bool isLeaf;
+
+    Node(bool _isLeaf)
+      : references(1), count(0), size(0), isLeaf(_isLeaf) {
+      ++allocated;
+    }
+    ~Node() { --allocated; }
+
+    Node *incref() { ++references; return this; }
+    void decref();
 
-  protected:
-    Node(); // solely for creating the terminator node
-    static Node *balance(Node *left, const value_type &value, Node *right);
+    const key_type &minKey() const;
+    unsigned capacity() const { return isLeaf ? LeafCapacity : Fanout; }
+    bool isUnderfull() const { return count < capacity() / 2; }
+  };
 
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableTree<K,V,KOV,CMP>::Leaf : public Node {
   public:
+    value_type values[LeafCapacity];
 
-    Node(Node *_left, Node *_right, const value_type &_value);
-    ~Node();
+    Leaf() : Node(true) {}
 
-    void decref();
-    Node *incref();
+    void append(const value_type &v) {
+      values[this->count++] = v;
+      ++this->size;
+    }
 
-    bool isTerminator();
+    /// Index of the first value not less than k.
+    unsigned lowerBound(const key_type &k) const {
+      unsigned i = 0;
+      while (i < this->count && less(keyOf(values[i]), k))
+        ++i;
+      return i;
+    }
 
-    size_t size();
-    Node *popMin(value_type &valueOut);
-    Node *popMax(value_type &valueOut);
-    Node *insert(const value_type &v);
-    Node *replace(const value_type &v);
-    Node *remove(const key_type &k);
+    static void *operator new(size_t) { return NodePool<Leaf>::allocate(); }
+    static void operator delete(void *p) { NodePool<Leaf>::release(p); }
   };
 
-  // Should live somewhere else, this is a simple stack with maximum (dynamic)
-  // size.
-  template<typename T>
-  class FixedStack {
-    unsigned pos, max;
-    T *elts;
-
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableTree<K,V,KOV,CMP>::Inner : public Node {
   public:
-    FixedStack(unsigned _max) : pos(0),
-                                max(_max),
-                                elts(new T[max]) {}
-    FixedStack(const FixedStack &b) : pos(b.pos),
-                                      max(b.max),
-                                      elts(new T[b.max]) {
-      std::copy(b.elts, b.elts+pos, elts);
-    }
-    ~FixedStack() { delete[] elts; }
-
-    void push_back(const T &elt) { elts[pos++] = elt; }
-    void pop_back() { --pos; }
-    bool empty() { return pos==0; }
-    T &back() { return elts[pos-1]; }
-
-
-    FixedStack &operator=(const FixedStack &b) {
-      assert(max == b.max); 
-      pos = b.pos;
-      std::copy(b.elts, b.elts+pos, elts);
-      return *this;
+    /// The minimum key of every child.
+    key_type keys[Fanout];
+    Node *children[Fanout];
+
+    Inner() : Node(false) {}
+    ~Inner() {
+      for (unsigned i = 0; i < this->count; ++i)
+        children[i]->decref();
+    }
+
+    /// Takes over the reference to child.
+    void append(Node *child) {
+      keys[this->count] = child->minKey();
+      children[this->count++] = child;
+      this->size += child->size;
     }
 
-    bool operator==(const FixedStack &b) {
-      return (pos == b.pos &&
-              std::equal(elts, elts+pos, b.elts));
+    /// Index of the child whose range contains k: the last one whose minimum
+    /// key is not greater than k, or the first one.
+    unsigned findChild(const key_type &k) const {
+      unsigned i = 1;
+      while (i < this->count && !less(k, keys[i]))
+        ++i;
+      return i - 1;
     }
-    bool operator!=(const FixedStack &b) { return !(*this==b); }
+
+    static void *operator new(size_t) { return NodePool<Inner>::allocate(); }
+    static void operator delete(void *p) { NodePool<Inner>::release(p); }
   };
 
+  template<class K, class V, class KOV, class CMP>
+  inline void ImmutableTree<K,V,KOV,CMP>::Node::decref() {
+    if (--references)
+      return;
+    if (isLeaf)
+      delete static_cast<Leaf*>(this);
+    else
+      delete static_cast<Inner*>(this);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  inline const typename ImmutableTree<K,V,KOV,CMP>::key_type &
+  ImmutableTree<K,V,KOV,CMP>::Node::minKey() const {
+    if (isLeaf)
+      return keyOf(static_cast<const Leaf*>(this)->values[0]);
+    return static_cast<const Inner*>(this)->keys[0];
+  }
+
+  /***/
+
   template<class K, class V, class KOV, class CMP>
   class ImmutableTree<K,V,KOV,CMP>::iterator {
     friend class ImmutableTree<K,V,KOV,CMP>;
   private:
     Node *root; // so can back up from end
-    FixedStack<Node*> stack;
-    
-  public:
-    iterator(Node *_root, bool atBeginning) : root(_root->incref()),
-                                              stack(root->height) {
-      if (atBeginning) {
-        for (Node *n=root; !n->isTerminator(); n=n->left)
-          stack.push_back(n);
+    /// The nodes from the root down to the current leaf, and the position
+    /// in each of them. Empty at the end.
+    unsigned depth;
+    Node *path[MaxDepth];
+    unsigned index[MaxDepth];
+
+    iterator(Node *_root) : root(_root), depth(0) {
+      if (root)
+        root->incref();
+    }
+
+    /// Extends the path from n down to a leaf, always taking the first or
+    /// the last child.
+    void descend(Node *n, bool first) {
+      for (;;) {
+        assert(depth < MaxDepth && "tree too deep");
+        unsigned i = first ? 0 : n->count - 1;
+        path[depth] = n;
+        index[depth++] = i;
+        if (n->isLeaf)
+          break;
+        n = static_cast<Inner*>(n)->children[i];
       }
     }
-    iterator(const iterator &i) : root(i.root->incref()),
-                                  stack(i.stack) {
+
+    const value_type &value() const {
+      assert(depth && "dereferencing end iterator");
+      return static_cast<Leaf*>(path[depth-1])->values[index[depth-1]];
+    }
+
+  public:
+    iterator(const iterator &i) : root(i.root), depth(i.depth) {
+      if (root)
+        root->incref();
+      std::copy(i.path, i.path + depth, path);
+      std::copy(i.index, i.index + depth, index);
     }
     ~iterator() {
-      root->decref();
+      if (root)
+        root->decref();
     }
 
     iterator &operator=(const iterator &b) {
-      b.root->incref();
-      root->decref();
+      if (b.root)
+        b.root->incref();
+      if (root)
+        root->decref();
       root = b.root;
-      stack = b.stack;
+      depth = b.depth;
+      std::copy(b.path, b.path + depth, path);
+      std::copy(b.index, b.index + depth, index);
       return *this;
     }
 
     const value_type &operator*() {
-      Node *n = stack.back();
-      return n->value;
+      return value();
     }
 
     const value_type *operator->() {
-      Node *n = stack.back();
-      return &n->value;
+      return &value();
     }
 
     bool operator==(const iterator &b) {
-      return stack==b.stack;
+      if (depth != b.depth)
+        return false;
+      return !depth || (path[depth-1] == b.path[depth-1] &&
+                        index[depth-1] == b.index[depth-1]);
     }
     bool operator!=(const iterator &b) {
-      return stack!=b.stack;
+      return !(*this==b);
     }
     
     iterator &operator--() {
-      if (stack.empty()) {
-        for (Node *n=root; !n->isTerminator(); n=n->right)
-          stack.push_back(n);
-      } else {
-        Node *n = stack.back();
-        if (n->left->isTerminator()) {
-          for (;;) {
-            Node *prev = n;
-            stack.pop_back();
-            if (stack.empty()) {
-              break;
-            } else {
-              n = stack.back();
-              if (prev==n->right)
-                break;
-            }
-          }
-        } else {
-          stack.push_back(n->left);
-          for (n=n->left->right; !n->isTerminator(); n=n->right)
-            stack.push_back(n);
+      if (!depth) {
+        if (root)
+          descend(root, false);
+        return *this;
+      }
+      unsigned level = depth - 1;
+      while (!index[level]) {
+        if (!level) {
+          depth = 0;
+          return *this;
         }
+        --level;
       }
+      --index[level];
+      depth = level + 1;
+      if (!path[level]->isLeaf)
+        descend(static_cast<Inner*>(path[level])->children[index[level]],
+                false);
       return *this;
     }
 
     iterator &operator++() {
-      assert(!stack.empty());
-      Node *n = stack.back();
-      if (n->right->isTerminator()) {
-        for (;;) {
-          Node *prev = n;
-          stack.pop_back();
-          if (stack.empty()) {
-            break;
-          } else {
-            n = stack.back();
-            if (prev==n->left)
-              break;
-          }
+      assert(depth);
+      unsigned level = depth - 1;
+      while (index[level] + 1 == path[level]->count) {
+        if (!level) {
+          depth = 0;
+          return *this;
         }
-      } else {
-        stack.push_back(n->right);
-        for (n=n->right->left; !n->isTerminator(); n=n->left)
-          stack.push_back(n);
+        --level;
       }
+      ++index[level];
+      depth = level + 1;
+      if (!path[level]->isLeaf)
+        descend(static_cast<Inner*>(path[level])->children[index[level]],
+                true);
       return *this;
     }
   };
 
   /***/
 
-  template<class K, class V, class KOV, class CMP> 
-  typename ImmutableTree<K,V,KOV,CMP>::Node 
-  ImmutableTree<K,V,KOV,CMP>::Node::terminator;
-
   template<class K, class V, class KOV, class CMP> 
   size_t ImmutableTree<K,V,KOV,CMP>::allocated = 0;
 
-  template<class K, class V, class KOV, class CMP>
-  ImmutableTree<K,V,KOV,CMP>::Node::Node() 
-    : left(&terminator), 
-      right(&terminator), 
-      height(0), 
-      references(3) { 
-    assert(this==&terminator);
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  ImmutableTree<K,V,KOV,CMP>::Node::Node(Node *_left, Node *_right, const value_type &_value)
-    : left(_left), 
-      right(_right), 
-      value(_value), 
-      height(std::max(left->height, right->height) + 1),
-      references(1) 
-  {
-    ++allocated;
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  ImmutableTree<K,V,KOV,CMP>::Node::~Node() {
-    left->decref();
-    right->decref();
-    --allocated;
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  inline void ImmutableTree<K,V,KOV,CMP>::Node::decref() {
-    --references;
-    if (references==0) delete this;
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  inline typename ImmutableTree<K,V,KOV,CMP>::Node *ImmutableTree<K,V,KOV,CMP>::Node::incref() {
-    ++references;
-    return this;
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  inline bool ImmutableTree<K,V,KOV,CMP>::Node::isTerminator() {
-    return this==&terminator;
-  }
-
-  /***/
-
   template<class K, class V, class KOV, class CMP>
   typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::balance(Node *left, const value_type &value, Node *right) {
-    if (left->height > right->height + 2) {
-      Node *ll = left->left;
-      Node *lr = left->right;
-      if (ll->height >= lr->height) {
-        Node *nlr = new Node(lr->incref(), right, value);
-        Node *res = new Node(ll->incref(), nlr, left->value);
-        left->decref();
-        return res;
-      } else {
-        Node *lrl = lr->left;
-        Node *lrr = lr->right;
-        Node *nll = new Node(ll->incref(), lrl->incref(), left->value);
-        Node *nlr = new Node(lrr->incref(), right, value);
-        Node *res = new Node(nll, nlr, lr->value);
-        left->decref();
-        return res;
+  ImmutableTree<K,V,KOV,CMP>::insert(Node *n, const value_type &v,
+                                     bool overwrite, Node *&split) {
+    const key_type &k = keyOf(v);
+
+    if (n->isLeaf) {
+      Leaf *l = static_cast<Leaf*>(n);
+      unsigned i = l->lowerBound(k);
+      bool found = i < l->count && !less(k, keyOf(l->values[i]));
+      if (found && !overwrite)
+        return n->incref();
+
+      const value_type *merged[LeafCapacity + 1];
+      unsigned total = 0;
+      for (unsigned j = 0; j < l->count; ++j) {
+        if (j == i)
+          merged[total++] = &v;
+        if (!(found && j == i))
+          merged[total++] = &l->values[j];
       }
-    } else if (right->height > left->height + 2) {
-      Node *rl = right->left;
-      Node *rr = right->right;
-      if (rr->height >= rl->height) {
-        Node *nrl = new Node(left, rl->incref(), value);
-        Node *res = new Node(nrl, rr->incref(), right->value);
-        right->decref();
-        return res;
-      } else {
-        Node *rll = rl->left;
-        Node *rlr = rl->right;
-        Node *nrl = new Node(left, rll->incref(), value);
-        Node *nrr = new Node(rlr->incref(), rr->incref(), right->value);
-        Node *res = new Node(nrl, nrr, rl->value);
-        right->decref();
-        return res;
+      if (i == l->count)
+        merged[total++] = &v;
+
+      Leaf *lo = new Leaf();
+      unsigned half = total <= LeafCapacity ? total : total / 2;
+      for (unsigned j = 0; j < half; ++j)
+        lo->append(*merged[j]);
+      if (half < total) {
+        Leaf *hi = new Leaf();
+        for (unsigned j = half; j < total; ++j)
+          hi->append(*merged[j]);
+        split = hi;
       }
-    } else {
-      return new Node(left, right, value);
+      return lo;
     }
-  }
 
-  template<class K, class V, class KOV, class CMP>
-  size_t ImmutableTree<K,V,KOV,CMP>::Node::size() {
-    if (isTerminator()) {
-      return 0;
-    } else {
-      return left->size() + 1 + right->size();
+    Inner *in = static_cast<Inner*>(n);
+    unsigned i = in->findChild(k);
+    Node *childSplit = 0;
+    Node *child = insert(in->children[i], v, overwrite, childSplit);
+    if (child == in->children[i]) {
+      child->decref();
+      return n->incref();
     }
-  }
 
-  template<class K, class V, class KOV, class CMP>
-  typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::popMin(value_type &valueOut) {
-    if (left->isTerminator()) {
-      valueOut = value;
-      return right->incref();
-    } else {
-      return balance(left->popMin(valueOut), value, right->incref());
+    Node *merged[Fanout + 1];
+    unsigned total = 0;
+    for (unsigned j = 0; j < in->count; ++j) {
+      if (j == i) {
+        merged[total++] = child;
+        if (childSplit)
+          merged[total++] = childSplit;
+      } else {
+        merged[total++] = in->children[j]->incref();
+      }
     }
-  }
 
-  template<class K, class V, class KOV, class CMP>
-  typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::popMax(value_type &valueOut) {
-    if (right->isTerminator()) {
-      valueOut = value;
-      return left->incref();
-    } else {
-      return balance(left->incref(), value, right->popMax(valueOut));
+    Inner *lo = new Inner();
+    unsigned half = total <= Fanout ? total : total / 2;
+    for (unsigned j = 0; j < half; ++j)
+      lo->append(merged[j]);
+    if (half < total) {
+      Inner *hi = new Inner();
+      for (unsigned j = half; j < total; ++j)
+        hi->append(merged[j]);
+      split = hi;
     }
-  }
-
-  template<class K, class V, class KOV, class CMP>
-  typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::insert(const value_type &v) {
-    if (isTerminator()) {
-      return new Node(terminator.incref(), terminator.incref(), v);
-    } else {
-      if (key_compare()(key_of_value()(v), key_of_value()(value))) {
-        return balance(left->insert(v), value, right->incref());
-      } else if (key_compare()(key_of_value()(value), key_of_value()(v))) {
-        return balance(left->incref(), value, right->insert(v));
-      } else {
-        return incref();
+    return lo;
+  }
+
+  /// Replaces two adjacent nodes of the same level, one of them underfull,
+  /// by one node holding the contents of both, or by two nodes sharing them
+  /// evenly (outB is null in the first case).
+  template<class K, class V, class KOV, class CMP>
+  void ImmutableTree<K,V,KOV,CMP>::rebalance(Node *a, Node *b,
+                                             Node *&outA, Node *&outB) {
+    unsigned total = a->count + b->count;
+    unsigned half = total <= a->capacity() ? total : total / 2;
+    outB = 0;
+
+    if (a->isLeaf) {
+      Leaf *la = static_cast<Leaf*>(a), *lb = static_cast<Leaf*>(b);
+      Leaf *lo = new Leaf(), *hi = half < total ? new Leaf() : 0;
+      for (unsigned j = 0; j < total; ++j) {
+        const value_type &v = j < la->count ? la->values[j]
+                                            : lb->values[j - la->count];
+        (j < half ? lo : hi)->append(v);
       }
+      outA = lo;
+      outB = hi;
+      return;
     }
-  }
 
-  template<class K, class V, class KOV, class CMP>
-  typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::replace(const value_type &v) {
-    if (isTerminator()) {
-      return new Node(terminator.incref(), terminator.incref(), v);
-    } else {
-      if (key_compare()(key_of_value()(v), key_of_value()(value))) {
-        return balance(left->replace(v), value, right->incref());
-      } else if (key_compare()(key_of_value()(value), key_of_value()(v))) {
-        return balance(left->incref(), value, right->replace(v));
-      } else {
-        return new Node(left->incref(), right->incref(), v);
-      }
+    Inner *ia = static_cast<Inner*>(a), *ib = static_cast<Inner*>(b);
+    Inner *lo = new Inner(), *hi = half < total ? new Inner() : 0;
+    for (unsigned j = 0; j < total; ++j) {
+      Node *c = j < ia->count ? ia->children[j] : ib->children[j - ia->count];
+      (j < half ? lo : hi)->append(c->incref());
     }
+    outA = lo;
+    outB = hi;
   }
 
   template<class K, class V, class KOV, class CMP>
   typename ImmutableTree<K,V,KOV,CMP>::Node *
-  ImmutableTree<K,V,KOV,CMP>::Node::remove(const key_type &k) {
-    if (isTerminator()) {
-      return incref();
-    } else {
-      if (key_compare()(k, key_of_value()(value))) {
-        return balance(left->remove(k), value, right->incref());
-      } else if (key_compare()(key_of_value()(value), k)) {
-        return balance(left->incref(), value, right->remove(k));
+  ImmutableTree<K,V,KOV,CMP>::remove(Node *n, const key_type &k) {
+    if (n->isLeaf) {
+      Leaf *l = static_cast<Leaf*>(n);
+      unsigned i = l->lowerBound(k);
+      if (i == l->count || less(k, keyOf(l->values[i])))
+        return n->incref();
+      Leaf *res = new Leaf();
+      for (unsigned j = 0; j < l->count; ++j)
+        if (j != i)
+          res->append(l->values[j]);
+      return res;
+    }
+
+    Inner *in = static_cast<Inner*>(n);
+    unsigned i = in->findChild(k);
+    Node *child = remove(in->children[i], k);
+    if (child == in->children[i]) {
+      child->decref();
+      return n->incref();
+    }
+
+    Node *merged[Fanout];
+    unsigned total = 0;
+    for (unsigned j = 0; j < in->count; ++j)
+      merged[total++] = j == i ? child : in->children[j]->incref();
+
+    // Merge an underfull child with a sibling, or move some of the sibling's
+    // contents over.
+    if (child->isUnderfull() && total > 1) {
+      unsigned left = i ? i - 1 : i;
+      Node *a, *b;
+      rebalance(merged[left], merged[left + 1], a, b);
+      merged[left]->decref();
+      merged[left + 1]->decref();
+      merged[left] = a;
+      if (b) {
+        merged[left + 1] = b;
       } else {
-        if (left->isTerminator()) {
-          return right->incref();
-        } else if (right->isTerminator()) {
-          return left->incref();
-        } else {
-          value_type min;
-          Node *nr = right->popMin(min);
-          return balance(left->incref(), min, nr);
-        }
+        for (unsigned j = left + 1; j + 1 < total; ++j)
+          merged[j] = merged[j + 1];
+        --total;
       }
     }
+
+    Inner *res = new Inner();
+    for (unsigned j = 0; j < total; ++j)
+      res->append(merged[j]);
+    return res;
   }
 
   /***/
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP>::ImmutableTree() 
-    : node(Node::terminator.incref()) {
+    : node(0) {
   }
 
   template<class K, class V, class KOV, class CMP>
@@ -432,57 +514,51 @@ namespace klee {
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP>::ImmutableTree(const ImmutableTree &s) 
-    : node(s.node->incref()) {
+    : node(s.node) {
+    if (node)
+      node->incref();
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP>::~ImmutableTree() {
-    node->decref(); 
+    if (node)
+      node->decref(); 
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> &ImmutableTree<K,V,KOV,CMP>::operator=(const ImmutableTree &s) {
-    Node *n = s.node->incref();
-    node->decref();
-    node = n;
+    if (s.node)
+      s.node->incref();
+    if (node)
+      node->decref();
+    node = s.node;
     return *this;
   }
 
   template<class K, class V, class KOV, class CMP>
   bool ImmutableTree<K,V,KOV,CMP>::empty() const {
-    return node->isTerminator();
+    return !node;
   }
 
   template<class K, class V, class KOV, class CMP>
   size_t ImmutableTree<K,V,KOV,CMP>::count(const key_type &k) const {
-    Node *n = node;
-    while (!n->isTerminator()) {
-      key_type key = key_of_value()(n->value);
-      if (key_compare()(k, key)) {
-        n = n->left;
-      } else if (key_compare()(key, k)) {
-        n = n->right;
-      } else {
-        return 1;
-      }
-    }
-    return 0;
+    return lookup(k) ? 1 : 0;
   }
 
   template<class K, class V, class KOV, class CMP>
   const typename ImmutableTree<K,V,KOV,CMP>::value_type *
   ImmutableTree<K,V,KOV,CMP>::lookup(const key_type &k) const {
     Node *n = node;
-    while (!n->isTerminator()) {
-      key_type key = key_of_value()(n->value);
-      if (key_compare()(k, key)) {
-        n = n->left;
-      } else if (key_compare()(key, k)) {
-        n = n->right;
-      } else {
-        return &n->value;
-      }
+    if (!n)
+      return 0;
+    while (!n->isLeaf) {
+      Inner *in = static_cast<Inner*>(n);
+      n = in->children[in->findChild(k)];
     }
+    Leaf *l = static_cast<Leaf*>(n);
+    unsigned i = l->lowerBound(k);
+    if (i < l->count && !less(k, keyOf(l->values[i])))
+      return &l->values[i];
     return 0;
   }
 
@@ -490,91 +566,134 @@ namespace klee {
   const typename ImmutableTree<K,V,KOV,CMP>::value_type *
   ImmutableTree<K,V,KOV,CMP>::lookup_previous(const key_type &k) const {
     Node *n = node;
-    Node *result = 0;
-    while (!n->isTerminator()) {
-      key_type key = key_of_value()(n->value);
-      if (key_compare()(k, key)) {
-        n = n->left;
-      } else if (key_compare()(key, k)) {
-        result = n;
-        n = n->right;
-      } else {
-        return &n->value;
-      }
+    if (!n)
+      return 0;
+    // The child chosen at every level starts at or before k unless k is
+    // below the minimum of the whole tree.
+    while (!n->isLeaf) {
+      Inner *in = static_cast<Inner*>(n);
+      n = in->children[in->findChild(k)];
     }
-    return result ? &result->value : 0;
+    Leaf *l = static_cast<Leaf*>(n);
+    unsigned i = 0;
+    while (i < l->count && !less(k, keyOf(l->values[i])))
+      ++i;
+    return i ? &l->values[i - 1] : 0;
   }
 
   template<class K, class V, class KOV, class CMP>
   const typename ImmutableTree<K,V,KOV,CMP>::value_type &
   ImmutableTree<K,V,KOV,CMP>::min() const { 
     Node *n = node;
-    assert(!n->isTerminator());
-    while (!n->left->isTerminator()) n = n->left;
-    return n->value;
+    assert(n);
+    while (!n->isLeaf)
+      n = static_cast<Inner*>(n)->children[0];
+    return static_cast<Leaf*>(n)->values[0];
   }
 
   template<class K, class V, class KOV, class CMP>
   const typename ImmutableTree<K,V,KOV,CMP>::value_type &
   ImmutableTree<K,V,KOV,CMP>::max() const {
     Node *n = node;
-    assert(!n->isTerminator());
-    while (!n->right->isTerminator()) n = n->right;
-    return n->value;
+    assert(n);
+    while (!n->isLeaf)
+      n = static_cast<Inner*>(n)->children[n->count - 1];
+    return static_cast<Leaf*>(n)->values[n->count - 1];
   }
 
   template<class K, class V, class KOV, class CMP>
   size_t ImmutableTree<K,V,KOV,CMP>::size() const {
-    return node->size();
+    return node ? node->size : 0;
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::insert(const value_type &value) const { 
-    return ImmutableTree(node->insert(value)); 
+    if (!node) {
+      Leaf *l = new Leaf();
+      l->append(value);
+      return ImmutableTree(l);
+    }
+    Node *split = 0;
+    Node *res = insert(node, value, false, split);
+    if (split) {
+      Inner *root = new Inner();
+      root->append(res);
+      root->append(split);
+      res = root;
+    }
+    return ImmutableTree(res);
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::replace(const value_type &value) const { 
-    return ImmutableTree(node->replace(value)); 
+    if (!node)
+      return insert(value);
+    Node *split = 0;
+    Node *res = insert(node, value, true, split);
+    if (split) {
+      Inner *root = new Inner();
+      root->append(res);
+      root->append(split);
+      res = root;
+    }
+    return ImmutableTree(res);
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::remove(const key_type &key) const { 
-    return ImmutableTree(node->remove(key)); 
+    if (!node)
+      return *this;
+    Node *res = remove(node, key);
+    // Drop roots left with a single child, and an empty leaf.
+    while (!res->isLeaf && res->count == 1) {
+      Node *child = static_cast<Inner*>(res)->children[0]->incref();
+      res->decref();
+      res = child;
+    }
+    if (!res->count) {
+      res->decref();
+      res = 0;
+    }
+    return ImmutableTree(res);
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::popMin(value_type &valueOut) const { 
-    return ImmutableTree(node->popMin(valueOut)); 
+    valueOut = min();
+    return remove(keyOf(valueOut));
   }
 
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP> 
   ImmutableTree<K,V,KOV,CMP>::popMax(value_type &valueOut) const { 
-    return ImmutableTree(node->popMax(valueOut)); 
+    valueOut = max();
+    return remove(keyOf(valueOut));
   }
 
   template<class K, class V, class KOV, class CMP>
   inline typename ImmutableTree<K,V,KOV,CMP>::iterator 
   ImmutableTree<K,V,KOV,CMP>::begin() const {
-    return iterator(node, true);
+    iterator it(node);
+    if (node)
+      it.descend(node, true);
+    return it;
   }
 
   template<class K, class V, class KOV, class CMP>
   inline typename ImmutableTree<K,V,KOV,CMP>::iterator 
   ImmutableTree<K,V,KOV,CMP>::end() const {
-    return iterator(node, false);
+    return iterator(node);
   }
 
   template<class K, class V, class KOV, class CMP>
   inline typename ImmutableTree<K,V,KOV,CMP>::iterator 
   ImmutableTree<K,V,KOV,CMP>::find(const key_type &key) const {
-    iterator end(node,false), it = lower_bound(key);
-    if (it==end || key_compare()(key,key_of_value()(*it))) {
+    iterator end(node), it = lower_bound(key);
+    if (it==end || less(key, keyOf(*it))) {
       return end;
     } else {
       return it;
@@ -584,23 +703,26 @@ namespace klee {
   template<class K, class V, class KOV, class CMP>
   inline typename ImmutableTree<K,V,KOV,CMP>::iterator 
   ImmutableTree<K,V,KOV,CMP>::lower_bound(const key_type &k) const {
-    // XXX ugh this doesn't have to be so ugly does it?
-    iterator it(node,false);
-    for (Node *root=node; !root->isTerminator();) {
-      it.stack.push_back(root);
-      if (key_compare()(k, key_of_value()(root->value))) {
-        root = root->left;
-      } else if (key_compare()(key_of_value()(root->value), k)) {
-        root = root->right;
-      } else {
-        return it;
-      }
+    iterator it(node);
+    if (!node)
+      return it;
+    Node *n = node;
+    while (!n->isLeaf) {
+      Inner *in = static_cast<Inner*>(n);
+      unsigned i = in->findChild(k);
+      it.path[it.depth] = n;
+      it.index[it.depth++] = i;
+      n = in->children[i];
     }
-    // it is now beginning or first element < k
-    if (!it.stack.empty()) {
-      Node *last = it.stack.back();
-      if (key_compare()(key_of_value()(last->value), k))
-        ++it;
+    Leaf *l = static_cast<Leaf*>(n);
+    unsigned i = l->lowerBound(k);
+    it.path[it.depth] = n;
+    if (i < l->count) {
+      it.index[it.depth++] = i;
+    } else {
+      // everything in this leaf is below k, the answer starts the next one
+      it.index[it.depth++] = l->count - 1;
+      ++it;
     }
     return it;
   }
@@ -608,9 +730,9 @@ namespace klee {
   template<class K, class V, class KOV, class CMP>
   typename ImmutableTree<K,V,KOV,CMP>::iterator 
   ImmutableTree<K,V,KOV,CMP>::upper_bound(const key_type &key) const {
-    iterator end(node,false),it = lower_bound(key);
+    iterator end(node),it = lower_bound(key);
     if (it!=end && 
-        !key_compare()(key,key_of_value()(*it))) // no need to loop, no duplicates
+        !less(key, keyOf(*it))) // no need to loop, no duplicates
       ++it;
     return it;
   }
@@ -10,11 +10,14 @@
 #ifndef __UTIL_MAPOFSETS_H__
 #define __UTIL_MAPOFSETS_H__
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <set>
 #include <map>
 
+#include <stdint.h>
+
 // This should really be broken down into TreeOfSets on top of which
 // SetOfSets and MapOfSets are easily implemeted. It should also be
 // parameterized on the underlying set type. Neither are hard to do,
@@ -24,8 +27,36 @@
 
 namespace klee {
 
+  /// Hashes keys into set signatures. Keys that compare equal must hash
+  /// equally; the default works for keys with a hash() method behind a
+  /// pointer, such as ref<Expr>.
+  template<class K>
+  struct MapOfSetsKeyHash {
+    static unsigned hash(const K &k) { return k->hash(); }
+  };
+
+  template<>
+  struct MapOfSetsKeyHash<int> {
+    static unsigned hash(int k) { return k; }
+  };
+
+  template<>
+  struct MapOfSetsKeyHash<unsigned> {
+    static unsigned hash(unsigned k) { return k; }
+  };
+
   /** This implements the UBTree data structure (see Hoffmann and
-      Koehler, "A New Method to Index and Query Sets", IJCAI 1999) */
+      Koehler, "A New Method to Index and Query Sets", IJCAI 1999).
+
+      Subset and superset searches do not walk the tree, whose cost grows
+      with the number of stored sets. Every set also gets a slot in a flat
+      index holding its keys and a bit signature, and every key lists the
+      slots of the sets containing it. A superset of S must appear in the
+      list of each key of S, so only the shortest of those lists is scanned.
+      Each set is also anchored to one of its keys, the rarest one when it
+      was inserted, and a subset of S must be anchored to a key of S, so
+      only the sets anchored to those are scanned. Signatures reject most
+      candidates before their keys are compared. */
   template<class K, class V>
   class MapOfSets {
   public:
@@ -53,11 +84,71 @@ namespace klee {
     template<class Predicate>
     V *findSubset(const std::set<K> &set, const Predicate &p);
 
+    /// Removes every entry whose value satisfies the predicate, returning the
+    /// number of entries removed.
+    template<class Predicate>
+    unsigned removeIf(const Predicate &p);
+
   private:
     class Node;
 
+    /// A bloom-style summary of a set: one bit per key, hashed into
+    /// SignatureWords words. If A is a subset of B, the bits of A are a
+    /// subset of the bits of B.
+    enum { SignatureWords = 4 };
+    struct Signature {
+      uint64_t words[SignatureWords];
+
+      Signature() {
+        for (unsigned i = 0; i < SignatureWords; ++i)
+          words[i] = 0;
+      }
+      void add(const K &k) {
+        unsigned h = MapOfSetsKeyHash<K>::hash(k);
+        h ^= h >> 16;
+        h *= 0x45d9f3b;
+        h ^= h >> 16;
+        unsigned bit = h % (64 * SignatureWords);
+        words[bit / 64] |= (uint64_t) 1 << (bit % 64);
+      }
+      bool contains(const Signature &b) const {
+        for (unsigned i = 0; i < SignatureWords; ++i)
+          if (b.words[i] & ~words[i])
+            return false;
+        return true;
+      }
+    };
+
+    /// An indexed set: its keys in order and the tree node holding its value.
+    struct Entry {
+      Node *node;
+      std::vector<K> keys;
+
+      Entry(Node *_node, const std::set<K> &set)
+        : node(_node), keys(set.begin(), set.end()) {}
+    };
+
+    /// The slots of the sets that contain a key, and of those anchored to it.
+    struct Postings {
+      std::vector<unsigned> containing;
+      std::vector<unsigned> anchored;
+    };
+    typedef std::map<K, Postings> postings_ty;
+
     Node root;
 
+    // Parallel arrays indexed by slot, the signatures are kept apart so
+    // that scanning them stays cache friendly.
+    std::vector<Entry> entries;
+    std::vector<Signature> signatures;
+    postings_ty postings;
+    /// Slot of the entry for the empty set, or -1.
+    int emptySlot;
+
+    static Signature signatureOf(const std::set<K> &set);
+    void indexEntry(unsigned slot);
+    void rebuildIndex();
+
     template<class Iterator, class Vector>
     void findSubsets(Node *n, 
                      const std::set<K> &accum,
@@ -70,16 +161,7 @@ namespace klee {
                        Iterator begin, 
                        Iterator end,
                        Vector &resultsOut);
-    template<class Predicate>
-    V *findSuperset(Node *n, 
-                    typename std::set<K>::iterator begin, 
-                    typename std::set<K>::iterator end,
-                    const Predicate &p);
-    template<class Predicate>
-    V *findSubset(Node *n, 
-                  typename std::set<K>::iterator begin, 
-                  typename std::set<K>::iterator end,
-                  const Predicate &p);
+    void prune(Node *n);
   };
 
   /***/
@@ -96,10 +178,12 @@ namespace klee {
 
   private:
     bool isEndOfSet;
+    /// The slot of this set in the index, if isEndOfSet.
+    unsigned slot;
     std::map<K, Node> children;
     
   public:
-    Node() : isEndOfSet(false) {}
+    Node() : isEndOfSet(false), slot(0) {}
   };
   
   template<class K, class V>
@@ -182,7 +266,37 @@ namespace klee {
   /***/
 
   template<class K, class V>
-  MapOfSets<K,V>::MapOfSets() {}  
+  MapOfSets<K,V>::MapOfSets() : emptySlot(-1) {}  
+
+  template<class K, class V>
+  typename MapOfSets<K,V>::Signature
+  MapOfSets<K,V>::signatureOf(const std::set<K> &set) {
+    Signature sig;
+    for (typename std::set<K>::const_iterator it = set.begin(), ie = set.end();
+         it != ie; ++it)
+      sig.add(*it);
+    return sig;
+  }
+
+  template<class K, class V>
+  void MapOfSets<K,V>::indexEntry(unsigned slot) {
+    const std::vector<K> &keys = entries[slot].keys;
+    if (keys.empty()) {
+      emptySlot = slot;
+      return;
+    }
+    // Anchor the set to its rarest key, so that subset searches, which
+    // scan the sets anchored to the keys they are given, see few of them.
+    Postings *anchor = 0;
+    for (typename std::vector<K>::const_iterator it = keys.begin(),
+           ie = keys.end(); it != ie; ++it) {
+      Postings &p = postings[*it];
+      if (!anchor || p.containing.size() < anchor->containing.size())
+        anchor = &p;
+      p.containing.push_back(slot);
+    }
+    anchor->anchored.push_back(slot);
+  }
 
   template<class K, class V>
   void MapOfSets<K,V>::insert(const std::set<K> &set, const V &value) {
@@ -190,7 +304,13 @@ namespace klee {
     for (typename std::set<K>::const_iterator it = set.begin(), ie = set.end();
          it != ie; ++it)
       n = &n->children.insert(std::make_pair(*it, Node())).first->second;
-    n->isEndOfSet = true;
+    if (!n->isEndOfSet) {
+      n->isEndOfSet = true;
+      n->slot = entries.size();
+      entries.push_back(Entry(n, set));
+      signatures.push_back(signatureOf(set));
+      indexEntry(n->slot);
+    }
     n->value = value;
   }
 
@@ -294,82 +414,115 @@ namespace klee {
 
   template<class K, class V>
   template<class Predicate>
-  V *MapOfSets<K,V>::findSubset(Node *n, 
-                                typename std::set<K>::iterator begin, 
-                                typename std::set<K>::iterator end,
-                                const Predicate &p) {   
-    if (n->isEndOfSet && p(n->value)) {
-      return &n->value;
-    } else if (begin==end) {
+  V *MapOfSets<K,V>::findSuperset(const std::set<K> &set, const Predicate &p) {
+    if (set.empty()) {
+      for (unsigned slot = 0, e = entries.size(); slot != e; ++slot)
+        if (p(entries[slot].node->value))
+          return &entries[slot].node->value;
       return 0;
-    } else {
-      typename Node::children_ty::iterator kend = n->children.end();
-      typename Node::children_ty::iterator 
-        kbegin = n->children.lower_bound(*begin);
-      typename std::set<K>::iterator it = begin;
-      if (kbegin==kend)
+    }
+
+    // Every superset is listed under each key of the set, scan the shortest
+    // of those lists. A key that is in no set means there is no superset.
+    const std::vector<unsigned> *candidates = 0;
+    for (typename std::set<K>::const_iterator it = set.begin(), ie = set.end();
+         it != ie; ++it) {
+      typename postings_ty::const_iterator pit = postings.find(*it);
+      if (pit == postings.end())
         return 0;
-      for (;;) { // kbegin!=kend && *it <= kbegin->first
-        while (*it < kbegin->first) {
-          ++it;
-          if (it==end)
-            return 0;
-        }
-        if (*it == kbegin->first) {
-          ++it;
-          V *res = findSubset(&kbegin->second, it, end, p);
-          if (res || it==end)
-            return res;
-        }
-        while (kbegin->first < *it) {
-          ++kbegin;
-          if (kbegin==kend)
-            return 0;
-        }
-      }
+      if (!candidates || pit->second.containing.size() < candidates->size())
+        candidates = &pit->second.containing;
+    }
+
+    Signature sig = signatureOf(set);
+    for (std::vector<unsigned>::const_iterator it = candidates->begin(),
+           ie = candidates->end(); it != ie; ++it) {
+      const Entry &entry = entries[*it];
+      if (entry.keys.size() >= set.size() && signatures[*it].contains(sig) &&
+          std::includes(entry.keys.begin(), entry.keys.end(),
+                        set.begin(), set.end()) &&
+          p(entry.node->value))
+        return &entry.node->value;
     }
+    return 0;
   }
-  
+
   template<class K, class V>
   template<class Predicate>
-  V *MapOfSets<K,V>::findSuperset(Node *n, 
-                                  typename std::set<K>::iterator begin, 
-                                  typename std::set<K>::iterator end,
-                                  const Predicate &p) {   
-    if (begin==end) {
-      if (n->isEndOfSet && p(n->value))
-        return &n->value;
-      for (typename Node::children_ty::iterator it = n->children.begin(),
-             ie = n->children.end(); it != ie; ++it) {
-        V *res = findSuperset(&it->second, begin, end, p);
-        if (res) return res;
-      }
-    } else {
-      typename Node::children_ty::iterator kmid = 
-        n->children.lower_bound(*begin);
-      for (typename Node::children_ty::iterator it = n->children.begin(),
-             ie = n->children.end(); it != ie; ++it) {
-        V *res = findSuperset(&it->second, begin, end, p);
-        if (res) return res;
-      }
-      if (kmid!=n->children.end() && *begin==kmid->first) {
-        V *res = findSuperset(&kmid->second, ++begin, end, p);
-        if (res) return res;
+  V *MapOfSets<K,V>::findSubset(const std::set<K> &set, const Predicate &p) {
+    if (emptySlot >= 0 && p(entries[emptySlot].node->value))
+      return &entries[emptySlot].node->value;
+
+    // Every non-empty subset is anchored to one of the keys of the set.
+    Signature sig = signatureOf(set);
+    for (typename std::set<K>::const_iterator it = set.begin(), ie = set.end();
+         it != ie; ++it) {
+      typename postings_ty::const_iterator pit = postings.find(*it);
+      if (pit == postings.end())
+        continue;
+      const std::vector<unsigned> &anchored = pit->second.anchored;
+      for (std::vector<unsigned>::const_iterator ait = anchored.begin(),
+             aie = anchored.end(); ait != aie; ++ait) {
+        const Entry &entry = entries[*ait];
+        if (entry.keys.size() <= set.size() && sig.contains(signatures[*ait]) &&
+            std::includes(set.begin(), ie,
+                          entry.keys.begin(), entry.keys.end()) &&
+            p(entry.node->value))
+          return &entry.node->value;
       }
     }
     return 0;
   }
 
   template<class K, class V>
-  template<class Predicate>
-  V *MapOfSets<K,V>::findSuperset(const std::set<K> &set, const Predicate &p) {    
-    return findSuperset(&root, set.begin(), set.end(), p);
+  void MapOfSets<K,V>::prune(Node *n) {
+    for (typename Node::children_ty::iterator it = n->children.begin(),
+           ie = n->children.end(); it != ie;) {
+      prune(&it->second);
+      // drop branches that no longer lead to any entry
+      if (!it->second.isEndOfSet && it->second.children.empty())
+        n->children.erase(it++);
+      else
+        ++it;
+    }
+  }
+
+  template<class K, class V>
+  void MapOfSets<K,V>::rebuildIndex() {
+    postings.clear();
+    emptySlot = -1;
+    for (unsigned slot = 0, e = entries.size(); slot != e; ++slot) {
+      entries[slot].node->slot = slot;
+      indexEntry(slot);
+    }
   }
 
   template<class K, class V>
   template<class Predicate>
-  V *MapOfSets<K,V>::findSubset(const std::set<K> &set, const Predicate &p) {    
-    return findSubset(&root, set.begin(), set.end(), p);
+  unsigned MapOfSets<K,V>::removeIf(const Predicate &p) {
+    unsigned kept = 0;
+    for (unsigned slot = 0, e = entries.size(); slot != e; ++slot) {
+      Node *n = entries[slot].node;
+      if (p(n->value)) {
+        n->isEndOfSet = false;
+        n->value = V();
+      } else {
+        if (kept != slot) {
+          entries[kept] = entries[slot];
+          signatures[kept] = signatures[slot];
+        }
+        ++kept;
+      }
+    }
+
+    unsigned removed = entries.size() - kept;
+    if (removed) {
+      entries.erase(entries.begin() + kept, entries.end());
+      signatures.erase(signatures.begin() + kept, signatures.end());
+      rebuildIndex();
+      prune(&root);
+    }
+    return removed;
   }
 
   template<class K, class V>
@@ -377,6 +530,10 @@ namespace klee {
     root.isEndOfSet = false;
     root.value = V();
     root.children.clear();
+    entries.clear();
+    signatures.clear();
+    postings.clear();
+    emptySlot = -1;
   }
 
 }
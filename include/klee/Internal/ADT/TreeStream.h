@@ -10,44 +10,64 @@
 #ifndef __UTIL_TREESTREAM_H__
 #define __UTIL_TREESTREAM_H__
 
-#include <string>
 #include <vector>
 
+#include <stdint.h>
+
 namespace klee {
 
   typedef unsigned TreeStreamID;
   class TreeOStream;
 
+  /// Records a tree of bit streams, such as the branch decisions taken by
+  /// each execution state. A stream opened from another one shares its
+  /// contents up to that point, so the tree follows the process tree: a fork
+  /// costs one node, and every recorded decision a single bit in the node of
+  /// the state that took it. Closing a stream releases its node once no
+  /// stream opened from it is still open, and merges it into the remaining
+  /// one if there is a single one left, so the tree only keeps the nodes
+  /// where live streams branch. The ids of released nodes are reused.
   class TreeStreamWriter {
-    static const unsigned bufferSize = 4*4096;
-
     friend class TreeOStream;
 
   private:
-    char buffer[bufferSize];
-    unsigned lastID, bufferCount;
-
-    std::string path;
-    std::ofstream *output;
-    unsigned ids;
-
-    void write(TreeOStream &os, const char *s, unsigned size);
-    void flushBuffer();
+    struct Node {
+      TreeStreamID parent;
+      /// Length of the parent node when this one was opened from it.
+      uint64_t forkPosition;
+      /// Number of bits in this node.
+      uint64_t length;
+      std::vector<uint64_t> bits;
+      /// The live nodes opened from this one.
+      std::vector<TreeStreamID> children;
+      bool closed;
+
+      Node(TreeStreamID _parent, uint64_t _forkPosition)
+        : parent(_parent), forkPosition(_forkPosition), length(0),
+          closed(false) {}
+    };
+
+    /// Indexed by stream id, node 0 is the empty root all streams start from.
+    std::vector<Node> nodes;
+    /// Ids of released nodes.
+    std::vector<TreeStreamID> freeIDs;
+
+    void write(TreeOStream &os, bool bit);
+    void collapse(TreeStreamID id);
+    void mergeIntoChild(TreeStreamID id);
 
   public:
-    TreeStreamWriter(const std::string &_path);
+    TreeStreamWriter();
     ~TreeStreamWriter();
 
-    bool good();
-
     TreeOStream open();
     TreeOStream open(const TreeOStream &node);
+    /// Closes \a os, which must not be written to or read afterwards.
+    void close(TreeOStream &os);
 
-    void flush();
-
-    // hack, to be replace by proper stream capabilities
-    void readStream(TreeStreamID id,
-                    std::vector<unsigned char> &out);
+    /// Returns the whole contents of a stream, including those it shares
+    /// with the streams it was opened from.
+    void readStream(TreeStreamID id, std::vector<bool> &out);
   };
 
   class TreeOStream {
@@ -65,11 +85,7 @@ namespace klee {
 
     unsigned getID() const;
 
-    void write(const char *buffer, unsigned size);
-
-    TreeOStream &operator<<(const std::string &s);
-
-    void flush();
+    void writeBit(bool bit);
   };
 }
 
@@ -15,8 +15,55 @@
 namespace klee {
   class MemoryObject;
 
+  /// A register of a stack frame or an entry of the constant table.
+  ///
+  /// Concrete integers of at most 64 bits are also kept unboxed in bits, so
+  /// that instructions on concrete operands can compute their result without
+  /// allocating a ConstantExpr. Such a result is only boxed into value when
+  /// somebody asks for it as an expression.
   struct Cell {
+    /// The value of the cell. Null for an unboxed value until box() is called.
     ref<Expr> value;
+    /// The unboxed value, valid iff width is non-zero.
+    uint64_t bits;
+    Expr::Width width;
+
+    Cell() : bits(0), width(0) {}
+
+    bool isUnboxed() const { return width != 0; }
+
+    /// Binds an expression, keeping an unboxed copy of small constants.
+    void set(const ref<Expr> &e) {
+      value = e;
+      width = 0;
+      if (ConstantExpr *CE = dyn_cast_or_null<ConstantExpr>(e.get())) {
+        if (CE->getWidth() <= 64) {
+          bits = CE->getZExtValue();
+          width = CE->getWidth();
+        }
+      }
+    }
+
+    /// Binds a concrete integer without creating an expression for it.
+    void setUnboxed(uint64_t v, Expr::Width w) {
+      value = ref<Expr>();
+      bits = w < 64 ? v & ((UINT64_C(1) << w) - 1) : v;
+      width = w;
+    }
+
+    /// Makes sure value holds the expression for an unboxed value.
+    void box() {
+      if (!width || !value.isNull())
+        return;
+      // Branch conditions are boxed on every branch, share the two booleans.
+      if (width == Expr::Bool) {
+        static const ref<Expr> False = ConstantExpr::create(0, Expr::Bool);
+        static const ref<Expr> True = ConstantExpr::create(1, Expr::Bool);
+        value = bits ? True : False;
+      } else {
+        value = ConstantExpr::create(bits, width);
+      }
+    }
   };
 }
 
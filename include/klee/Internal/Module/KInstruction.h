@@ -16,15 +16,18 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <utility>
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
 }
 
 namespace klee {
   class Executor;
   struct InstructionInfo;
+  struct KFunction;
   class KModule;
 
 
@@ -59,6 +62,43 @@ namespace klee {
     /// instruction.
     uint64_t offset;
   };
+
+  struct KAllocaInstruction : KInstruction {
+    /// inFrame - Whether the alloca is placed in the frame block of its
+    /// function, which holds the fixed-size allocas of the entry block.
+    bool inFrame;
+
+    /// offset, size - The place of the allocation in the frame block.
+    uint64_t offset;
+    uint64_t size;
+
+    KAllocaInstruction() : inFrame(false), offset(0), size(0) {}
+  };
+
+  /// KCallTarget - A function a call dispatches to, with what the executor
+  /// needs to dispatch to it bound ahead of the call.
+  struct KCallTarget {
+    llvm::Function *function;
+    /// The KFunction of a function defined in the module.
+    KFunction *kf;
+    /// The index of the special function handler of a declaration, or -1.
+    int special;
+    /// The stub calling an external function, created by the first call.
+    llvm::Function *dispatcher;
+
+    KCallTarget() : function(0), kf(0), special(-1), dispatcher(0) {}
+  };
+
+  struct KCallInstruction : KInstruction {
+    /// direct - The target of a direct call. Its function is null for
+    /// indirect calls and inline assembly.
+    KCallTarget direct;
+
+    /// targets - An inline cache of the targets an indirect call was seen
+    /// to call, by address. Call sites that call more targets than the
+    /// cache holds resolve the others on every call.
+    std::vector<std::pair<uint64_t, KCallTarget> > targets;
+  };
 }
 
 #endif
@@ -36,6 +36,7 @@ namespace klee {
   class Expr;
   class InterpreterHandler;
   class InstructionInfoTable;
+  struct KAllocaInstruction;
   struct KInstruction;
   class KModule;
   template<class T> class ref;
@@ -50,6 +51,12 @@ namespace klee {
 
     std::map<llvm::BasicBlock*, unsigned> basicBlockEntry;
 
+    /// The allocas placed in the frame block, and the size and alignment
+    /// of the block. The size is zero if there are none.
+    std::vector<KAllocaInstruction*> frameAllocas;
+    uint64_t frameSize;
+    size_t frameAlignment;
+
     /// Whether instructions in this function should count as
     /// "coverable" for statistics and search heuristics.
     bool trackCoverage;
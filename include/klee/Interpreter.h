@@ -56,12 +56,15 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    bool CheckFPDivZero;
 
     ModuleOptions(const std::string &_LibraryDir,
                   const std::string &_EntryPoint, bool _Optimize,
-                  bool _CheckDivZero, bool _CheckOvershift)
+                  bool _CheckDivZero, bool _CheckOvershift,
+                  bool _CheckFPDivZero)
         : LibraryDir(_LibraryDir), EntryPoint(_EntryPoint), Optimize(_Optimize),
-          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift) {}
+          CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift),
+          CheckFPDivZero(_CheckFPDivZero) {}
   };
 
   enum LogType
@@ -156,6 +159,10 @@ public:
 
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) = 0;
+
+  /// Returns true if the state executed long double code with double
+  /// precision, so its test cases may not reproduce natively.
+  virtual bool isLongDoubleDowngraded(const ExecutionState &state) = 0;
 };
 
 } // End klee namespace
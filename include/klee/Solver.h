@@ -289,6 +289,22 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createFastCexSolver(Solver *s);
 
+  /// createRealRelaxationSolver - Create a solver which tries to answer
+  /// floating-point queries by solving them over the reals, rounding the
+  /// model to floats and validating it. Queries it cannot answer go to the
+  /// underlying solver. Requires Z3.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createRealRelaxationSolver(Solver *s);
+
+  /// createIntegralFloatSolver - Create a solver which rewrites comparisons
+  /// and integer conversions of floating-point terms that provably hold
+  /// exactly representable integers into bitvector arithmetic before
+  /// propagating the query to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createIntegralFloatSolver(Solver *s);
+
   /// createIndependentSolver - Create a solver which will eliminate any
   /// unnecessary constraints before propogating the query to the underlying
   /// solver.
@@ -296,6 +312,18 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createIndependentSolver(Solver *s);
   
+  /// createAdaptiveSolver - Create a solver which puts the layer built by
+  /// \a createLayer on top of \a s, but sends queries straight to \a s while
+  /// the layer costs more time than it saves. The decision is revisited
+  /// periodically.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param createLayer - The constructor of the layer, e.g.
+  /// createCexCachingSolver.
+  /// \param name - The name of the layer, used for debugging output.
+  Solver *createAdaptiveSolver(Solver *s, Solver *(*createLayer)(Solver *),
+                               const char *name);
+
   /// createKQueryLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .kquery format.
   Solver *createKQueryLoggingSolver(Solver *s, std::string path,
@@ -313,6 +341,21 @@ namespace klee {
 
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
+
+  /// getSolverMemoryUsage - Bytes currently allocated inside the core solver
+  /// library, which does not go through the allocator KLEE accounts for.
+  /// This covers every solver instance in the process, not a single context.
+  /// Returns 0 when the core solver does not report its usage.
+  uint64_t getSolverMemoryUsage();
+
+  /// getSolverCacheMemoryUsage - Estimated bytes held by the caching layers
+  /// of all solver chains.
+  uint64_t getSolverCacheMemoryUsage();
+
+  /// shrinkSolverCaches - Evict about half of the contents of every solver
+  /// cache, least recently used first, to relieve memory pressure. Returns
+  /// the estimated number of bytes released.
+  uint64_t shrinkSolverCaches();
 }
 
 #endif
@@ -15,6 +15,8 @@
 namespace klee {
 namespace stats {
 
+  extern Statistic adaptiveBypassedQueries;
+  extern Statistic adaptiveLayerBypasses;
   extern Statistic cexCacheTime;
   extern Statistic queries;
   extern Statistic queriesInvalid;
@@ -27,6 +29,11 @@ namespace stats {
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
   extern Statistic queryTime;
+  extern Statistic integralFloatQueries;
+  extern Statistic integralFloatRewrites;
+  extern Statistic realRelaxationHits;
+  extern Statistic realRelaxationQueries;
+  extern Statistic z3ContextRecycles;
   
 #ifdef DEBUG
   extern Statistic arrayHashTime;
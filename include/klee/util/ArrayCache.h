@@ -22,6 +22,7 @@
 #define unordered_set std::tr1::unordered_set
 #endif
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -38,7 +39,7 @@ struct EquivArrayCmpFn {
 /// Provides an interface for creating and destroying Array objects.
 class ArrayCache {
 public:
-  ArrayCache() {}
+  ArrayCache() : constantArrayBytes(0) {}
   ~ArrayCache();
   /// Create an Array object.
   //
@@ -67,12 +68,23 @@ public:
                            Expr::Width _domain = Expr::Int32,
                            Expr::Width _range = Expr::Int8);
 
+  /// Returns a constant byte array holding \a contents. Constant arrays
+  /// created this way are cached by their contents, so asking twice for the
+  /// same bytes returns the same array. Like all arrays they live as long as
+  /// the cache, so no new array is created, and null is returned, once the
+  /// arrays created this way would hold more than \a maxBytes bytes.
+  const Array *getConstantArray(const std::vector<uint8_t> &contents,
+                                uint64_t maxBytes);
+
 private:
   typedef unordered_set<const Array *, klee::ArrayHashFn,
                         klee::EquivArrayCmpFn> ArrayHashMap;
   ArrayHashMap cachedSymbolicArrays;
+  /// Total size of the arrays created by getConstantArray.
+  uint64_t constantArrayBytes;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  std::map<std::vector<uint8_t>, const Array *> constantArraysByContents;
 };
 }
 
@@ -22,6 +22,14 @@ private:
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
+  /// Mask of the bits of word \a w that lie in [begin, end).
+  static uint32_t wordMask(unsigned w, unsigned begin, unsigned end) {
+    unsigned lo = begin > w*32 ? begin - w*32 : 0;
+    unsigned hi = end - w*32 < 32 ? end - w*32 : 32;
+    uint32_t mask = hi == 32 ? 0xFFFFFFFF : (1u<<hi) - 1;
+    return mask & ~((1u<<lo) - 1);
+  }
+
 public:
   BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
     memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
@@ -35,6 +43,20 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  // Operations on the bits in [begin, end), a word at a time.
+  bool isAllOnes(unsigned begin, unsigned end) {
+    for (unsigned w = begin/32; w*32 < end; ++w) {
+      uint32_t mask = wordMask(w, begin, end);
+      if ((bits[w] & mask) != mask)
+        return false;
+    }
+    return true;
+  }
+  void setRange(unsigned begin, unsigned end) {
+    for (unsigned w = begin/32; w*32 < end; ++w)
+      bits[w] |= wordMask(w, begin, end);
+  }
 };
 
 } // End klee namespace
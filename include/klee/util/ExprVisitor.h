@@ -115,6 +115,7 @@ namespace klee {
     virtual Action visitFRem(const FRemExpr&);
     virtual Action visitFMin(const FMinExpr&);
     virtual Action visitFMax(const FMaxExpr&);
+    virtual Action visitFFma(const FFmaExpr&);
 
   private:
     typedef ExprHashMap< ref<Expr> > visited_ty;
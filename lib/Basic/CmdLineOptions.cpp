@@ -21,6 +21,20 @@ UseFastCexSolver("use-fast-cex-solver",
 		 llvm::cl::init(false),
 		 llvm::cl::desc("(default=off)"));
 
+llvm::cl::opt<bool>
+UseRealRelaxationSolver("use-real-relaxation-solver",
+                        llvm::cl::init(false),
+                        llvm::cl::desc("Try to solve floating-point queries "
+                                       "over the reals before using the "
+                                       "core solver (default=off)"));
+
+llvm::cl::opt<bool>
+UseIntegralFloatSolver("use-integral-float-solver",
+                       llvm::cl::init(false),
+                       llvm::cl::desc("Rewrite floating-point terms that only "
+                                      "hold small integers into bitvector "
+                                      "arithmetic (default=off)"));
+
 llvm::cl::opt<bool>
 UseCexCache("use-cex-cache",
             llvm::cl::init(true),
@@ -36,6 +50,14 @@ UseIndependentSolver("use-independent-solver",
                      llvm::cl::init(true),
                      llvm::cl::desc("Use constraint independence (default=on)"));
 
+llvm::cl::opt<bool>
+UseAdaptiveSolverChain("use-adaptive-solver-chain",
+                       llvm::cl::init(false),
+                       llvm::cl::desc("Measure the optional solver chain "
+                                      "layers at runtime and bypass those "
+                                      "that cost more than they save "
+                                      "(default=off)"));
+
 llvm::cl::opt<bool>
 DebugValidateSolver("debug-validate-solver",
 		             llvm::cl::init(false));
@@ -16,6 +16,13 @@
 #include "llvm/Support/raw_ostream.h"
 
 namespace klee {
+static Solver *addLayer(Solver *solver, Solver *(*createLayer)(Solver *),
+                        const char *name) {
+  if (UseAdaptiveSolverChain)
+    return createAdaptiveSolver(solver, createLayer, name);
+  return createLayer(solver);
+}
+
 Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
@@ -38,16 +45,22 @@ Solver *constructSolverChain(Solver *coreSolver,
   }
 
   if (UseFastCexSolver)
-    solver = createFastCexSolver(solver);
+    solver = addLayer(solver, createFastCexSolver, "fast-cex");
+
+  if (UseRealRelaxationSolver)
+    solver = addLayer(solver, createRealRelaxationSolver, "real-relaxation");
+
+  if (UseIntegralFloatSolver)
+    solver = addLayer(solver, createIntegralFloatSolver, "integral-float");
 
   if (UseCexCache)
-    solver = createCexCachingSolver(solver);
+    solver = addLayer(solver, createCexCachingSolver, "cex-cache");
 
   if (UseCache)
-    solver = createCachingSolver(solver);
+    solver = addLayer(solver, createCachingSolver, "cache");
 
   if (UseIndependentSolver)
-    solver = createIndependentSolver(solver);
+    solver = addLayer(solver, createIndependentSolver, "independent");
 
   if (DebugValidateSolver)
     solver = createValidatingSolver(solver, coreSolver);
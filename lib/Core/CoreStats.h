@@ -47,6 +47,10 @@ namespace stats {
   /// distance to a function return.
   extern Statistic minDistToReturn;
 
+  /// The number of x86_fp80 instructions executed with double precision
+  /// under -long-double-as-double.
+  extern Statistic longDoubleDowngrades;
+
 }
 }
 
@@ -25,6 +25,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <cassert>
@@ -45,26 +46,50 @@ namespace {
 
 /***/
 
-StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
-  : caller(_caller), kf(_kf), callPathNode(0), 
-    minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
+StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf, Cell *_locals)
+  : caller(_caller), kf(_kf), callPathNode(0), locals(_locals),
+    frameAddress(0), minDistToUncoveredOnReturn(0), varargs(0) {
 }
 
-StackFrame::StackFrame(const StackFrame &s) 
-  : caller(s.caller),
-    kf(s.kf),
-    callPathNode(s.callPathNode),
-    allocas(s.allocas),
-    minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+/***/
+
+RegisterStack::~RegisterStack() {
+  for (std::vector<Chunk>::iterator it = chunks.begin(), ie = chunks.end();
+       it != ie; ++it)
+    delete[] it->cells;
+}
+
+Cell *RegisterStack::allocate(unsigned n) {
+  if (!chunks.empty() && chunks[top].size - chunks[top].used < n) {
+    // Leave the rest of the chunk unused until it is on top again.
+    ++top;
+    if (top < chunks.size() && chunks[top].size < n) {
+      for (unsigned i = top; i < chunks.size(); ++i)
+        delete[] chunks[i].cells;
+      chunks.resize(top);
+    }
+  }
+  if (top == chunks.size()) {
+    Chunk c;
+    c.size = std::max(n, chunks.empty() ? 128u : 2 * chunks.back().size);
+    c.cells = new Cell[c.size];
+    c.used = 0;
+    chunks.push_back(c);
+  }
+
+  Chunk &c = chunks[top];
+  Cell *cells = c.cells + c.used;
+  c.used += n;
+  return cells;
 }
 
-StackFrame::~StackFrame() { 
-  delete[] locals; 
+void RegisterStack::release(Cell *cells, unsigned n) {
+  Chunk &c = chunks[top];
+  assert(cells + n == c.cells + c.used && "registers released out of order");
+  std::fill(cells, cells + n, Cell());
+  c.used -= n;
+  while (top > 0 && chunks[top].used == 0)
+    --top;
 }
 
 /***/
@@ -81,15 +106,21 @@ ExecutionState::ExecutionState(KFunction *kf) :
     coveredNew(false),
     forkDisabled(false),
     ptreeNode(0),
+    stateSetSlot(0),
+    countedInfo(0),
+    countedCallPathNode(0),
 
-    roundingMode(llvm::APFloat::rmNearestTiesToEven) {
+    roundingMode(llvm::APFloat::rmNearestTiesToEven),
+    longDoubleDowngraded(false) {
   pushFrame(0, kf);
   fegetenv(&fEnv);
 }
 
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
     : constraints(assumptions), uniqueID(0), queryCost(0.),
-      ptreeNode(0), roundingMode(llvm::APFloat::rmNearestTiesToEven) {
+      ptreeNode(0), stateSetSlot(0), countedInfo(0), countedCallPathNode(0),
+      roundingMode(llvm::APFloat::rmNearestTiesToEven),
+      longDoubleDowngraded(false) {
   fegetenv(&fEnv);
 }
 
@@ -128,14 +159,26 @@ ExecutionState::ExecutionState(const ExecutionState& state):
     forkDisabled(state.forkDisabled),
     coveredLines(state.coveredLines),
     ptreeNode(state.ptreeNode),
+    stateSetSlot(0),
+    countedInfo(0),
+    countedCallPathNode(0),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
 
     roundingMode(state.roundingMode),
-    fEnv(state.fEnv)
+    symbolicRoundingMode(state.symbolicRoundingMode),
+    fEnv(state.fEnv),
+    longDoubleDowngraded(state.longDoubleDowngraded)
 {
   for (unsigned int i=0; i<symbolics.size(); i++)
     symbolics[i].first->refCount++;
+
+  for (stack_ty::iterator it = stack.begin(), ie = stack.end(); it != ie;
+       ++it) {
+    Cell *locals = registers.allocate(it->kf->numRegisters);
+    std::copy(it->locals, it->locals + it->kf->numRegisters, locals);
+    it->locals = locals;
+  }
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -152,7 +195,7 @@ ExecutionState *ExecutionState::branch() {
 }
 
 void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
-  stack.push_back(StackFrame(caller,kf));
+  stack.push_back(StackFrame(caller, kf, registers.allocate(kf->numRegisters)));
 }
 
 void ExecutionState::popFrame() {
@@ -160,6 +203,7 @@ void ExecutionState::popFrame() {
   for (std::vector<const MemoryObject*>::iterator it = sf.allocas.begin(), 
          ie = sf.allocas.end(); it != ie; ++it)
     addressSpace.unbindObject(*it);
+  registers.release(sf.locals, sf.kf->numRegisters);
   stack.pop_back();
 }
 
@@ -323,7 +367,9 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
+      af.locals[i].box();
+      bf.locals[i].box();
+      ref<Expr> av = af.locals[i].value;
       const ref<Expr> &bv = bf.locals[i].value;
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
@@ -332,11 +378,11 @@ bool ExecutionState::merge(const ExecutionState &b) {
         if (isa<FExpr>(av))
         {
           assert(isa<FExpr>(bv));
-          av = FSelectExpr::create(inA, av, bv);
+          af.locals[i].set(FSelectExpr::create(inA, av, bv));
         }
         else
         {
-          av = SelectExpr::create(inA, av, bv);
+          af.locals[i].set(SelectExpr::create(inA, av, bv));
         }
       }
     }
@@ -390,7 +436,9 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      Cell &arg = sf.locals[sf.kf->getArgRegister(index++)];
+      arg.box();
+      ref<Expr> value = arg.value;
       if (value.get() && isa<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -101,9 +101,13 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <set>
 #include <string>
 
 #include <sys/mman.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
 
 #include <errno.h>
 #include <cxxabi.h>
@@ -322,6 +326,13 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+  cl::opt<bool>
+  LongDoubleAsDouble("long-double-as-double",
+            cl::desc("Execute x86_fp80 values with double precision. This "
+                     "avoids slow 80-bit float queries but changes results "
+                     "of long double code (default=off)"),
+            cl::init(false));
 }
 
 
@@ -351,7 +362,8 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
       processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
-      ivcEnabled(false),
+      ivcEnabled(false), checkDivZero(false), checkOvershift(false),
+      checkFPDivZero(false),
       coreSolverTimeout(MaxCoreSolverTime != 0 && MaxInstructionTime != 0
                             ? std::min(MaxCoreSolverTime, MaxInstructionTime)
                             : std::max(MaxCoreSolverTime, MaxInstructionTime)),
@@ -409,6 +421,9 @@ const Module *Executor::setModule(llvm::Module *module,
   assert(!kmodule && module && "can only register one module"); // XXX gross
   
   kmodule = new KModule(module);
+  checkDivZero = opts.CheckDivZero;
+  checkOvershift = opts.CheckOvershift;
+  checkFPDivZero = opts.CheckFPDivZero;
 
   // Initialize the context.
 #if LLVM_VERSION_CODE <= LLVM_VERSION(3, 1)
@@ -424,6 +439,8 @@ const Module *Executor::setModule(llvm::Module *module,
   specialFunctionHandler->prepare();
   kmodule->prepare(opts, interpreterHandler);
   specialFunctionHandler->bind();
+  bindCallTargets();
+  layoutFrames();
 
   if (StatsTracker::useStatistics() || userSearcherRequiresMD2U()) {
     statsTracker = 
@@ -445,6 +462,7 @@ Executor::~Executor() {
   if (statsTracker)
     delete statsTracker;
   delete solver;
+  deleteFunctionSummaries();
   delete kmodule;
   while(!timers.empty()) {
     delete timers.back();
@@ -718,6 +736,12 @@ void Executor::branch(ExecutionState &state,
     for (unsigned i=1; i<N; ++i) {
       ExecutionState *es = result[theRNG.getInt32() % i];
       ExecutionState *ns = es->branch();
+      // Every state needs a stream of its own, closing a shared one when the
+      // first of them terminates would cut off the others.
+      if (pathWriter)
+        ns->pathOS = pathWriter->open(es->pathOS);
+      if (symPathWriter)
+        ns->symPathOS = symPathWriter->open(es->symPathOS);
       addedStates.push_back(ns);
       result.push_back(ns);
       es->ptreeNode->data = 0;
@@ -919,7 +943,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   if (res==Solver::True) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "1";
+        current.pathOS.writeBit(true);
       }
     }
 
@@ -927,7 +951,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   } else if (res==Solver::False) {
     if (!isInternal) {
       if (pathWriter) {
-        current.pathOS << "0";
+        current.pathOS.writeBit(false);
       }
     }
 
@@ -987,15 +1011,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       // is used for both falseState and trueState.
       falseState->pathOS = pathWriter->open(current.pathOS);
       if (!isInternal) {
-        trueState->pathOS << "1";
-        falseState->pathOS << "0";
+        trueState->pathOS.writeBit(true);
+        falseState->pathOS.writeBit(false);
       }
     }
     if (symPathWriter) {
       falseState->symPathOS = symPathWriter->open(current.symPathOS);
       if (!isInternal) {
-        trueState->symPathOS << "1";
-        falseState->symPathOS << "0";
+        trueState->symPathOS.writeBit(true);
+        falseState->symPathOS.writeBit(false);
       }
     }
 
@@ -1067,6 +1091,13 @@ ref<klee::Expr> Executor::evalConstant(const Constant *c) {
     if (const ConstantInt *ci = dyn_cast<ConstantInt>(c)) {
       return ConstantExpr::alloc(ci->getValue());
     } else if (const ConstantFP *cf = dyn_cast<ConstantFP>(c)) {
+      if (LongDoubleAsDouble && cf->getType()->isX86_FP80Ty()) {
+        APFloat value = cf->getValueAPF();
+        bool losesInfo = false;
+        value.convert(APFloat::IEEEdouble, APFloat::rmNearestTiesToEven,
+                      &losesInfo);
+        return FConstantExpr::alloc(value);
+      }
       return FConstantExpr::alloc(cf->getValueAPF());
     } else if (const GlobalValue *gv = dyn_cast<GlobalValue>(c)) {
       return globalAddresses.find(gv)->second;
@@ -1127,6 +1158,13 @@ ref<klee::Expr> Executor::evalConstant(const Constant *c) {
 
 const Cell& Executor::eval(KInstruction *ki, unsigned index, 
                            ExecutionState &state) const {
+  Cell &c = evalCell(ki, index, state);
+  c.box();
+  return c;
+}
+
+Cell& Executor::evalCell(KInstruction *ki, unsigned index,
+                         ExecutionState &state) const {
   assert(index < ki->inst->getNumOperands());
   int vnumber = ki->operands[index];
 
@@ -1146,12 +1184,12 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).set(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).set(value);
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1316,16 +1354,97 @@ void Executor::stepInstruction(ExecutionState &state) {
     haltExecution = true;
 }
 
+/// Returns \a magnitude with the sign bit of \a sign.
+static ref<Expr> createCopySign(const ref<Expr> &magnitude,
+                                const ref<Expr> &sign) {
+  Expr::Width w = magnitude->getWidth();
+  ref<Expr> signBit = ShlExpr::create(ConstantExpr::alloc(1, w),
+                                      ConstantExpr::alloc(w - 1, w));
+  ref<Expr> bits = OrExpr::create(
+      AndExpr::create(ExplicitIntExpr::create(magnitude, w),
+                      NotExpr::create(signBit)),
+      AndExpr::create(ExplicitIntExpr::create(sign, w), signBit));
+  return ExplicitFloatExpr::create(bits, w);
+}
+
+void Executor::executeFloatIntrinsic(ExecutionState &state,
+                                     KInstruction *ki,
+                                     unsigned id,
+                                     std::vector< ref<Expr> > &arguments) {
+  // only Z3 handles symbolic floats, other solvers get concrete operands as
+  // for the floating-point instructions
+  if (CoreSolverToUse != Z3_SOLVER)
+    for (unsigned j = 0; j < arguments.size(); ++j)
+      arguments[j] = toConstant(state, arguments[j], "floating point");
+
+  ref<Expr> result;
+  switch (id) {
+  case Intrinsic::fma:
+    result = createRounded(state, Expr::FFma, arguments[0], arguments[1], 0,
+                           arguments[2]);
+    break;
+  case Intrinsic::fmuladd:
+    // the fusion is optional, so do what the unfused native code does
+    result = createRounded(state, Expr::FAdd,
+                           createRounded(state, Expr::FMul, arguments[0],
+                                         arguments[1]),
+                           arguments[2]);
+    break;
+  case Intrinsic::floor:
+    result = FNearbyIntExpr::create(arguments[0],
+                                    llvm::APFloat::rmTowardNegative);
+    break;
+  case Intrinsic::ceil:
+    result = FNearbyIntExpr::create(arguments[0],
+                                    llvm::APFloat::rmTowardPositive);
+    break;
+  case Intrinsic::trunc:
+    result = FNearbyIntExpr::create(arguments[0], llvm::APFloat::rmTowardZero);
+    break;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+  case Intrinsic::rint:
+  case Intrinsic::nearbyint:
+    result = createRounded(state, Expr::FNearbyInt, arguments[0]);
+    break;
+  case Intrinsic::round:
+    result = FNearbyIntExpr::create(arguments[0],
+                                    llvm::APFloat::rmNearestTiesToAway);
+    break;
+  case Intrinsic::copysign:
+    result = createCopySign(arguments[0], arguments[1]);
+    break;
+#endif
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 6)
+  case Intrinsic::minnum:
+    result = FMinExpr::create(arguments[0], arguments[1]);
+    break;
+  case Intrinsic::maxnum:
+    result = FMaxExpr::create(arguments[0], arguments[1]);
+    break;
+#endif
+  default:
+    assert(0 && "invalid floating-point intrinsic");
+  }
+  bindLocal(ki, state, result);
+}
+
 void Executor::executeCall(ExecutionState &state, 
                            KInstruction *ki,
                            Function *f,
-                           std::vector< ref<Expr> > &arguments) {
+                           std::vector< ref<Expr> > &arguments,
+                           KCallTarget *target) {
+  KCallTarget unbound;
+  if (!target) {
+    bindCallTarget(unbound, f);
+    target = &unbound;
+  }
+
   Instruction *i = ki->inst;
   if (f && f->isDeclaration()) {
     switch(f->getIntrinsicID()) {
     case Intrinsic::not_intrinsic:
       // state may be destroyed by this call, cannot touch
-      callExternalFunction(state, ki, f, arguments);
+      callExternalFunction(state, ki, *target, arguments);
       break;
         
       // va_arg is handled by caller and intrinsic lowering, see comment for
@@ -1373,6 +1492,24 @@ void Executor::executeCall(ExecutionState &state,
       // with vaeend, however (like call it twice).
       break;
         
+    case Intrinsic::fma:
+    case Intrinsic::fmuladd:
+    case Intrinsic::floor:
+    case Intrinsic::ceil:
+    case Intrinsic::trunc:
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+    case Intrinsic::rint:
+    case Intrinsic::nearbyint:
+    case Intrinsic::round:
+    case Intrinsic::copysign:
+#endif
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 6)
+    case Intrinsic::minnum:
+    case Intrinsic::maxnum:
+#endif
+      executeFloatIntrinsic(state, ki, f->getIntrinsicID(), arguments);
+      break;
+
     case Intrinsic::vacopy:
       // va_copy should have been lowered.
       //
@@ -1389,7 +1526,10 @@ void Executor::executeCall(ExecutionState &state,
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
     // from just an instruction (unlike LLVM).
-    KFunction *kf = kmodule->functionMap[f];
+    KFunction *kf = target->kf;
+    if (executeSummarizedCall(state, ki, kf, arguments))
+      return;
+
     state.pushFrame(state.prevPC, kf);
     state.pc = kf->instructions;
 
@@ -1512,7 +1652,7 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
 
 /// Compute the true target of a function call, resolving LLVM and KLEE aliases
 /// and bitcasts.
-Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
+Function* Executor::getTargetFunction(Value *calledVal, ExecutionState *state) {
   SmallPtrSet<const GlobalValue*, 3> Visited;
 
   Constant *c = dyn_cast<Constant>(calledVal);
@@ -1524,7 +1664,7 @@ Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
       if (!Visited.insert(gv))
         return 0;
 
-      std::string alias = state.getFnAlias(gv->getName());
+      std::string alias = state ? state->getFnAlias(gv->getName()) : "";
       if (alias != "") {
         llvm::Module* currModule = kmodule->module;
         GlobalValue *old_gv = gv;
@@ -1551,13 +1691,393 @@ Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
   }
 }
 
+/// The number of targets the inline cache of an indirect call site holds.
+static const unsigned MaxCallTargets = 4;
+
+void Executor::bindCallTarget(KCallTarget &target, Function *f) {
+  target.function = f;
+  target.kf = 0;
+  target.special = -1;
+  target.dispatcher = 0;
+  if (f->isDeclaration()) {
+    target.special = specialFunctionHandler->getHandlerIndex(f);
+  } else {
+    std::map<llvm::Function*, KFunction*>::iterator it =
+      kmodule->functionMap.find(f);
+    if (it != kmodule->functionMap.end())
+      target.kf = it->second;
+  }
+}
+
+void Executor::bindCallTargets() {
+  for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(),
+         ie = kmodule->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      if (!isa<CallInst>(ki->inst) && !isa<InvokeInst>(ki->inst))
+        continue;
+      CallSite cs(ki->inst);
+      if (Function *f = getTargetFunction(cs.getCalledValue(), 0))
+        bindCallTarget(static_cast<KCallInstruction*>(ki)->direct, f);
+    }
+  }
+}
+
+void Executor::layoutFrames() {
+  uint64_t redZone = memory->getRedZoneSize();
+  for (std::vector<KFunction*>::iterator it = kmodule->functions.begin(),
+         ie = kmodule->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    BasicBlock *entry = &kf->function->getEntryBlock();
+    uint64_t offset = 0;
+    size_t frameAlignment = 0;
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      AllocaInst *ai = dyn_cast<AllocaInst>(kf->instructions[i]->inst);
+      if (!ai || ai->getParent() != entry)
+        continue;
+      uint64_t size =
+        kmodule->targetData->getTypeAllocSize(ai->getAllocatedType());
+      if (ai->isArrayAllocation()) {
+        ConstantInt *count = dyn_cast<ConstantInt>(ai->getArraySize());
+        if (!count)
+          continue;
+        size *= count->getZExtValue();
+      }
+      size_t alignment = getAllocationAlignment(ai);
+
+      KAllocaInstruction *kai =
+        static_cast<KAllocaInstruction*>(kf->instructions[i]);
+      offset = llvm::RoundUpToAlignment(offset, alignment);
+      kai->inFrame = true;
+      kai->offset = offset;
+      kai->size = size;
+      kf->frameAllocas.push_back(kai);
+      // Like the deterministic allocator, keep zero-sized objects apart and
+      // leave a red zone after every object.
+      offset += std::max(size, (uint64_t) 1) + redZone;
+      frameAlignment = std::max(frameAlignment, alignment);
+    }
+    kf->frameSize = offset;
+    kf->frameAlignment = frameAlignment;
+  }
+}
+
 /// TODO remove?
 static bool isDebugIntrinsic(const Function *f, KModule *KM) {
   return false;
 }
 
+/// Returns true if \a i produces or consumes an x86_fp80 value.
+static bool usesLongDouble(const Instruction *i) {
+  if (i->getType()->isX86_FP80Ty())
+    return true;
+  for (unsigned j = 0, e = i->getNumOperands(); j != e; ++j)
+    if (i->getOperand(j)->getType()->isX86_FP80Ty())
+      return true;
+  return false;
+}
+
+static ref<Expr> createRounded(Expr::Kind kind, const ref<Expr> &l,
+                               const ref<Expr> &r, Expr::Width w,
+                               const ref<Expr> &addend,
+                               llvm::APFloat::roundingMode rm) {
+  switch (kind) {
+  case Expr::FAdd: return FAddExpr::create(l, r, rm);
+  case Expr::FSub: return FSubExpr::create(l, r, rm);
+  case Expr::FMul: return FMulExpr::create(l, r, rm);
+  case Expr::FDiv: return FDivExpr::create(l, r, rm);
+  case Expr::FRem: return FRemExpr::create(l, r, rm);
+  case Expr::FFma: return FFmaExpr::create(l, r, addend, rm);
+  case Expr::FSqrt: return FSqrtExpr::create(l, rm);
+  case Expr::FNearbyInt: return FNearbyIntExpr::create(l, rm);
+  case Expr::FExt: return FExtExpr::create(l, w, rm);
+  case Expr::UToF: return UToFExpr::create(l, w, rm);
+  case Expr::SToF: return SToFExpr::create(l, w, rm);
+  default:
+    assert(0 && "invalid rounded expression kind");
+    return l;
+  }
+}
+
+ref<Expr> Executor::createRounded(ExecutionState &state, Expr::Kind kind,
+                                  const ref<Expr> &l, const ref<Expr> &r,
+                                  Expr::Width w, const ref<Expr> &addend) {
+  if (state.symbolicRoundingMode.isNull())
+    return ::createRounded(kind, l, r, w, addend, state.roundingMode);
+
+  static const int modes[] = { FE_DOWNWARD, FE_UPWARD, FE_TOWARDZERO };
+  static const llvm::APFloat::roundingMode rms[] = {
+    llvm::APFloat::rmTowardNegative, llvm::APFloat::rmTowardPositive,
+    llvm::APFloat::rmTowardZero
+  };
+  // fesetround only ever stores valid modes, so to nearest is the default.
+  ref<Expr> result = ::createRounded(kind, l, r, w, addend,
+                                     llvm::APFloat::rmNearestTiesToEven);
+  for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    ref<Expr> isMode =
+      EqExpr::create(state.symbolicRoundingMode,
+                     ConstantExpr::alloc(modes[i], Expr::Int32));
+    result = FSelectExpr::create(isMode,
+                                 ::createRounded(kind, l, r, w, addend, rms[i]),
+                                 result);
+  }
+  return result;
+}
+
+ref<Expr> Executor::getRoundedZero(ExecutionState &state, Expr::Width w) {
+  const llvm::fltSemantics &sem = *fpWidthToSemantics(w);
+  if (state.symbolicRoundingMode.isNull())
+    return FConstantExpr::alloc(APFloat::getZero(
+        sem, state.roundingMode == llvm::APFloat::rmTowardNegative));
+
+  ref<Expr> isDownward =
+    EqExpr::create(state.symbolicRoundingMode,
+                   ConstantExpr::alloc(FE_DOWNWARD, Expr::Int32));
+  return FSelectExpr::create(isDownward,
+                             FConstantExpr::alloc(APFloat::getZero(sem, true)),
+                             FConstantExpr::alloc(APFloat::getZero(sem, false)));
+}
+
+void Executor::concretizeRoundingMode(ExecutionState &state,
+                                      const char *purpose) {
+  if (state.symbolicRoundingMode.isNull())
+    return;
+  ref<ConstantExpr> mode =
+    toConstant(state, state.symbolicRoundingMode, purpose);
+  state.symbolicRoundingMode = ref<Expr>();
+  state.setRoundingMode(mode->getZExtValue());
+  if (fesetround(mode->getZExtValue()) || fegetenv(&state.fEnv))
+    assert(0 && "Unable to set rounding mode");
+}
+
+namespace {
+struct ConstantLessThan {
+  bool operator()(const ref<ConstantExpr> &a,
+                  const ref<ConstantExpr> &b) const {
+    return a->getAPValue().ult(b->getAPValue());
+  }
+};
+}
+
+/// Create the condition that \a e is one of \a values. Runs of consecutive
+/// values are tested as ranges.
+static ref<Expr> createInSet(ref<Expr> e,
+                             std::vector<ref<ConstantExpr> > values) {
+  std::sort(values.begin(), values.end(), ConstantLessThan());
+  ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
+  for (unsigned i = 0, n = values.size(); i < n;) {
+    unsigned j = i;
+    while (j + 1 < n &&
+           values[j + 1]->getAPValue() == values[j]->getAPValue() + 1)
+      ++j;
+    ref<Expr> test;
+    if (i == j)
+      test = EqExpr::create(e, values[i]);
+    else
+      test = AndExpr::create(UleExpr::create(values[i], e),
+                             UleExpr::create(e, values[j]));
+    result = OrExpr::create(test, result);
+    i = j + 1;
+  }
+  return result;
+}
+
+static int64_t signExtend(uint64_t value, Expr::Width width) {
+  if (width >= 64)
+    return (int64_t) value;
+  return (int64_t) (value << (64 - width)) >> (64 - width);
+}
+
+bool Executor::executeUnboxed(ExecutionState &state, KInstruction *ki) {
+  Instruction *i = ki->inst;
+  switch (i->getOpcode()) {
+  case Instruction::PHI: {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
+    getDestCell(state, ki) = evalCell(ki, state.incomingBBIndex, state);
+#else
+    getDestCell(state, ki) = evalCell(ki, state.incomingBBIndex * 2, state);
+#endif
+    return true;
+  }
+
+  case Instruction::Select: {
+    const Cell &cond = evalCell(ki, 0, state);
+    if (!cond.isUnboxed())
+      return false;
+    getDestCell(state, ki) = evalCell(ki, cond.bits ? 1 : 2, state);
+    return true;
+  }
+
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt: {
+    const Cell &src = evalCell(ki, 0, state);
+    Expr::Width width = getWidthForLLVMType(i->getType());
+    if (!src.isUnboxed() || width > 64)
+      return false;
+    uint64_t value = src.bits;
+    if (i->getOpcode() == Instruction::SExt)
+      value = signExtend(value, src.width);
+    getDestCell(state, ki).setUnboxed(value, width);
+    return true;
+  }
+
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::ICmp: {
+    const Cell &left = evalCell(ki, 0, state);
+    const Cell &right = evalCell(ki, 1, state);
+    if (!left.isUnboxed() || !right.isUnboxed())
+      return false;
+    Expr::Width width = left.width;
+    uint64_t l = left.bits, r = right.bits;
+    uint64_t result;
+    switch (i->getOpcode()) {
+    case Instruction::Add: result = l + r; break;
+    case Instruction::Sub: result = l - r; break;
+    case Instruction::Mul: result = l * r; break;
+    case Instruction::And: result = l & r; break;
+    case Instruction::Or:  result = l | r; break;
+    case Instruction::Xor: result = l ^ r; break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      // Leave overshifts to checkShift() and the expression semantics.
+      if (r >= width)
+        return false;
+      if (i->getOpcode() == Instruction::Shl)
+        result = l << r;
+      else if (i->getOpcode() == Instruction::LShr)
+        result = l >> r;
+      else
+        result = signExtend(l, width) >> r;
+      break;
+    default: {
+      bool b;
+      switch (cast<ICmpInst>(i)->getPredicate()) {
+      case ICmpInst::ICMP_EQ:  b = l == r; break;
+      case ICmpInst::ICMP_NE:  b = l != r; break;
+      case ICmpInst::ICMP_UGT: b = l > r; break;
+      case ICmpInst::ICMP_UGE: b = l >= r; break;
+      case ICmpInst::ICMP_ULT: b = l < r; break;
+      case ICmpInst::ICMP_ULE: b = l <= r; break;
+      case ICmpInst::ICMP_SGT: b = signExtend(l, width) > signExtend(r, width); break;
+      case ICmpInst::ICMP_SGE: b = signExtend(l, width) >= signExtend(r, width); break;
+      case ICmpInst::ICMP_SLT: b = signExtend(l, width) < signExtend(r, width); break;
+      case ICmpInst::ICMP_SLE: b = signExtend(l, width) <= signExtend(r, width); break;
+      default:
+        return false;
+      }
+      getDestCell(state, ki).setUnboxed(b, Expr::Bool);
+      return true;
+    }
+    }
+    getDestCell(state, ki).setUnboxed(result, width);
+    return true;
+  }
+
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem: {
+    const Cell &left = evalCell(ki, 0, state);
+    const Cell &right = evalCell(ki, 1, state);
+    if (!left.isUnboxed() || !right.isUnboxed())
+      return false;
+    Expr::Width width = left.width;
+    uint64_t l = left.bits, r = right.bits;
+    int64_t sl = signExtend(l, width), sr = signExtend(r, width);
+    // Leave division by zero to checkDivisor() and the overflowing signed
+    // division by -1 to the expression semantics.
+    if (r == 0 || ((i->getOpcode() == Instruction::SDiv ||
+                    i->getOpcode() == Instruction::SRem) && sr == -1))
+      return false;
+    uint64_t result;
+    switch (i->getOpcode()) {
+    case Instruction::UDiv: result = l / r; break;
+    case Instruction::SDiv: result = sl / sr; break;
+    case Instruction::URem: result = l % r; break;
+    default:                result = sl % sr; break;
+    }
+    getDestCell(state, ki).setUnboxed(result, width);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+bool Executor::checkForError(ExecutionState &state, ref<Expr> error,
+                             const char *message, const char *suffix) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(error)) {
+    if (CE->isFalse())
+      return true;
+    terminateStateOnError(state, message, ReportError, suffix);
+    return false;
+  }
+
+  StatePair branches = fork(state, Expr::createIsZero(error), true);
+  if (branches.second)
+    terminateStateOnError(*branches.second, message, ReportError, suffix);
+  return branches.first != 0;
+}
+
+bool Executor::checkDivisor(ExecutionState &state, ref<Expr> divisor,
+                            bool floating) {
+  ref<Expr> error;
+  if (!floating) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(divisor))
+      if (!CE->isZero())
+        return true;
+    error = Expr::createIsZero(divisor);
+  } else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(divisor)) {
+    // The bits of a concretized float are zero but for the sign.
+    const APInt &bits = CE->getAPValue();
+    if (!bits.isMinValue() && !bits.isMinSignedValue())
+      return true;
+    error = ConstantExpr::alloc(1, Expr::Bool);
+  } else if (FConstantExpr *FCE = dyn_cast<FConstantExpr>(divisor)) {
+    if (!FCE->getAPValue().isZero())
+      return true;
+    error = ConstantExpr::alloc(1, Expr::Bool);
+  } else {
+    Expr::Width width = divisor->getWidth();
+    if (!isa<FExpr>(divisor))
+      divisor = ExplicitFloatExpr::create(divisor, width);
+    error = FOeqExpr::create(divisor, FConstantExpr::alloc(
+                                 APFloat::getZero(*fpWidthToSemantics(width))));
+  }
+  return checkForError(state, error, "divide by zero", "div.err");
+}
+
+bool Executor::checkShift(ExecutionState &state, ref<Expr> shift) {
+  Expr::Width width = shift->getWidth();
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(shift))
+    if (CE->getAPValue().ult(width))
+      return true;
+  return checkForError(state,
+                       UgeExpr::create(shift,
+                                       ConstantExpr::alloc(width, width)),
+                       "overshift error", "overshift.err");
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
+  if (LongDoubleAsDouble && usesLongDouble(i)) {
+    ++stats::longDoubleDowngrades;
+    state.longDoubleDowngraded = true;
+  }
+  if (executeUnboxed(state, ki))
+    return;
   switch (i->getOpcode()) {
     // Control flow
   case Instruction::Ret: {
@@ -1723,57 +2243,88 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         expressionOrder.insert(std::make_pair(value, caseSuccessor));
       }
 
-      // Track default branch values
-      ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
-
-      // iterate through all non-default cases but in order of the expressions
+      // The values leading to each target, and to any case at all.
+      std::map<BasicBlock *, std::vector<ref<ConstantExpr> > > targetValues;
+      std::vector<ref<ConstantExpr> > caseValues;
       for (std::map<ref<Expr>, BasicBlock *>::iterator
                it = expressionOrder.begin(),
                itE = expressionOrder.end();
            it != itE; ++it) {
-        ref<Expr> match = EqExpr::create(cond, it->first);
-
-        // Make sure that the default value does not contain this target's value
-        defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
-
-        // Check if control flow could take this case
-        bool result;
-        bool success = solver->mayBeTrue(state, match, result);
+        ref<ConstantExpr> value = cast<ConstantExpr>(it->first);
+        targetValues[it->second].push_back(value);
+        caseValues.push_back(value);
+      }
+      for (std::map<BasicBlock *, std::vector<ref<ConstantExpr> > >::iterator
+               it = targetValues.begin(),
+               itE = targetValues.end();
+           it != itE; ++it)
+        branchTargets[it->first] = createInSet(cond, it->second);
+      ref<Expr> inCases = createInSet(cond, caseValues);
+
+      // Rather than asking the solver about every case, which costs hundreds
+      // of queries for large dispatch tables, ask it for values of the
+      // condition: each value shows one target to be feasible, and then that
+      // target is excluded (or, for the default, everything but the cases)
+      // until no value is left. This takes one query per feasible target.
+      std::set<BasicBlock *> feasibleTargets;
+      bool defaultFeasible = false;
+      std::vector<const Array *> objects;
+      findSymbolicObjects(cond, objects);
+      ConstraintManager remaining(state.constraints);
+      for (;;) {
+        std::vector< std::vector<unsigned char> > values;
+        bool hasSolution;
+        bool success = solver->getInitialValues(state, remaining, objects,
+                                                values, hasSolution);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
-
-          // Handle the case that a basic block might be the target of multiple
-          // switch cases.
-          // Currently we generate an expression containing all switch-case
-          // values for the same target basic block. We spare us forking too
-          // many times but we generate more complex condition expressions
-          // TODO Add option to allow to choose between those behaviors
-          std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> res =
-              branchTargets.insert(std::make_pair(
-                  caseSuccessor, ConstantExpr::alloc(0, Expr::Bool)));
-
-          res.first->second = OrExpr::create(match, res.first->second);
-
-          // Only add basic blocks which have not been target of a branch yet
-          if (res.second) {
-            bbOrder.push_back(caseSuccessor);
-          }
+        if (!hasSolution)
+          break;
+
+        Assignment model(objects, values);
+        ref<Expr> value = model.evaluate(cond);
+        assert(isa<ConstantExpr>(value) && "model does not fix the condition");
+        std::map<ref<Expr>, BasicBlock *>::iterator it =
+            expressionOrder.find(value);
+        ref<Expr> exclude;
+        if (it != expressionOrder.end()) {
+          bool inserted = feasibleTargets.insert(it->second).second;
+          assert(inserted && "switch target found twice");
+          (void) inserted;
+          exclude = Expr::createIsZero(branchTargets[it->second]);
+        } else {
+          assert(!defaultFeasible && "switch default found twice");
+          defaultFeasible = true;
+          exclude = inCases;
         }
+
+        exclude = remaining.simplifyExpr(exclude);
+        if (exclude->isFalse())
+          break;
+        remaining.addConstraint(exclude);
       }
 
-      // Check if control could take the default case
-      bool res;
-      bool success = solver->mayBeTrue(state, defaultValue, res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
+      for (std::map<ref<Expr>, BasicBlock *>::iterator
+               it = expressionOrder.begin(),
+               itE = expressionOrder.end();
+           it != itE; ++it) {
+        if (feasibleTargets.erase(it->second))
+          bbOrder.push_back(it->second);
+      }
+
+      if (defaultFeasible) {
         std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
-            branchTargets.insert(
-                std::make_pair(si->getDefaultDest(), defaultValue));
+            branchTargets.insert(std::make_pair(si->getDefaultDest(),
+                                                Expr::createIsZero(inCases)));
         if (ret.second) {
           bbOrder.push_back(si->getDefaultDest());
+        } else {
+          // The default is also the target of some cases.
+          ret.first->second = OrExpr::create(ret.first->second,
+                                             Expr::createIsZero(inCases));
+          if (std::find(bbOrder.begin(), bbOrder.end(),
+                        si->getDefaultDest()) == bbOrder.end())
+            bbOrder.push_back(si->getDefaultDest());
         }
       }
 
@@ -1811,10 +2362,21 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Invoke:
   case Instruction::Call: {
     CallSite cs(i);
+    KCallInstruction *kci = static_cast<KCallInstruction*>(ki);
 
     unsigned numArgs = cs.arg_size();
     Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
+    // Direct calls are bound ahead of time, unless the state aliases
+    // functions.
+    Function *f;
+    KCallTarget *target = 0;
+    if (!state.hasFnAliases()) {
+      f = kci->direct.function;
+      if (f)
+        target = &kci->direct;
+    } else {
+      f = getTargetFunction(fp, &state);
+    }
 
     // Skip debug intrinsics, we can't evaluate their metadata arguments.
     if (f && isDebugIntrinsic(f, kmodule))
@@ -1874,10 +2436,37 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         }
       }
 
-      executeCall(state, ki, f, arguments);
+      executeCall(state, ki, f, arguments, target);
     } else {
       ref<Expr> v = eval(ki, 0, state).value;
 
+      // Concrete function pointers go through the inline cache of the call
+      // site, a miss resolves and caches the target.
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(v)) {
+        uint64_t addr = CE->getZExtValue();
+        std::vector<std::pair<uint64_t, KCallTarget> > &targets =
+          kci->targets;
+        unsigned j = 0, e = targets.size();
+        while (j != e && targets[j].first != addr)
+          ++j;
+        if (j == e) {
+          if (!legalFunctions.count(addr)) {
+            terminateStateOnExecError(state, "invalid function pointer");
+            break;
+          }
+          f = (Function*) addr;
+          if (e == MaxCallTargets) {
+            executeCall(state, ki, f, arguments);
+            break;
+          }
+          targets.push_back(std::make_pair(addr, KCallTarget()));
+          bindCallTarget(targets.back().second, f);
+        }
+        executeCall(state, ki, targets[j].second.function, arguments,
+                    &targets[j].second);
+        break;
+      }
+
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
 
@@ -1974,6 +2563,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::UDiv: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkDivZero && !checkDivisor(state, right, false))
+      break;
     ref<Expr> result = UDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -1982,6 +2573,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::SDiv: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkDivZero && !checkDivisor(state, right, false))
+      break;
     ref<Expr> result = SDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -1990,6 +2583,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::URem: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkDivZero && !checkDivisor(state, right, false))
+      break;
     ref<Expr> result = URemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -1998,6 +2593,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::SRem: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkDivZero && !checkDivisor(state, right, false))
+      break;
     ref<Expr> result = SRemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2030,6 +2627,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Shl: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkOvershift && !checkShift(state, right))
+      break;
     ref<Expr> result = ShlExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2038,6 +2637,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::LShr: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkOvershift && !checkShift(state, right))
+      break;
     ref<Expr> result = LShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2046,6 +2647,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::AShr: {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
+    if (checkOvershift && !checkShift(state, right))
+      break;
     ref<Expr> result = AShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2146,6 +2749,11 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
  
     // Memory instructions...
   case Instruction::Alloca: {
+    KAllocaInstruction *kai = static_cast<KAllocaInstruction*>(ki);
+    if (kai->inFrame) {
+      executeFrameAlloc(state, kai);
+      break;
+    }
     AllocaInst *ai = cast<AllocaInst>(i);
     unsigned elementSize = 
       kmodule->targetData->getTypeAllocSize(ai->getAllocatedType());
@@ -2238,12 +2846,20 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     {
       if (!ci->getDestTy()->isFloatingPointTy())
       {
+        // The bits of a downgraded long double are those of its value
+        // widened back to x87 format.
+        if (LongDoubleAsDouble && ci->getSrcTy()->isX86_FP80Ty())
+          result = FExtExpr::create(result, Expr::Fl80, state.roundingMode);
         result = ExplicitIntExpr::create(result, getWidthForLLVMType(ci->getDestTy()));
       }
     }
     else if (ci->getDestTy()->isFloatingPointTy())
     {
-      result = ExplicitFloatExpr::create(result, getWidthForLLVMType(ci->getDestTy()));
+      if (LongDoubleAsDouble && ci->getDestTy()->isX86_FP80Ty())
+        result = FExtExpr::create(ExplicitFloatExpr::create(result, Expr::Fl80),
+                                  Expr::Fl64, state.roundingMode);
+      else
+        result = ExplicitFloatExpr::create(result, getWidthForLLVMType(ci->getDestTy()));
     }
 
     bindLocal(ki, state, result);
@@ -2273,7 +2889,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   } else {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> sum = FAddExpr::create(left, right, state.roundingMode);
+    ref<Expr> sum = createRounded(state, Expr::FAdd, left, right);
 
     ref<Expr> left_negative = FOleExpr::create(left, FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(sum->getWidth()), 1)));
     ref<Expr> right_negative = FOleExpr::create(right, FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(sum->getWidth()), 1)));
@@ -2281,7 +2897,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> sum_is_zero = OrExpr::create(FOeqExpr::create(FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(sum->getWidth()), 1)), sum),
                                            FOeqExpr::create(FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(sum->getWidth()), 0)), sum));
-    ref<Expr> result = FSelectExpr::create(AndExpr::create(sum_is_zero, different_signs), FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(sum->getWidth()), (state.roundingMode == llvm::APFloat::rmTowardNegative))), sum);
+    ref<Expr> result = FSelectExpr::create(AndExpr::create(sum_is_zero, different_signs), getRoundedZero(state, sum->getWidth()), sum);
     bindLocal(ki, state, result);
     break;
   }
@@ -2306,7 +2922,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   } else {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    ref<Expr> difference = FSubExpr::create(left, right, state.roundingMode);
+    ref<Expr> difference = createRounded(state, Expr::FSub, left, right);
 
     ref<Expr> left_negative = FOleExpr::create(left, FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(difference->getWidth()), 1)));
     ref<Expr> right_negative = FOleExpr::create(right, FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(difference->getWidth()), 1)));
@@ -2314,7 +2930,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> difference_is_zero = OrExpr::create(FOeqExpr::create(FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(difference->getWidth()), 1)), difference),
                                                   FOeqExpr::create(FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(difference->getWidth()), 0)), difference));
-    ref<Expr> result = FSelectExpr::create(AndExpr::create(difference_is_zero, same_signs), FConstantExpr::alloc(APFloat::getZero(*fpWidthToSemantics(difference->getWidth()), (state.roundingMode == llvm::APFloat::rmTowardNegative))), difference);
+    ref<Expr> result = FSelectExpr::create(AndExpr::create(difference_is_zero, same_signs), getRoundedZero(state, difference->getWidth()), difference);
     bindLocal(ki, state, result);
     break;
   }
@@ -2340,7 +2956,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   } else {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, FMulExpr::create(left, right, state.roundingMode));
+    bindLocal(ki, state, createRounded(state, Expr::FMul, left, right));
     break;
   }
 
@@ -2352,6 +2968,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FDiv operation");
+    if (checkFPDivZero && !checkDivisor(state, right, true))
+      break;
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
     llvm::APFloat Res(*fpWidthToSemantics(left->getWidth()), left->getAPValue());
@@ -2365,7 +2983,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   } else {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, FDivExpr::create(left, right, state.roundingMode));
+    if (checkFPDivZero && !checkDivisor(state, right, true))
+      break;
+    bindLocal(ki, state, createRounded(state, Expr::FDiv, left, right));
     break;
   }
 
@@ -2390,7 +3010,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   } else {
     ref<Expr> left = eval(ki, 0, state).value;
     ref<Expr> right = eval(ki, 1, state).value;
-    bindLocal(ki, state, FRemExpr::create(left, right, state.roundingMode));
+    bindLocal(ki, state, createRounded(state, Expr::FRem, left, right));
     break;
   }
 
@@ -2435,9 +3055,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   } else {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = FExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()),
-                                        state.roundingMode);
+    ref<Expr> result = createRounded(state, Expr::FExt,
+                                     eval(ki, 0, state).value, ref<Expr>(),
+                                     getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
     break;
   }
@@ -2517,9 +3137,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   } else {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = UToFExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()),
-                                        state.roundingMode);
+    ref<Expr> result = createRounded(state, Expr::UToF,
+                                     eval(ki, 0, state).value, ref<Expr>(),
+                                     getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
     break;
   }
@@ -2539,9 +3159,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   } else {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SToFExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()), 
-                                        state.roundingMode);
+    ref<Expr> result = createRounded(state, Expr::SToF,
+                                     eval(ki, 0, state).value, ref<Expr>(),
+                                     getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
     break;
   }
@@ -2828,26 +3448,45 @@ void Executor::updateStates(ExecutionState *current) {
     searcher->update(current, addedStates, removedStates);
   }
   
-  states.insert(addedStates.begin(), addedStates.end());
+  if (statsTracker && current &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end())
+    statsTracker->stateMoved(*current);
+
+  for (std::vector<ExecutionState *>::iterator it = addedStates.begin(),
+                                               ie = addedStates.end();
+       it != ie; ++it) {
+    states.insert(*it);
+    if (statsTracker)
+      statsTracker->stateAdded(**it);
+  }
   addedStates.clear();
 
   for (std::vector<ExecutionState *>::iterator it = removedStates.begin(),
                                                ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
-    std::set<ExecutionState*>::iterator it2 = states.find(es);
-    assert(it2!=states.end());
-    states.erase(it2);
+    states.erase(es);
+    if (statsTracker)
+      statsTracker->stateRemoved(*es);
     std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
-    processTree->remove(es->ptreeNode);
-    delete es;
+    deleteState(es);
   }
   removedStates.clear();
 }
 
+void Executor::deleteState(ExecutionState *state) {
+  processTree->remove(state->ptreeNode);
+  if (pathWriter)
+    pathWriter->close(state->pathOS);
+  if (symPathWriter)
+    symPathWriter->close(state->symPathOS);
+  delete state;
+}
+
 template <typename TypeIt>
 void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
   ref<ConstantExpr> constantOffset =
@@ -2906,7 +3545,7 @@ void Executor::bindModuleConstants() {
   kmodule->constantTable = new Cell[kmodule->constants.size()];
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.set(evalConstant(kmodule->constants[i]));
   }
 }
 
@@ -2920,6 +3559,13 @@ void Executor::checkMemoryUsage() {
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
                    (memory->getUsedDeterministicSize() >> 20);
 
+    // Solver caches can be refilled, killed states are lost: release cache
+    // memory first and only kill states if that is not enough.
+    if (mbs > MaxMemory) {
+      unsigned released = shrinkSolverCaches() >> 20;
+      mbs -= std::min(mbs, released);
+    }
+
     if (mbs > MaxMemory) {
       if (mbs > MaxMemory + 100) {
         // just guess at how many to kill
@@ -2949,8 +3595,7 @@ void Executor::doDumpStates() {
   if (!DumpStatesOnHalt || states.empty())
     return;
   klee_message("halting execution, dumping remaining states");
-  for (std::set<ExecutionState *>::iterator it = states.begin(),
-                                            ie = states.end();
+  for (StateSet::iterator it = states.begin(), ie = states.end();
        it != ie; ++it) {
     ExecutionState &state = **it;
     stepInstruction(state); // keep stats rolling
@@ -2967,6 +3612,8 @@ void Executor::run(ExecutionState &initialState) {
   initTimers();
 
   states.insert(&initialState);
+  if (statsTracker)
+    statsTracker->stateAdded(initialState);
 
   if (usingSeeds) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
@@ -3025,7 +3672,7 @@ void Executor::run(ExecutionState &initialState) {
 
     // XXX total hack, just because I like non uniform better but want
     // seed results to be equally weighted.
-    for (std::set<ExecutionState*>::iterator
+    for (StateSet::iterator
            it = states.begin(), ie = states.end();
          it != ie; ++it) {
       (*it)->weight = 1.;
@@ -3133,8 +3780,7 @@ void Executor::terminateState(ExecutionState &state) {
     if (it3 != seedMap.end())
       seedMap.erase(it3);
     addedStates.erase(it);
-    processTree->remove(state.ptreeNode);
-    delete &state;
+    deleteState(&state);
   }
 }
 
@@ -3275,6 +3921,11 @@ struct SetStateEnv {
     // set the CPU's fenv to the one saved in the state
     if (fesetenv(&state.fEnv))
       assert(0 && "Unable to set floating-point environment");
+#if defined(__i386__) || defined(__x86_64__)
+    // enable FTZ (bit 15) and DAZ (bit 6) in MXCSR on top of the state's fenv
+    if (FlushDenormals)
+      _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
   }
 
   ~SetStateEnv() {
@@ -3293,13 +3944,16 @@ private:
 
 void Executor::callExternalFunction(ExecutionState &state,
                                     KInstruction *target,
-                                    Function *function,
+                                    KCallTarget &callee,
                                     std::vector< ref<Expr> > &arguments) {
+  Function *function = callee.function;
   SetStateEnv stateEnv(state);
 
   // check if specialFunctionHandler wants it
-  if (specialFunctionHandler->handle(state, function, target, arguments))
+  if (callee.special >= 0) {
+    specialFunctionHandler->handle(state, callee.special, target, arguments);
     return;
+  }
   
   if (NoExternals && !okExternals.count(function->getName())) {
     klee_warning("Calling not-OK external function : %s\n",
@@ -3308,6 +3962,10 @@ void Executor::callExternalFunction(ExecutionState &state,
     return;
   }
 
+  // the external code runs in the host's floating-point environment, which
+  // needs a concrete rounding mode
+  concretizeRoundingMode(state, "rounding mode of external call");
+
   // normal external function handling path
   // allocate 128 bits for each argument (+return value) to support fp80's;
   // we could iterate through all the arguments first and determine the exact
@@ -3315,8 +3973,26 @@ void Executor::callExternalFunction(ExecutionState &state,
   uint64_t *args = (uint64_t*) alloca(2*sizeof(*args) * (arguments.size() + 1));
   memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
   unsigned wordIndex = 2;
+  CallSite cs(target->inst);
   for (std::vector<ref<Expr> >::iterator ai = arguments.begin(), 
        ae = arguments.end(); ai!=ae; ++ai) {
+    // The external code expects a real long double, so widen downgraded
+    // arguments back to x87 format.
+    if (LongDoubleAsDouble &&
+        cs.getArgument(ai - arguments.begin())->getType()->isX86_FP80Ty()) {
+      ref<Expr> arg = toUnique(state, *ai);
+      if (FConstantExpr *fce = dyn_cast<FConstantExpr>(arg)) {
+        llvm::APInt bits = fce->FExt(Expr::Fl80, state.roundingMode)
+                               ->getAPValue().bitcastToAPInt();
+        memcpy(&args[wordIndex], bits.getRawData(), 10);
+        wordIndex += 2;
+        continue;
+      }
+      terminateStateOnExecError(state,
+                                "external call with symbolic argument: " +
+                                function->getName());
+      return;
+    }
     if (AllowExternalSymCalls) { // don't bother checking uniqueness
       ref<Expr> tmp;
       bool success = solver->getValue(state, *ai, tmp);
@@ -3364,7 +4040,10 @@ void Executor::callExternalFunction(ExecutionState &state,
       klee_warning_once(function, "%s", os.str().c_str());
   }
   
-  bool success = externalDispatcher->executeCall(function, target->inst, args);
+  if (!callee.dispatcher)
+    callee.dispatcher = externalDispatcher->getDispatcher(function,
+                                                          target->inst);
+  bool success = externalDispatcher->executeDispatcher(callee.dispatcher, args);
   if (!success) {
     terminateStateOnError(state, "failed external call: " + function->getName(),
                           External);
@@ -3384,6 +4063,12 @@ void Executor::callExternalFunction(ExecutionState &state,
                                              getWidthForLLVMType(resultType));
       bindLocal(target, state, e);
     }
+    else if (LongDoubleAsDouble && resultType->isX86_FP80Ty()) {
+      ref<ConstantExpr> bits =
+          cast<ConstantExpr>(ConstantExpr::fromMemory((void*) args, Expr::Fl80));
+      bindLocal(target, state, bits->ExplicitFloat(Expr::Fl80)->FExt(
+                                   Expr::Fl64, state.roundingMode));
+    }
     else if (resultType->isFloatingPointTy()) {
       ref<Expr> e = FConstantExpr::fromMemory((void*) args,
                                               getWidthForLLVMType(resultType));
@@ -3438,6 +4123,37 @@ ObjectState *Executor::bindObjectInState(ExecutionState &state,
   return os;
 }
 
+void Executor::executeFrameAlloc(ExecutionState &state,
+                                 KAllocaInstruction *kai) {
+  StackFrame &sf = state.stack.back();
+  if (!sf.frameAddress) {
+    KFunction *kf = sf.kf;
+    FrameBlock *frame =
+      memory->allocateFrame(kf->frameSize, kf->frameAlignment);
+    if (!frame) {
+      bindLocal(kai, state,
+                ConstantExpr::alloc(0, Context::get().getPointerWidth()));
+      return;
+    }
+
+    // Bind all objects now, so that a state forked before the other allocas
+    // execute does not share objects it has not bound.
+    for (std::vector<KAllocaInstruction*>::iterator
+           it = kf->frameAllocas.begin(), ie = kf->frameAllocas.end();
+         it != ie; ++it) {
+      MemoryObject *mo = memory->allocateInFrame(frame, (*it)->offset,
+                                                 (*it)->size, (*it)->inst);
+      ObjectState *os = bindObjectInState(state, mo, true);
+      os->initializeToRandom();
+    }
+    sf.frameAddress = frame->address;
+  }
+
+  bindLocal(kai, state,
+            ConstantExpr::create(sf.frameAddress + kai->offset,
+                                 Context::get().getPointerWidth()));
+}
+
 void Executor::executeAlloc(ExecutionState &state,
                             ref<Expr> size,
                             bool isLocal,
@@ -4029,6 +4745,10 @@ void Executor::getCoveredLines(const ExecutionState &state,
   res = state.coveredLines;
 }
 
+bool Executor::isLongDoubleDowngraded(const ExecutionState &state) {
+  return state.longDoubleDowngraded;
+}
+
 void Executor::doImpliedValueConcretization(ExecutionState &state,
                                             ref<Expr> e,
                                             ref<ConstantExpr> value) {
@@ -4064,6 +4784,8 @@ void Executor::doImpliedValueConcretization(ExecutionState &state,
 }
 
 Expr::Width Executor::getWidthForLLVMType(LLVM_TYPE_Q llvm::Type *type) const {
+  if (LongDoubleAsDouble && type->isX86_FP80Ty())
+    return Expr::Fl64;
   return kmodule->targetData->getTypeSizeInBits(type);
 }
 
@@ -21,6 +21,7 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/util/ArrayCache.h"
+#include "StateSet.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "llvm/ADT/Twine.h"
@@ -57,6 +58,7 @@ namespace klee {
   class ExecutionState;
   class ExternalDispatcher;
   class Expr;
+  struct FunctionSummary;
   class InstructionInfoTable;
   struct KFunction;
   struct KInstruction;
@@ -129,7 +131,7 @@ private:
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
   MemoryManager *memory;
-  std::set<ExecutionState*> states;
+  StateSet states;
   StatsTracker *statsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
@@ -195,6 +197,12 @@ private:
   /// false, it is buggy (it needs to validate its writes).
   bool ivcEnabled;
 
+  /// Whether divisions and shifts are checked for division by zero and
+  /// overshift, from the module options. \see checkDivisor(), checkShift()
+  bool checkDivZero;
+  bool checkOvershift;
+  bool checkFPDivZero;
+
   /// The maximum time to allow for a single core solver query.
   /// (e.g. for a single STP query)
   double coreSolverTimeout;
@@ -202,6 +210,11 @@ private:
   /// Assumes ownership of the created array objects
   ArrayCache arrayCache;
 
+  /// Summaries of pure functions, by function and rounding mode. Null for
+  /// functions that cannot be summarized. \see executeSummarizedCall()
+  std::map<std::pair<const llvm::Function*, int>,
+           FunctionSummary*> functionSummaries;
+
   /// File to print executed instructions to
   llvm::raw_ostream *debugInstFile;
 
@@ -211,8 +224,21 @@ private:
   // @brief buffer to store logs before flushing to file
   llvm::raw_string_ostream debugLogBuffer;
 
+  /// Resolve the target of a call. Without a state, the aliases set up
+  /// with klee_alias_function are not resolved.
   llvm::Function* getTargetFunction(llvm::Value *calledVal,
-                                    ExecutionState &state);
+                                    ExecutionState *state);
+
+  /// Bind what is needed to dispatch a call to \a f: its KFunction or its
+  /// special function handler.
+  void bindCallTarget(KCallTarget &target, llvm::Function *f);
+
+  /// Bind the targets of all direct calls in the module.
+  void bindCallTargets();
+
+  /// Place the fixed-size allocas of the entry block of every function in
+  /// its frame block.
+  void layoutFrames();
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
@@ -239,7 +265,7 @@ private:
 
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
-                            llvm::Function *function,
+                            KCallTarget &callee,
                             std::vector< ref<Expr> > &arguments);
 
   ObjectState *bindObjectInState(ExecutionState &state, const MemoryObject *mo,
@@ -282,6 +308,10 @@ private:
                     bool zeroMemory=false,
                     const ObjectState *reallocFrom=0);
 
+  /// Execute an alloca placed in the frame block, allocating the block and
+  /// all objects in it on the first one.
+  void executeFrameAlloc(ExecutionState &state, KAllocaInstruction *kai);
+
   /// Free the given address with checking for errors. If target is
   /// given it will be bound to 0 in the resulting states (this is a
   /// convenience for realloc). Note that this function can cause the
@@ -291,10 +321,27 @@ private:
                    ref<Expr> address,
                    KInstruction *target = 0);
   
+  /// Execute a call to \a f, dispatched through \a target if the caller
+  /// has it bound.
   void executeCall(ExecutionState &state, 
                    KInstruction *ki,
                    llvm::Function *f,
-                   std::vector< ref<Expr> > &arguments);
+                   std::vector< ref<Expr> > &arguments,
+                   KCallTarget *target = 0);
+
+  /// Execute a call with symbolic arguments to a pure, loop-free function
+  /// by instantiating a summary of its paths, without entering it. Returns
+  /// false if the call must be executed normally.
+  bool executeSummarizedCall(ExecutionState &state,
+                             KInstruction *ki,
+                             KFunction *kf,
+                             std::vector< ref<Expr> > &arguments);
+  FunctionSummary *getFunctionSummary(ExecutionState &state, KFunction *kf);
+  bool summarizeBlock(ExecutionState &scratch, llvm::BasicBlock *bb,
+                      llvm::BasicBlock *src, ref<Expr> pathCondition,
+                      std::vector<KInstruction*> &trail,
+                      FunctionSummary &summary);
+  void deleteFunctionSummaries();
                    
   // do address resolution / object binding / out of bounds checking
   // and perform the operation
@@ -333,6 +380,28 @@ private:
   const Cell& eval(KInstruction *ki, unsigned index, 
                    ExecutionState &state) const;
 
+  /// Like eval, but does not box unboxed values.
+  Cell& evalCell(KInstruction *ki, unsigned index,
+                 ExecutionState &state) const;
+
+  /// Executes integer instructions whose operands are all unboxed without
+  /// building expressions. Returns false if the general path must be taken.
+  bool executeUnboxed(ExecutionState &state, KInstruction *ki);
+
+  /// Terminate the states in which \a error may hold with an error and
+  /// constrain \a state by its negation. Returns false if \a state was
+  /// terminated.
+  bool checkForError(ExecutionState &state, ref<Expr> error,
+                     const char *message, const char *suffix);
+
+  /// Check that the divisor of an integer or, if \a floating, a
+  /// floating-point division is not zero. Concrete divisors are checked
+  /// without building expressions.
+  bool checkDivisor(ExecutionState &state, ref<Expr> divisor, bool floating);
+
+  /// Check that a shift amount is less than the width of the shifted value.
+  bool checkShift(ExecutionState &state, ref<Expr> shift);
+
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
@@ -354,6 +423,34 @@ private:
 
   ref<klee::Expr> evalConstantExpr(const llvm::ConstantExpr *ce);
 
+  /// Create the floating-point operation \a kind (FAdd, FSub, FMul, FDiv,
+  /// FRem, FFma, FSqrt, FNearbyInt, FExt, UToF or SToF) rounded with the
+  /// rounding mode of the given state. If the mode is symbolic, the result
+  /// selects between the results for every mode.
+  ///
+  /// \param r The right operand of binary operations and FFma.
+  /// \param w The result width of conversions.
+  /// \param addend The addend of FFma.
+  ref<Expr> createRounded(ExecutionState &state, Expr::Kind kind,
+                          const ref<Expr> &l,
+                          const ref<Expr> &r = ref<Expr>(),
+                          Expr::Width w = 0,
+                          const ref<Expr> &addend = ref<Expr>());
+
+  /// Return a zero of the given width whose sign is that of an exact zero
+  /// sum in the rounding mode of the given state.
+  ref<Expr> getRoundedZero(ExecutionState &state, Expr::Width w);
+
+  /// Execute a floating-point math intrinsic (fma, floor, copysign, ...)
+  /// natively instead of as an external call.
+  void executeFloatIntrinsic(ExecutionState &state, KInstruction *ki,
+                             unsigned id,
+                             std::vector< ref<Expr> > &arguments);
+
+  /// Concretize the rounding mode of the given state if it is symbolic.
+  /// Only valid during external calls, while the state's floating-point
+  /// environment is installed on the host.
+  void concretizeRoundingMode(ExecutionState &state, const char *purpose);
   /// Return a unique constant value for the given expression in the
   /// given state, if it has one (i.e. it provably only has a single
   /// value). Otherwise return the original expression.
@@ -384,6 +481,10 @@ private:
 
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
+
+  /// Release everything the executor keeps for a state that is about to be
+  /// deleted, and delete it.
+  void deleteState(ExecutionState *state);
   // call exit handler and terminate state
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
   // call exit handler and terminate state
@@ -506,6 +607,8 @@ public:
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res);
 
+  virtual bool isLongDoubleDowngraded(const ExecutionState &state);
+
   Expr::Width getWidthForLLVMType(LLVM_TYPE_Q llvm::Type *type) const;
   size_t getAllocationAlignment(const llvm::Value *allocSite) const;
 
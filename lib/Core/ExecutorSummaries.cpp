@@ -0,0 +1,398 @@
+//===-- ExecutorSummaries.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Numeric code calls small pure helpers (clamp, lerp, smoothstep, ...) over
+// and over with symbolic arguments, and every call interprets the helper
+// again and forks on its branches again. For helpers that only compute on
+// registers and have no loops, the executor instead enumerates all paths
+// through the helper once, over placeholder parameters, and records for each
+// path its condition and its result. A call then substitutes its arguments
+// into the summary and binds the call to a single select over the paths,
+// without interpreting the helper or forking.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Executor.h"
+#include "StatsTracker.h"
+#include "TimingSolver.h"
+
+#include "klee/CommandLine.h"
+#include "klee/ExecutionState.h"
+#include "klee/Expr.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/util/ExprVisitor.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#endif
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <map>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<bool>
+  SummarizePureFunctions("summarize-pure-functions",
+                         cl::desc("Execute calls with symbolic arguments to "
+                                  "loop-free functions that only compute on "
+                                  "registers through a summary of all their "
+                                  "paths, without forking (default=off)"),
+                         cl::init(false));
+
+  cl::opt<unsigned>
+  SummaryMaxPaths("summary-max-paths",
+                  cl::desc("Execute functions with more paths than this "
+                           "normally instead of summarizing them "
+                           "(default=16)"),
+                  cl::init(16));
+
+  /// Replaces the placeholder parameters of a summary by the arguments of a
+  /// call. Truncations and bitcasts take the placeholders apart, so every
+  /// read of a placeholder array is rebound to the matching byte of the bits
+  /// of its argument, wherever it occurs.
+  class SummaryInstantiator : public ExprVisitor {
+    const std::map<const Array*, ref<Expr> > &arguments;
+
+  public:
+    SummaryInstantiator(const std::map<const Array*, ref<Expr> > &_arguments)
+      : arguments(_arguments) {}
+
+    Action visitRead(const ReadExpr &re) {
+      std::map<const Array*, ref<Expr> >::const_iterator it =
+        arguments.find(re.updates.root);
+      if (it == arguments.end())
+        return Action::doChildren();
+      // Placeholders are never written and only read at constant offsets.
+      klee::ConstantExpr *index = cast<klee::ConstantExpr>(re.index);
+      assert(!re.updates.head && "write to a summary placeholder");
+      return Action::changeTo(ExtractExpr::create(
+          it->second, index->getZExtValue() * 8, Expr::Int8));
+    }
+  };
+}
+
+namespace klee {
+  /// The paths through a pure function, over placeholder parameters.
+  struct FunctionSummary {
+    struct Path {
+      ref<Expr> condition, result;
+      /// The instructions executed along the path, for coverage.
+      std::vector<KInstruction*> instructions;
+    };
+
+    std::vector<ref<Expr> > parameters;
+    /// The array each parameter is read from.
+    std::vector<const Array*> parameterArrays;
+    /// Every path through the function. The conditions are disjoint and
+    /// cover all inputs.
+    std::vector<Path> paths;
+  };
+}
+
+/// Types a summary can compute with: the ones whose values are plain
+/// expressions of a width the placeholders can be read at.
+static bool isSummaryType(Type *t, bool floats) {
+  if (t->isIntegerTy()) {
+    unsigned width = t->getIntegerBitWidth();
+    return width == 1 || width == 8 || width == 16 || width == 32 ||
+           width == 64;
+  }
+  return floats && (t->isFloatTy() || t->isDoubleTy());
+}
+
+static bool isAcyclic(BasicBlock *bb, std::map<BasicBlock*, bool> &visiting) {
+  std::map<BasicBlock*, bool>::iterator it = visiting.find(bb);
+  if (it != visiting.end())
+    return !it->second;
+  visiting[bb] = true;
+  TerminatorInst *ti = bb->getTerminator();
+  for (unsigned i = 0, e = ti->getNumSuccessors(); i != e; ++i)
+    if (!isAcyclic(ti->getSuccessor(i), visiting))
+      return false;
+  visiting[bb] = false;
+  return true;
+}
+
+/// A function can be summarized if it has no loops and only executes
+/// instructions that compute on registers and can neither fail nor fork.
+/// Floating-point values only qualify with the Z3 solver, the others
+/// concretize them. Divisions and shifts qualify unless they are checked.
+static bool isSummarizable(KFunction *kf, bool checkDivZero,
+                           bool checkOvershift, bool checkFPDivZero) {
+  Function *f = kf->function;
+  bool symbolicFloats = CoreSolverToUse == Z3_SOLVER;
+  if (f->isVarArg() || !isSummaryType(f->getReturnType(), symbolicFloats))
+    return false;
+  for (Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
+       ai != ae; ++ai)
+    if (!isSummaryType(ai->getType(), symbolicFloats))
+      return false;
+
+  for (Function::iterator bb = f->begin(), be = f->end(); bb != be; ++bb) {
+    for (BasicBlock::iterator i = bb->begin(), ie = bb->end(); i != ie; ++i) {
+      switch (i->getOpcode()) {
+      case Instruction::UDiv:
+      case Instruction::SDiv:
+      case Instruction::URem:
+      case Instruction::SRem:
+        if (checkDivZero)
+          return false;
+        break;
+      case Instruction::Shl:
+      case Instruction::LShr:
+      case Instruction::AShr:
+        if (checkOvershift)
+          return false;
+        break;
+      case Instruction::FDiv:
+        if (!symbolicFloats || checkFPDivZero)
+          return false;
+        break;
+      case Instruction::Ret:
+      case Instruction::Br:
+      case Instruction::PHI:
+      case Instruction::Select:
+      case Instruction::Add:
+      case Instruction::Sub:
+      case Instruction::Mul:
+      case Instruction::And:
+      case Instruction::Or:
+      case Instruction::Xor:
+      case Instruction::ICmp:
+      case Instruction::Trunc:
+      case Instruction::ZExt:
+      case Instruction::SExt:
+      case Instruction::BitCast:
+        break;
+      case Instruction::FAdd:
+      case Instruction::FSub:
+      case Instruction::FMul:
+      case Instruction::FRem:
+      case Instruction::FCmp:
+      case Instruction::FPTrunc:
+      case Instruction::FPExt:
+      case Instruction::FPToUI:
+      case Instruction::FPToSI:
+      case Instruction::UIToFP:
+      case Instruction::SIToFP:
+        if (!symbolicFloats)
+          return false;
+        break;
+      default:
+        return false;
+      }
+
+      if (!i->getType()->isVoidTy() &&
+          !isSummaryType(i->getType(), symbolicFloats))
+        return false;
+      for (unsigned j = 0, e = i->getNumOperands(); j != e; ++j) {
+        Value *op = i->getOperand(j);
+        if (!isa<BasicBlock>(op) && !isSummaryType(op->getType(),
+                                                   symbolicFloats))
+          return false;
+      }
+    }
+  }
+
+  std::map<BasicBlock*, bool> visiting;
+  return isAcyclic(&f->getEntryBlock(), visiting);
+}
+
+/// Executes the block \a bb of the function on the scratch state and
+/// continues along every successor, recording the paths that return. Fails
+/// if there are more than -summary-max-paths paths. \a trail holds the
+/// instructions executed on the way to \a bb.
+bool Executor::summarizeBlock(ExecutionState &scratch, BasicBlock *bb,
+                              BasicBlock *src, ref<Expr> pathCondition,
+                              std::vector<KInstruction*> &trail,
+                              FunctionSummary &summary) {
+  transferToBasicBlock(bb, src, scratch);
+  for (;;) {
+    KInstruction *ki = scratch.pc;
+    ++scratch.pc;
+    trail.push_back(ki);
+
+    if (isa<ReturnInst>(ki->inst)) {
+      if (summary.paths.size() >= SummaryMaxPaths)
+        return false;
+      summary.paths.push_back(FunctionSummary::Path());
+      FunctionSummary::Path &path = summary.paths.back();
+      path.condition = pathCondition;
+      path.result = eval(ki, 0, scratch).value;
+      path.instructions = trail;
+      return true;
+    }
+
+    if (BranchInst *bi = dyn_cast<BranchInst>(ki->inst)) {
+      if (bi->isUnconditional())
+        return summarizeBlock(scratch, bi->getSuccessor(0), bb, pathCondition,
+                              trail, summary);
+      // Successors never write the registers of the blocks before them, so
+      // the scratch frame stays valid for the second successor.
+      ref<Expr> cond = eval(ki, 0, scratch).value;
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(cond))
+        return summarizeBlock(scratch, bi->getSuccessor(CE->isTrue() ? 0 : 1),
+                              bb, pathCondition, trail, summary);
+      unsigned branchPoint = trail.size();
+      if (!summarizeBlock(scratch, bi->getSuccessor(0), bb,
+                          AndExpr::create(pathCondition, cond), trail,
+                          summary))
+        return false;
+      trail.resize(branchPoint);
+      return summarizeBlock(scratch, bi->getSuccessor(1), bb,
+                            AndExpr::create(pathCondition,
+                                            Expr::createIsZero(cond)),
+                            trail, summary);
+    }
+
+    executeInstruction(scratch, ki);
+  }
+}
+
+FunctionSummary *Executor::getFunctionSummary(ExecutionState &state,
+                                              KFunction *kf) {
+  std::pair<const Function*, int> key(kf->function, (int) state.roundingMode);
+  std::map<std::pair<const Function*, int>, FunctionSummary*>::iterator it =
+    functionSummaries.find(key);
+  if (it != functionSummaries.end())
+    return it->second;
+
+  FunctionSummary *summary = 0;
+  if (isSummarizable(kf, checkDivZero, checkOvershift, checkFPDivZero)) {
+    Function *f = kf->function;
+    summary = new FunctionSummary();
+
+    ExecutionState scratch((std::vector<ref<Expr> >()));
+    scratch.roundingMode = state.roundingMode;
+    scratch.pushFrame(0, kf);
+
+    unsigned index = 0;
+    for (Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end();
+         ai != ae; ++ai, ++index) {
+      Expr::Width width = getWidthForLLVMType(ai->getType());
+      const Array *array =
+        arrayCache.CreateArray("summary_" + f->getName().str() + "_arg" +
+                                 llvm::utostr(index),
+                               Expr::getMinBytesForWidth(width));
+      ref<Expr> parameter = Expr::createTempRead(array, width);
+      if (ai->getType()->isFloatingPointTy())
+        parameter = ExplicitFloatExpr::create(parameter, width);
+      summary->parameters.push_back(parameter);
+      summary->parameterArrays.push_back(array);
+      bindArgument(kf, index, scratch, parameter);
+    }
+
+    std::vector<KInstruction*> trail;
+    if (!summarizeBlock(scratch, &f->getEntryBlock(), 0,
+                        ConstantExpr::alloc(1, Expr::Bool), trail, *summary)) {
+      delete summary;
+      summary = 0;
+    }
+  }
+
+  functionSummaries[key] = summary;
+  return summary;
+}
+
+bool Executor::executeSummarizedCall(ExecutionState &state, KInstruction *ki,
+                                     KFunction *kf,
+                                     std::vector< ref<Expr> > &arguments) {
+  if (!SummarizePureFunctions || !isa<CallInst>(ki->inst) ||
+      !state.symbolicRoundingMode.isNull())
+    return false;
+
+  Function *f = kf->function;
+  if (arguments.size() != f->arg_size() ||
+      ki->inst->getType() != f->getReturnType())
+    return false;
+
+  // Concrete calls are executed normally, they do not fork anyway.
+  bool symbolic = false;
+  for (unsigned i = 0, e = arguments.size(); i != e; ++i)
+    if (!isa<ConstantExpr>(arguments[i]) && !isa<FConstantExpr>(arguments[i]))
+      symbolic = true;
+  if (!symbolic)
+    return false;
+
+  FunctionSummary *summary = getFunctionSummary(state, kf);
+  if (!summary)
+    return false;
+
+  std::map<const Array*, ref<Expr> > replacements;
+  for (unsigned i = 0, e = arguments.size(); i != e; ++i) {
+    const ref<Expr> &parameter = summary->parameters[i];
+    Expr::Width width = parameter->getWidth();
+    if (arguments[i]->getWidth() != width ||
+        isa<FExpr>(arguments[i]) != isa<FExpr>(parameter))
+      return false;
+    // The bits of the argument, padded to the bytes of its placeholder.
+    ref<Expr> bits = arguments[i];
+    if (isa<FExpr>(bits))
+      bits = ExplicitIntExpr::create(bits, width);
+    bits = ZExtExpr::create(bits, Expr::getMinBytesForWidth(width) * 8);
+    replacements[summary->parameterArrays[i]] = bits;
+  }
+
+  // Paths whose condition is false for these arguments drop out, the last
+  // remaining path needs no condition as the paths cover all inputs.
+  SummaryInstantiator instantiate(replacements);
+  ref<Expr> result;
+  std::vector<std::pair<ref<Expr>, const FunctionSummary::Path*> > taken;
+  for (std::vector<FunctionSummary::Path>::reverse_iterator
+         it = summary->paths.rbegin(), ie = summary->paths.rend();
+       it != ie; ++it) {
+    ref<Expr> cond = instantiate.visit(it->condition);
+    if (cond->isFalse())
+      continue;
+    taken.push_back(std::make_pair(cond, &*it));
+    ref<Expr> value = instantiate.visit(it->result);
+    if (result.isNull())
+      result = value;
+    else if (isa<FExpr>(value))
+      result = FSelectExpr::create(cond, value, result);
+    else
+      result = SelectExpr::create(cond, value, result);
+  }
+  if (result.isNull())
+    return false;
+
+  // The instructions of the function are never stepped, so the paths the call
+  // can take are marked covered here. Only paths that would cover something
+  // new cost a feasibility query.
+  if (statsTracker) {
+    for (unsigned i = 0, e = taken.size(); i != e; ++i) {
+      const std::vector<KInstruction*> &instructions =
+        taken[i].second->instructions;
+      if (!statsTracker->coversNew(instructions))
+        continue;
+      bool feasible;
+      if (solver->mayBeTrue(state, taken[i].first, feasible) && feasible)
+        statsTracker->markCovered(state, kf, instructions);
+    }
+  }
+
+  bindLocal(ki, state, result);
+  return true;
+}
+
+void Executor::deleteFunctionSummaries() {
+  for (std::map<std::pair<const Function*, int>, FunctionSummary*>::iterator
+         it = functionSummaries.begin(), ie = functionSummaries.end();
+       it != ie; ++it)
+    delete it->second;
+  functionSummaries.clear();
+}
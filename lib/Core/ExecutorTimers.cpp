@@ -159,7 +159,7 @@ void Executor::processTimers(ExecutionState *current,
       llvm::raw_ostream *os = interpreterHandler->openOutputFile("states.txt");
       
       if (os) {
-        for (std::set<ExecutionState*>::const_iterator it = states.begin(), 
+        for (StateSet::const_iterator it = states.begin(), 
                ie = states.end(); it != ie; ++it) {
           ExecutionState *es = *it;
           *os << "(" << es << ",";
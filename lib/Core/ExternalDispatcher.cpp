@@ -120,6 +120,10 @@ ExternalDispatcher::~ExternalDispatcher() {
 }
 
 bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args) {
+  return runProtectedCall(getDispatcher(f, i), args);
+}
+
+Function *ExternalDispatcher::getDispatcher(Function *f, Instruction *i) {
   dispatchers_ty::iterator it = dispatchers.find(i);
   Function *dispatcher;
 
@@ -152,7 +156,7 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
     dispatcher = it->second;
   }
 
-  return runProtectedCall(dispatcher, args);
+  return dispatcher;
 }
 
 // FIXME: This is not reentrant.
@@ -44,6 +44,16 @@ namespace klee {
      * into args[0].
      */
     bool executeCall(llvm::Function *function, llvm::Instruction *i, uint64_t *args);
+
+    /* Return the stub that calls the given function using the parameter
+     * passing convention of i, creating it on first use. Null if the
+     * function cannot be resolved. Callers may keep the stub and call it
+     * with executeDispatcher() instead of executeCall().
+     */
+    llvm::Function *getDispatcher(llvm::Function *function, llvm::Instruction *i);
+    bool executeDispatcher(llvm::Function *dispatcher, uint64_t *args) {
+      return runProtectedCall(dispatcher, args);
+    }
     void *resolveSymbol(const std::string &name);
   };  
 }
@@ -32,6 +32,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -42,6 +43,15 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<unsigned>
+  MaxConstantSegmentMemory("max-constant-segment-memory",
+                           cl::desc("Stop snapshotting concrete table "
+                                    "segments into constant arrays once the "
+                                    "snapshots hold this many MB, reads then "
+                                    "go through the object's update list "
+                                    "(default=64)"),
+                           cl::init(64));
 }
 
 /***/
@@ -145,6 +155,7 @@ ObjectState::ObjectState(const ObjectState &os)
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
     updates(os.updates),
+    segments(os.segments),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
@@ -277,11 +288,184 @@ isByteConcrete(i) => !isByteKnownSymbolic(i)
 !isByteFlushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
  */
 
+static uint64_t getMaxValue(Expr::Width w) {
+  return w >= 64 ? UINT64_MAX : (UINT64_C(1) << w) - 1;
+}
+
+/// Computes a conservative range [min, max] of the unsigned values \a e can
+/// take, from the structure of the expression alone.
+static void getUnsignedRange(ref<Expr> e, uint64_t &min, uint64_t &max) {
+  Expr::Width w = e->getWidth();
+  uint64_t limit = getMaxValue(w);
+  min = 0;
+  max = limit;
+  if (w > 64)
+    return;
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    min = max = CE->getZExtValue();
+    return;
+  }
+
+  switch (e->getKind()) {
+  case Expr::ZExt:
+    getUnsignedRange(e->getKid(0), min, max);
+    return;
+
+  case Expr::Extract: {
+    ExtractExpr *ee = cast<ExtractExpr>(e);
+    uint64_t kidMin, kidMax;
+    if (ee->offset == 0) {
+      getUnsignedRange(ee->expr, kidMin, kidMax);
+      if (kidMax <= limit) {
+        min = kidMin;
+        max = kidMax;
+      }
+    }
+    return;
+  }
+
+  case Expr::Add: {
+    uint64_t lMin, lMax, rMin, rMax;
+    getUnsignedRange(e->getKid(0), lMin, lMax);
+    getUnsignedRange(e->getKid(1), rMin, rMax);
+    if (lMax <= limit - rMax) {
+      min = lMin + rMin;
+      max = lMax + rMax;
+    }
+    return;
+  }
+
+  case Expr::Mul: {
+    ConstantExpr *c = dyn_cast<ConstantExpr>(e->getKid(0));
+    uint64_t kidMin, kidMax;
+    if (c) {
+      uint64_t factor = c->getZExtValue();
+      getUnsignedRange(e->getKid(1), kidMin, kidMax);
+      if (factor == 0) {
+        max = 0;
+      } else if (kidMax <= limit / factor) {
+        min = kidMin * factor;
+        max = kidMax * factor;
+      }
+    }
+    return;
+  }
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::UDiv:
+  case Expr::URem:
+  case Expr::And: {
+    ref<Expr> kid = e->getKid(0);
+    ConstantExpr *c = dyn_cast<ConstantExpr>(e->getKid(1));
+    if (!c && e->getKind() == Expr::And) {
+      c = dyn_cast<ConstantExpr>(kid);
+      kid = e->getKid(1);
+    }
+    if (!c)
+      return;
+    uint64_t value = c->getZExtValue();
+    uint64_t kidMin, kidMax;
+    getUnsignedRange(kid, kidMin, kidMax);
+    switch (e->getKind()) {
+    case Expr::Shl:
+      if (value < w && kidMax <= (limit >> value)) {
+        min = kidMin << value;
+        max = kidMax << value;
+      }
+      break;
+    case Expr::LShr:
+      if (value < w) {
+        min = kidMin >> value;
+        max = kidMax >> value;
+      } else {
+        max = 0;
+      }
+      break;
+    case Expr::UDiv:
+      if (value) {
+        min = kidMin / value;
+        max = kidMax / value;
+      }
+      break;
+    case Expr::URem:
+      if (value)
+        max = std::min(kidMax, value - 1);
+      if (kidMax < value)
+        min = kidMin;
+      break;
+    default:
+      max = std::min(kidMax, value);
+      break;
+    }
+    return;
+  }
+
+  case Expr::Select: {
+    uint64_t tMin, tMax, fMin, fMax;
+    getUnsignedRange(e->getKid(1), tMin, tMax);
+    getUnsignedRange(e->getKid(2), fMin, fMax);
+    min = std::min(tMin, fMin);
+    max = std::max(tMax, fMax);
+    return;
+  }
+
+  default:
+    return;
+  }
+}
+
 void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
                                        unsigned *base_r,
                                        unsigned *size_r) const {
   *base_r = 0;
   *size_r = size;
+
+  // Offsets outside the object are excluded by the bounds check, so only the
+  // part of the range inside the object can be read.
+  uint64_t min, max;
+  getUnsignedRange(offset, min, max);
+  if (min >= size)
+    return;
+  *base_r = min;
+  *size_r = std::min(max, (uint64_t) size - 1) - min + 1;
+}
+
+/// Returns a constant array holding bytes [rangeBase, rangeBase+rangeSize)
+/// of the object if they are all concrete and the snapshot budget allows, or
+/// null otherwise. Reading a table at a symbolic index through such a
+/// snapshot keeps the query free of per-byte updates and restricted to the
+/// bytes the index can reach.
+const Array *ObjectState::getConcreteSegment(unsigned rangeBase,
+                                             unsigned rangeSize) const {
+  if (!UseConstantArrays || !rangeSize)
+    return 0;
+  for (unsigned i = rangeBase; i != rangeBase + rangeSize; ++i)
+    if (!isByteConcrete(i))
+      return 0;
+
+  std::map<unsigned, const Array *>::iterator it = segments.find(rangeBase);
+  if (it != segments.end() && it->second->size == rangeSize) {
+    const Array *segment = it->second;
+    unsigned i = 0;
+    for (; i != rangeSize; ++i)
+      if (segment->constantValues[i]->getZExtValue(8) !=
+          concreteStore[rangeBase + i])
+        break;
+    if (i == rangeSize)
+      return segment;
+  }
+
+  std::vector<uint8_t> contents(concreteStore + rangeBase,
+                                concreteStore + rangeBase + rangeSize);
+  // Expressions may refer to a snapshot for the rest of the run, so the
+  // snapshots cannot be freed early and their total size is bounded instead.
+  const Array *segment = getArrayCache()->getConstantArray(
+      contents, (uint64_t) MaxConstantSegmentMemory << 20);
+  if (segment)
+    segments[rangeBase] = segment;
+  return segment;
 }
 
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
@@ -334,6 +518,10 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
   } 
 }
 
+bool ObjectState::isRangeConcrete(unsigned offset, unsigned n) const {
+  return !concreteMask || concreteMask->isAllOnes(offset, offset + n);
+}
+
 bool ObjectState::isByteConcrete(unsigned offset) const {
   return !concreteMask || concreteMask->get(offset);
 }
@@ -462,12 +650,34 @@ ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(offset))
     return read(CE->getZExtValue(32), width);
 
+  // If every byte the offset can reach is concrete, read from a constant
+  // snapshot of just those bytes.
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+  unsigned base, rangeSize;
+  fastRangeCheckOffset(offset, &base, &rangeSize);
+  rangeSize = std::min(rangeSize + NumBytes - 1, size - base);
+  if (const Array *segment = getConcreteSegment(base, rangeSize)) {
+    UpdateList ul(segment, 0);
+    ref<Expr> index =
+        SubExpr::create(ZExtExpr::create(offset, Expr::Int32),
+                        ConstantExpr::create(base, Expr::Int32));
+    if (width == Expr::Bool)
+      return ExtractExpr::create(ReadExpr::create(ul, index), 0, Expr::Bool);
+    ref<Expr> Res(0);
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      ref<Expr> Byte = ReadExpr::create(
+          ul, AddExpr::create(index, ConstantExpr::create(idx, Expr::Int32)));
+      Res = i ? ConcatExpr::create(Byte, Res) : Byte;
+    }
+    return Res;
+  }
+
   // Treat bool specially, it is the only non-byte sized write we allow.
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
   // Otherwise, follow the slow general case.
-  unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid read size!");
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
@@ -482,12 +692,27 @@ ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
 }
 
 ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
+  unsigned NumBytes = width == Expr::Bool ? 1 : width / 8;
+
+  // Fast path: every byte is concrete, build the constant directly.
+  if (width <= 128 && isRangeConcrete(offset, NumBytes)) {
+    if (width == Expr::Bool)
+      return ConstantExpr::create(concreteStore[offset] & 1, Expr::Bool);
+    uint64_t words[2] = { 0, 0 };
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      words[i / 8] |= (uint64_t) concreteStore[offset + idx] << (8 * (i % 8));
+    }
+    if (width <= 64)
+      return ConstantExpr::create(words[0], width);
+    return ConstantExpr::alloc(llvm::APInt(width, 2, words));
+  }
+
   // Treat bool specially, it is the only non-byte sized write we allow.
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
   // Otherwise, follow the slow general case.
-  unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
@@ -536,16 +761,13 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
   // Check for writes of constant values.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     Expr::Width w = CE->getWidth();
-    if (w <= 64 && klee::bits64::isPowerOfTwo(w)) {
-      uint64_t val = CE->getZExtValue();
-      switch (w) {
-      default: assert(0 && "Invalid write size!");
-      case  Expr::Bool:
-      case  Expr::Int8:  write8(offset, val); return;
-      case Expr::Int16: write16(offset, val); return;
-      case Expr::Int32: write32(offset, val); return;
-      case Expr::Int64: write64(offset, val); return;
-      }
+    if (w == Expr::Bool) {
+      write8(offset, CE->getZExtValue());
+      return;
+    }
+    if (w % 8 == 0) {
+      writeConcrete(offset, CE->getAPValue().getRawData(), w / 8);
+      return;
     }
   }
 
@@ -566,27 +788,35 @@ void ObjectState::write(unsigned offset, ref<Expr> value) {
 } 
 
 void ObjectState::write16(unsigned offset, uint16_t value) {
-  unsigned NumBytes = 2;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  uint64_t word = value;
+  writeConcrete(offset, &word, 2);
 }
 
 void ObjectState::write32(unsigned offset, uint32_t value) {
-  unsigned NumBytes = 4;
-  for (unsigned i = 0; i != NumBytes; ++i) {
-    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
-  }
+  uint64_t word = value;
+  writeConcrete(offset, &word, 4);
 }
 
 void ObjectState::write64(unsigned offset, uint64_t value) {
-  unsigned NumBytes = 8;
+  writeConcrete(offset, &value, 8);
+}
+
+/// Stores the low \a NumBytes bytes of \a words, given least significant
+/// word first, and updates the caches for the whole range at once.
+void ObjectState::writeConcrete(unsigned offset, const uint64_t *words,
+                                unsigned NumBytes) {
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    concreteStore[offset + idx] = (uint8_t) (words[i / 8] >> (8 * (i % 8)));
   }
+
+  if (concreteMask)
+    concreteMask->setRange(offset, offset + NumBytes);
+  if (flushMask)
+    flushMask->setRange(offset, offset + NumBytes);
+  if (knownSymbolics)
+    for (unsigned i = offset; i != offset + NumBytes; ++i)
+      knownSymbolics[i] = 0;
 }
 
 void ObjectState::print() {
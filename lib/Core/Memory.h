@@ -15,6 +15,7 @@
 
 #include "llvm/ADT/StringExtras.h"
 
+#include <map>
 #include <vector>
 #include <string>
 
@@ -25,6 +26,7 @@ namespace llvm {
 namespace klee {
 
 class BitArray;
+struct FrameBlock;
 class MemoryManager;
 class Solver;
 class ArrayCache;
@@ -56,6 +58,9 @@ public:
 
   MemoryManager *parent;
 
+  /// The block of the stack frame this local was placed in, if any.
+  FrameBlock *frame;
+
   /// "Location" for which this memory object was allocated. This
   /// should be either the allocating instruction or the global object
   /// it was allocated for (or whatever else makes sense).
@@ -81,6 +86,7 @@ public:
       size(0),
       isFixed(true),
       parent(NULL),
+      frame(0),
       allocSite(0) {
   }
 
@@ -99,6 +105,7 @@ public:
       fake_object(false),
       isUserSpecified(false),
       parent(_parent), 
+      frame(0),
       allocSite(_allocSite) {
   }
 
@@ -158,6 +165,9 @@ private:
 
   uint8_t *concreteStore;
   // XXX cleanup name of flushMask (its backwards or something)
+  // The masks and knownSymbolics are only allocated once a byte becomes
+  // symbolic or is flushed. While they are null the object is entirely
+  // concrete and reads and writes go straight to concreteStore.
   BitArray *concreteMask;
 
   // mutable because may need flushed during read of const
@@ -168,6 +178,11 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Constant snapshots of concrete ranges that were read at symbolic
+  /// offsets, keyed by the first byte. An entry is reused only if it still
+  /// matches the concrete contents.
+  mutable std::map<unsigned, const Array *> segments;
+
 public:
   unsigned size;
 
@@ -221,9 +236,15 @@ private:
 
   void fastRangeCheckOffset(ref<Expr> offset, unsigned *base_r, 
                             unsigned *size_r) const;
+  const Array *getConcreteSegment(unsigned rangeBase,
+                                  unsigned rangeSize) const;
   void flushRangeForRead(unsigned rangeBase, unsigned rangeSize) const;
   void flushRangeForWrite(unsigned rangeBase, unsigned rangeSize);
 
+  void writeConcrete(unsigned offset, const uint64_t *words,
+                     unsigned NumBytes);
+
+  bool isRangeConcrete(unsigned offset, unsigned n) const;
   bool isByteConcrete(unsigned offset) const;
   bool isByteFlushed(unsigned offset) const;
   bool isByteKnownSymbolic(unsigned offset) const;
@@ -81,8 +81,12 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
 MemoryManager::~MemoryManager() {
   while (!objects.empty()) {
     MemoryObject *mo = *objects.begin();
-    if (!mo->isFixed && !DeterministicAllocation)
+    if (mo->frame) {
+      if (--mo->frame->liveObjects == 0)
+        releaseFrame(mo->frame);
+    } else if (!mo->isFixed && !DeterministicAllocation) {
       free((void *)mo->address);
+    }
     objects.erase(mo);
     delete mo;
   }
@@ -91,24 +95,7 @@ MemoryManager::~MemoryManager() {
     munmap(deterministicSpace, spaceSize);
 }
 
-MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
-                                      bool isGlobal,
-                                      const llvm::Value *allocSite,
-                                      size_t alignment) {
-  if (size > 10 * 1024 * 1024)
-    klee_warning_once(0, "Large alloc: %" PRIu64
-                         " bytes.  KLEE may run out of memory.",
-                      size);
-
-  // Return NULL if size is zero, this is equal to error during allocation
-  if (NullOnZeroMalloc && size == 0)
-    return 0;
-
-  if (!llvm::isPowerOf2_64(alignment)) {
-    klee_warning("Only alignment of power of two is supported");
-    return 0;
-  }
-
+uint64_t MemoryManager::allocateMemory(uint64_t size, size_t alignment) {
   uint64_t address = 0;
   if (DeterministicAllocation) {
 
@@ -139,6 +126,28 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
     }
   }
 
+  return address;
+}
+
+MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
+                                      bool isGlobal,
+                                      const llvm::Value *allocSite,
+                                      size_t alignment) {
+  if (size > 10 * 1024 * 1024)
+    klee_warning_once(0, "Large alloc: %" PRIu64
+                         " bytes.  KLEE may run out of memory.",
+                      size);
+
+  // Return NULL if size is zero, this is equal to error during allocation
+  if (NullOnZeroMalloc && size == 0)
+    return 0;
+
+  if (!llvm::isPowerOf2_64(alignment)) {
+    klee_warning("Only alignment of power of two is supported");
+    return 0;
+  }
+
+  uint64_t address = allocateMemory(size, alignment);
   if (!address)
     return 0;
 
@@ -167,12 +176,53 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
   return res;
 }
 
+FrameBlock *MemoryManager::allocateFrame(uint64_t size, size_t alignment) {
+  if (size > 10 * 1024 * 1024)
+    klee_warning_once(0, "Large alloc: %" PRIu64
+                         " bytes.  KLEE may run out of memory.",
+                      size);
+
+  uint64_t address = allocateMemory(size, alignment);
+  if (!address)
+    return 0;
+
+  FrameBlock *frame = new FrameBlock();
+  frame->address = address;
+  frame->liveObjects = 0;
+  return frame;
+}
+
+MemoryObject *MemoryManager::allocateInFrame(FrameBlock *frame,
+                                             uint64_t offset, uint64_t size,
+                                             const llvm::Value *allocSite) {
+  ++stats::allocations;
+  MemoryObject *res =
+      new MemoryObject(frame->address + offset, size, /*isLocal=*/true,
+                       /*isGlobal=*/false, false, allocSite, this);
+  res->frame = frame;
+  ++frame->liveObjects;
+  objects.insert(res);
+  return res;
+}
+
+unsigned MemoryManager::getRedZoneSize() const { return RedZoneSpace; }
+
+void MemoryManager::releaseFrame(FrameBlock *frame) {
+  if (!DeterministicAllocation)
+    free((void *)frame->address);
+  delete frame;
+}
+
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end()) {
-    if (!mo->isFixed && !DeterministicAllocation)
+    if (mo->frame) {
+      if (--mo->frame->liveObjects == 0)
+        releaseFrame(mo->frame);
+    } else if (!mo->isFixed && !DeterministicAllocation) {
       free((void *)mo->address);
+    }
     objects.erase(mo);
   }
 }
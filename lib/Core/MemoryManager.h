@@ -21,6 +21,13 @@ namespace klee {
 class MemoryObject;
 class ArrayCache;
 
+/// A block of memory holding the fixed-size locals of a stack frame. It is
+/// released once all of its objects have been freed.
+struct FrameBlock {
+  uint64_t address;
+  unsigned liveObjects;
+};
+
 class MemoryManager {
 private:
   typedef std::set<MemoryObject *> objects_ty;
@@ -31,6 +38,9 @@ private:
   char *nextFreeSlot;
   size_t spaceSize;
 
+  uint64_t allocateMemory(uint64_t size, size_t alignment);
+  void releaseFrame(FrameBlock *frame);
+
 public:
   MemoryManager(ArrayCache *arrayCache);
   ~MemoryManager();
@@ -43,6 +53,16 @@ public:
                          const llvm::Value *allocSite, size_t alignment);
   MemoryObject *allocateFixed(uint64_t address, uint64_t size,
                               const llvm::Value *allocSite);
+
+  /// Allocates one block for the locals of a stack frame, which are then
+  /// placed in it with allocateInFrame(). Returns null on failure.
+  FrameBlock *allocateFrame(uint64_t size, size_t alignment);
+  /// Returns the local object at \a offset in \a frame.
+  MemoryObject *allocateInFrame(FrameBlock *frame, uint64_t offset,
+                                uint64_t size, const llvm::Value *allocSite);
+  /// Returns the space to leave between the objects of a frame.
+  unsigned getRedZoneSize() const;
+
   void deallocate(const MemoryObject *mo);
   void markFreed(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
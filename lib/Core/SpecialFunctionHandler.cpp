@@ -56,6 +56,14 @@ namespace {
                    cl::desc("Silently terminate paths with an infeasible "
                             "condition given to klee_assume() rather than "
                             "emitting an error (default=false)"));
+
+  cl::opt<bool>
+  SymbolicRoundingMode("symbolic-rounding-mode",
+                       cl::init(false),
+                       cl::desc("Keep the rounding mode symbolic when "
+                                "fesetround() is called with a symbolic "
+                                "argument instead of concretizing it. "
+                                "Requires the Z3 solver (default=false)"));
 }
 
 
@@ -264,29 +272,26 @@ void SpecialFunctionHandler::bind() {
     Function *f = executor.kmodule->module->getFunction(hi.name);
     
     if (f && (!hi.doNotOverride || f->isDeclaration()))
-      handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
+      handlers[f] = i;
   }
 }
 
+int SpecialFunctionHandler::getHandlerIndex(const Function *f) const {
+  handlers_ty::const_iterator it = handlers.find(f);
+  return it == handlers.end() ? -1 : (int) it->second;
+}
 
-bool SpecialFunctionHandler::handle(ExecutionState &state, 
-                                    Function *f,
+void SpecialFunctionHandler::handle(ExecutionState &state, 
+                                    unsigned index,
                                     KInstruction *target,
                                     std::vector< ref<Expr> > &arguments) {
-  handlers_ty::iterator it = handlers.find(f);
-  if (it != handlers.end()) {    
-    Handler h = it->second.first;
-    bool hasReturnValue = it->second.second;
-     // FIXME: Check this... add test?
-    if (!hasReturnValue && !target->inst->use_empty()) {
-      executor.terminateStateOnExecError(state, 
-                                         "expected return value from void special function");
-    } else {
-      (this->*h)(state, target, arguments);
-    }
-    return true;
+  const HandlerInfo &hi = handlerInfo[index];
+   // FIXME: Check this... add test?
+  if (!hi.hasReturnValue && !target->inst->use_empty()) {
+    executor.terminateStateOnExecError(state, 
+                                       "expected return value from void special function");
   } else {
-    return false;
+    (this->*hi.handler)(state, target, arguments);
   }
 }
 
@@ -945,6 +950,11 @@ void SpecialFunctionHandler::handleFeTestExcept(ExecutionState &state,
 void SpecialFunctionHandler::handleFeGetRound(ExecutionState &state,
                                               KInstruction *target,
                                               std::vector<ref<Expr> > &arguments) {
+  if (!state.symbolicRoundingMode.isNull()) {
+    executor.bindLocal(target, state, state.symbolicRoundingMode);
+    return;
+  }
+
   int ret = state.getRoundingMode();
  
   ref<ConstantExpr> retExpr = ConstantExpr::alloc(ret, sizeof(ret) * 8);
@@ -954,9 +964,30 @@ void SpecialFunctionHandler::handleFeGetRound(ExecutionState &state,
 void SpecialFunctionHandler::handleFeSetRound(ExecutionState &state,
                                               KInstruction *target,
                                               std::vector<ref<Expr> > &arguments) {
+  if (SymbolicRoundingMode && CoreSolverToUse == Z3_SOLVER &&
+      !isa<ConstantExpr>(arguments[0])) {
+    // Invalid modes leave the rounding mode unchanged and return non-zero.
+    ref<Expr> mode = arguments[0];
+    ref<Expr> valid = ConstantExpr::alloc(0, Expr::Bool);
+    const int modes[] = { FE_TONEAREST, FE_DOWNWARD, FE_UPWARD, FE_TOWARDZERO };
+    for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+      valid = OrExpr::create(valid,
+                             EqExpr::create(mode, ConstantExpr::alloc(modes[i],
+                                                                      mode->getWidth())));
+    ref<Expr> current = state.symbolicRoundingMode;
+    if (current.isNull())
+      current = ConstantExpr::alloc(state.getRoundingMode(), Expr::Int32);
+    state.symbolicRoundingMode = SelectExpr::create(valid, mode, current);
+    executor.bindLocal(target, state,
+                       ZExtExpr::create(Expr::createIsZero(valid), Expr::Int32));
+    return;
+  }
+
   int rounding_mode = executor.toConstant(state, arguments[0], "Argument to fesetround")->getAPValue().getLimitedValue(std::numeric_limits<int>::max());
   
   int ret = fesetround(rounding_mode);
+  if (ret == 0)
+    state.symbolicRoundingMode = ref<Expr>();
   
   ref<ConstantExpr> retExpr = ConstantExpr::alloc(ret, sizeof(ret) * 8);
   executor.bindLocal(target, state, retExpr);
@@ -965,6 +996,7 @@ void SpecialFunctionHandler::handleFeSetRound(ExecutionState &state,
 void SpecialFunctionHandler::handleFeGetEnv(ExecutionState &state,
                                             KInstruction *target,
                                             std::vector<ref<Expr> > &arguments) {
+  executor.concretizeRoundingMode(state, "rounding mode of fegetenv");
   fenv_t env = state.fEnv;
   uint8_t* envArr = (uint8_t*) &env;
 
@@ -986,6 +1018,7 @@ void SpecialFunctionHandler::handleFeGetEnv(ExecutionState &state,
 void SpecialFunctionHandler::handleFeHoldExcept(ExecutionState &state,
                                                 KInstruction *target,
                                                 std::vector<ref<Expr> > &arguments) {
+  executor.concretizeRoundingMode(state, "rounding mode of feholdexcept");
   fenv_t env;
   fenv_t* envp = &env;
   uint8_t* envArr = (uint8_t*) envp;
@@ -1018,6 +1051,7 @@ void SpecialFunctionHandler::handleFeHoldExcept(ExecutionState &state,
 void SpecialFunctionHandler::handleFeSetEnv(ExecutionState &state,
                                             KInstruction *target,
                                             std::vector<ref<Expr> > &arguments) {
+  executor.concretizeRoundingMode(state, "rounding mode of fesetenv");
   fenv_t env;
   fenv_t* envp = &env;
   uint8_t* envArr = (uint8_t*) envp;
@@ -1043,6 +1077,7 @@ void SpecialFunctionHandler::handleFeSetEnv(ExecutionState &state,
 void SpecialFunctionHandler::handleFeUpdateEnv(ExecutionState &state,
                                                KInstruction *target,
                                                std::vector<ref<Expr> > &arguments) {
+  executor.concretizeRoundingMode(state, "rounding mode of feupdateenv");
   fenv_t env;
   fenv_t* envp = &env;
   uint8_t* envArr = (uint8_t*) envp;
@@ -1103,19 +1138,19 @@ void SpecialFunctionHandler::handleIsInf(ExecutionState &state,
 void SpecialFunctionHandler::handleSqrt(ExecutionState &state,
                                         KInstruction *target,
                                         std::vector<ref<Expr> > &arguments) {
-  executor.bindLocal(target, state, FSqrtExpr::create(arguments[0], state.roundingMode));
+  executor.bindLocal(target, state, executor.createRounded(state, Expr::FSqrt, arguments[0]));
 }
 
 void SpecialFunctionHandler::handleNearbyInt(ExecutionState &state,
                                              KInstruction *target,
                                              std::vector<ref<Expr> > &arguments) {
-  executor.bindLocal(target, state, FNearbyIntExpr::create(arguments[0], state.roundingMode));
+  executor.bindLocal(target, state, executor.createRounded(state, Expr::FNearbyInt, arguments[0]));
 }
 
 void SpecialFunctionHandler::handleFMod(ExecutionState &state,
                                         KInstruction *target,
                                         std::vector<ref<Expr> > &arguments) {
-  executor.bindLocal(target, state, FRemExpr::create(arguments[0], arguments[1], state.roundingMode));
+  executor.bindLocal(target, state, executor.createRounded(state, Expr::FRem, arguments[0], arguments[1]));
 }
 
 void SpecialFunctionHandler::handleFMin(ExecutionState &state,
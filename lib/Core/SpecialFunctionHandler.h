@@ -32,8 +32,8 @@ namespace klee {
                                                     KInstruction *target, 
                                                     std::vector<ref<Expr> > 
                                                       &arguments);
-    typedef std::map<const llvm::Function*, 
-                     std::pair<Handler,bool> > handlers_ty;
+    /// The index of the handler of every special function.
+    typedef std::map<const llvm::Function*, unsigned> handlers_ty;
 
     handlers_ty handlers;
     class Executor &executor;
@@ -83,8 +83,13 @@ namespace klee {
     /// prepared for execution.
     void bind();
 
-    bool handle(ExecutionState &state, 
-                llvm::Function *f,
+    /// Return the index of the handler of \a f, or -1 if it is not a
+    /// special function. Calls bind the index ahead of time.
+    int getHandlerIndex(const llvm::Function *f) const;
+
+    /// Execute the special function with the handler at \a index.
+    void handle(ExecutionState &state, 
+                unsigned index,
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
@@ -0,0 +1,62 @@
+//===-- StateSet.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESET_H
+#define KLEE_STATESET_H
+
+#include "klee/ExecutionState.h"
+
+#include <cassert>
+#include <vector>
+
+namespace klee {
+  /// The set of active states, stored densely in a vector. Every state
+  /// remembers its slot, so insertion, removal and membership tests take
+  /// constant time and iteration walks contiguous memory. Removal moves the
+  /// last state into the freed slot, so the iteration order is arbitrary and
+  /// changes whenever a state is removed.
+  class StateSet {
+    std::vector<ExecutionState*> slots;
+
+  public:
+    typedef std::vector<ExecutionState*>::const_iterator iterator;
+    typedef iterator const_iterator;
+
+    iterator begin() const { return slots.begin(); }
+    iterator end() const { return slots.end(); }
+    size_t size() const { return slots.size(); }
+    bool empty() const { return slots.empty(); }
+
+    bool contains(const ExecutionState *es) const {
+      return es->stateSetSlot < slots.size() && slots[es->stateSetSlot] == es;
+    }
+
+    void insert(ExecutionState *es) {
+      assert(!contains(es) && "state inserted twice");
+      es->stateSetSlot = slots.size();
+      slots.push_back(es);
+    }
+
+    template <class InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+      for (; first != last; ++first)
+        insert(*first);
+    }
+
+    void erase(ExecutionState *es) {
+      assert(contains(es) && "erasing a state not in the set");
+      ExecutionState *moved = slots.back();
+      slots[es->stateSetSlot] = moved;
+      moved->stateSetSlot = es->stateSetSlot;
+      slots.pop_back();
+    }
+  };
+}
+
+#endif
@@ -19,6 +19,7 @@
 #include "klee/Internal/System/MemoryUsage.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver.h"
 #include "klee/SolverStats.h"
 
 #include "CallPathManager.h"
@@ -58,6 +59,9 @@
 #endif
 
 #include <fstream>
+#include <functional>
+#include <queue>
+#include <vector>
 #include <unistd.h>
 
 using namespace klee;
@@ -330,6 +334,8 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
 	stats::uncoveredInstructions += (uint64_t)-1;
+        if (updateMinDistToUncovered)
+          newlyCovered.push_back(ii.id);
       }
     }
   }
@@ -343,6 +349,45 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     writeIStats();
 }
 
+bool StatsTracker::coversNew(const std::vector<KInstruction*> &instructions) {
+  if (!OutputIStats)
+    return false;
+  for (std::vector<KInstruction*>::const_iterator it = instructions.begin(),
+         ie = instructions.end(); it != ie; ++it)
+    if (theStatisticManager->getIndexedValue(stats::uncoveredInstructions,
+                                             (*it)->info->id))
+      return true;
+  return false;
+}
+
+void StatsTracker::markCovered(ExecutionState &es, KFunction *kf,
+                               const std::vector<KInstruction*> &instructions) {
+  if (!OutputIStats || !kf->trackCoverage)
+    return;
+
+  // The statistics belong to the covered instructions, not to the call.
+  unsigned index = theStatisticManager->getIndex();
+  StatisticRecord *context = theStatisticManager->getContext();
+  theStatisticManager->setContext(0);
+  for (std::vector<KInstruction*>::const_iterator it = instructions.begin(),
+         ie = instructions.end(); it != ie; ++it) {
+    const InstructionInfo &ii = *(*it)->info;
+    if (!instructionIsCoverable((*it)->inst) ||
+        theStatisticManager->getIndexedValue(stats::coveredInstructions, ii.id))
+      continue;
+    theStatisticManager->setIndex(ii.id);
+    es.coveredLines[&ii.file].insert(ii.line);
+    es.coveredNew = true;
+    es.instsSinceCovNew = 1;
+    ++stats::coveredInstructions;
+    stats::uncoveredInstructions += (uint64_t)-1;
+    if (updateMinDistToUncovered)
+      newlyCovered.push_back(ii.id);
+  }
+  theStatisticManager->setIndex(index);
+  theStatisticManager->setContext(context);
+}
+
 ///
 
 /* Should be called _after_ the es->pushFrame() */
@@ -421,6 +466,11 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'SolverMemoryUsage',"
+             << "'SolverContextRecycles',"
+             << "'AdaptiveLayerBypasses',"
+             << "'AdaptiveBypassedQueries',"
+             << "'SolverCacheMemory',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -451,6 +501,11 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << getSolverMemoryUsage()
+             << "," << stats::z3ContextRecycles
+             << "," << stats::adaptiveLayerBypasses
+             << "," << stats::adaptiveBypassedQueries
+             << "," << getSolverCacheMemoryUsage()
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -458,20 +513,50 @@ void StatsTracker::writeStatsLine() {
   statsFile->flush();
 }
 
-void StatsTracker::updateStateStatistics(uint64_t addend) {
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
-         ie = executor.states.end(); it != ie; ++it) {
-    ExecutionState &state = **it;
-    const InstructionInfo &ii = *state.pc->info;
-    theStatisticManager->incrementIndexedValue(stats::states, ii.id, addend);
-    if (UseCallPaths)
-      state.stack.back().callPathNode->statistics.incrementValue(stats::states, addend);
+void StatsTracker::countState(ExecutionState &es) {
+  uncountState(es);
+  es.countedInfo = es.pc->info;
+  theStatisticManager->incrementIndexedValue(stats::states, es.countedInfo->id, 1);
+  if (UseCallPaths) {
+    es.countedCallPathNode = es.stack.back().callPathNode;
+    es.countedCallPathNode->statistics.incrementValue(stats::states, 1);
   }
 }
 
+void StatsTracker::uncountState(ExecutionState &es) {
+  if (!es.countedInfo)
+    return;
+  theStatisticManager->incrementIndexedValue(stats::states, es.countedInfo->id,
+                                             (uint64_t)-1);
+  if (es.countedCallPathNode)
+    es.countedCallPathNode->statistics.incrementValue(stats::states,
+                                                      (uint64_t)-1);
+  es.countedInfo = 0;
+  es.countedCallPathNode = 0;
+}
+
+void StatsTracker::stateAdded(ExecutionState &es) {
+  if (OutputIStats)
+    countState(es);
+}
+
+void StatsTracker::stateRemoved(ExecutionState &es) {
+  if (OutputIStats)
+    uncountState(es);
+}
+
+void StatsTracker::stateMoved(ExecutionState &es) {
+  // The States statistic follows the pc of each state rather than being
+  // recomputed from all states whenever the istats file is written. Only a
+  // pc that lands on a different instruction or call path moves the count.
+  if (OutputIStats &&
+      (es.countedInfo != es.pc->info ||
+       (UseCallPaths && es.countedCallPathNode != es.stack.back().callPathNode)))
+    countState(es);
+}
+
 void StatsTracker::writeIStats() {
   Module *m = executor.kmodule->module;
-  uint64_t istatsMask = 0;
   llvm::raw_fd_ostream &of = *istatsFile;
   
   // We assume that we didn't move the file pointer
@@ -488,25 +573,26 @@ void StatsTracker::writeIStats() {
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
 
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  // The statistics written as events.
+  static const char *const istatsNames[] = {
+    "Queries", "QueriesValid", "QueriesInvalid", "QueryTime",
+    "IntegralFloatQueries", "IntegralFloatRewrites", "ResolveTime",
+    "Instructions", "InstructionTimes", "InstructionRealTimes", "Forks",
+    "CoveredInstructions", "UncoveredInstructions", "States",
+    "MinDistToUncovered",
+  };
+  const unsigned numIStats = sizeof(istatsNames) / sizeof(istatsNames[0]);
+  std::vector<bool> istatsMask(nStats);
+  for (unsigned i = 0; i != numIStats; ++i) {
+    int id = sm.getStatisticID(istatsNames[i]);
+    if (id >= 0)
+      istatsMask[id] = true;
+  }
 
   of << "positions: instr line\n";
 
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i)) {
+    if (istatsMask[i]) {
       Statistic &s = sm.getStatistic(i);
       of << "event: " << s.getShortName() << " : " 
          << s.getName() << "\n";
@@ -515,16 +601,11 @@ void StatsTracker::writeIStats() {
 
   of << "events: ";
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i))
+    if (istatsMask[i])
       of << sm.getStatistic(i).getShortName() << " ";
   }
   of << "\n";
   
-  // set state counts, decremented after we process so that we don't
-  // have to zero all records each time.
-  if (istatsMask & (1<<stats::states.getID()))
-    updateStateStatistics(1);
-
   std::string sourceFile = "";
 
   CallSiteSummaryTable callSiteStats;
@@ -561,7 +642,7 @@ void StatsTracker::writeIStats() {
           of << ii.assemblyLine << " ";
           of << ii.line << " ";
           for (unsigned i=0; i<nStats; i++)
-            if (istatsMask&(1<<i))
+            if (istatsMask[i])
               of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
           of << "\n";
 
@@ -587,7 +668,7 @@ void StatsTracker::writeIStats() {
                 of << ii.assemblyLine << " ";
                 of << ii.line << " ";
                 for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask&(1<<i)) {
+                  if (istatsMask[i]) {
                     Statistic &s = sm.getStatistic(i);
                     uint64_t value;
 
@@ -611,9 +692,6 @@ void StatsTracker::writeIStats() {
     }
   }
 
-  if (istatsMask & (1<<stats::states.getID()))
-    updateStateStatistics((uint64_t)-1);
-  
   // Clear then end of the file if necessary (no truncate op?).
   unsigned pos = of.tell();
   for (unsigned i=pos; i<istatsSize; ++i)
@@ -630,6 +708,108 @@ static calltargets_ty callTargets;
 static std::map<Function*, std::vector<Instruction*> > functionCallers;
 static std::map<Function*, unsigned> functionShortestPath;
 
+/// An edge of the graph minDistToUncovered is computed over, between
+/// instruction ids: to a successor, weighted by the cost of getting through
+/// the instruction, or from a call to the entry of a possible callee.
+struct DistEdge {
+  unsigned id;
+  unsigned weight;
+  DistEdge(unsigned _id, unsigned _weight) : id(_id), weight(_weight) {}
+};
+typedef std::vector<std::vector<DistEdge> > distgraph_ty;
+
+static distgraph_ty distSuccs, distPreds;
+static std::vector<bool> distAffected;
+
+/// Collects in affected every instruction whose minDistToUncovered may have
+/// been derived from one of the newly covered instructions: a predecessor
+/// depends on an affected instruction if its distance is exactly the one
+/// through it. Distances are left untouched.
+static void collectAffected(const std::vector<unsigned> &covered,
+                            std::vector<unsigned> &affected) {
+  StatisticManager &sm = *theStatisticManager;
+  std::vector<unsigned> stack;
+  for (std::vector<unsigned>::const_iterator it = covered.begin(),
+         ie = covered.end(); it != ie; ++it) {
+    if (!distAffected[*it]) {
+      distAffected[*it] = true;
+      affected.push_back(*it);
+      stack.push_back(*it);
+    }
+  }
+
+  while (!stack.empty()) {
+    unsigned id = stack.back();
+    stack.pop_back();
+    uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, id);
+    if (!dist)
+      continue;
+    std::vector<DistEdge> &preds = distPreds[id];
+    for (std::vector<DistEdge>::iterator it = preds.begin(),
+           ie = preds.end(); it != ie; ++it) {
+      if (!distAffected[it->id] &&
+          sm.getIndexedValue(stats::minDistToUncovered, it->id) ==
+            dist + it->weight) {
+        distAffected[it->id] = true;
+        affected.push_back(it->id);
+        stack.push_back(it->id);
+      }
+    }
+  }
+}
+
+/// Recomputes minDistToUncovered for the affected instructions from their
+/// own coverage and the distances of all unaffected ones, then clears the
+/// affected marks. Covering an instruction can only make distances grow, so
+/// the unaffected distances are still exact and shortest paths only need to
+/// be propagated back through the affected instructions.
+static void propagateMinDistToUncovered(const std::vector<unsigned> &affected) {
+  StatisticManager &sm = *theStatisticManager;
+  typedef std::pair<uint64_t, unsigned> entry_ty;
+  std::priority_queue<entry_ty, std::vector<entry_ty>,
+                      std::greater<entry_ty> > queue;
+
+  for (std::vector<unsigned>::const_iterator it = affected.begin(),
+         ie = affected.end(); it != ie; ++it) {
+    uint64_t best = sm.getIndexedValue(stats::uncoveredInstructions, *it);
+    std::vector<DistEdge> &succs = distSuccs[*it];
+    for (std::vector<DistEdge>::iterator it2 = succs.begin(),
+           ie2 = succs.end(); it2 != ie2; ++it2) {
+      if (distAffected[it2->id])
+        continue;
+      uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered, it2->id);
+      if (dist && (best == 0 || dist + it2->weight < best))
+        best = dist + it2->weight;
+    }
+    sm.setIndexedValue(stats::minDistToUncovered, *it, best);
+    if (best)
+      queue.push(entry_ty(best, *it));
+  }
+
+  while (!queue.empty()) {
+    entry_ty top = queue.top();
+    queue.pop();
+    if (top.first != sm.getIndexedValue(stats::minDistToUncovered, top.second))
+      continue; // superseded by a shorter distance
+    std::vector<DistEdge> &preds = distPreds[top.second];
+    for (std::vector<DistEdge>::iterator it = preds.begin(),
+           ie = preds.end(); it != ie; ++it) {
+      if (!distAffected[it->id])
+        continue;
+      uint64_t val = top.first + it->weight;
+      uint64_t cur = sm.getIndexedValue(stats::minDistToUncovered, it->id);
+      if (cur == 0 || val < cur) {
+        sm.setIndexedValue(stats::minDistToUncovered, it->id, val);
+        queue.push(entry_ty(val, it->id));
+      }
+    }
+  }
+
+  for (std::vector<unsigned>::const_iterator it = affected.begin(),
+         ie = affected.end(); it != ie; ++it)
+    distAffected[*it] = false;
+}
+
 static std::vector<Instruction*> getSuccs(Instruction *i) {
   BasicBlock *bb = i->getParent();
   std::vector<Instruction*> res;
@@ -672,6 +852,7 @@ void StatsTracker::computeReachableUncovered() {
   static bool init = true;
   const InstructionInfoTable &infos = *km->infos;
   StatisticManager &sm = *theStatisticManager;
+  bool fullUpdate = init;
   
   if (init) {
     init = false;
@@ -806,40 +987,20 @@ void StatsTracker::computeReachableUncovered() {
         }
       }
     } while (changed);
-  }
 
-  // compute minDistToUncovered, 0 is unreachable
-  std::vector<Instruction *> instructions;
-  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
-       fnIt != fn_ie; ++fnIt) {
-    // Not sure if I should bother to preorder here.
-    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end(); 
-         bbIt != bb_ie; ++bbIt) {
-      for (BasicBlock::iterator it = bbIt->begin(), ie = bbIt->end(); 
-           it != ie; ++it) {
-        Instruction *inst = static_cast<Instruction *>(it);
-        unsigned id = infos.getInfo(inst).id;
-        instructions.push_back(inst);
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           id, 
-                           sm.getIndexedValue(stats::uncoveredInstructions, id));
-      }
-    }
-  }
-  
-  std::reverse(instructions.begin(), instructions.end());
-  
-  // I'm so lazy it's not even worklisted.
-  bool changed;
-  do {
-    changed = false;
+    // Build the graph minDistToUncovered is propagated over. The cost of
+    // getting through a call depends only on functionShortestPath, which is
+    // fixed from now on.
+    unsigned numIds = infos.getMaxID();
+    distSuccs.assign(numIds, std::vector<DistEdge>());
+    distPreds.assign(numIds, std::vector<DistEdge>());
+    distAffected.assign(numIds, false);
     for (std::vector<Instruction*>::iterator it = instructions.begin(),
            ie = instructions.end(); it != ie; ++it) {
       Instruction *inst = *it;
-      uint64_t best, cur = best = sm.getIndexedValue(stats::minDistToUncovered, 
-                                                     infos.getInfo(inst).id);
+      unsigned id = infos.getInfo(inst).id;
       unsigned bestThrough = 0;
-      
+
       if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
         std::vector<Function*> &targets = callTargets[inst];
         for (std::vector<Function*>::iterator fnIt = targets.begin(),
@@ -852,43 +1013,43 @@ void StatsTracker::computeReachableUncovered() {
           }
 
           if (!(*fnIt)->isDeclaration()) {
-            uint64_t calleeDist = sm.getIndexedValue(stats::minDistToUncovered,
-                                                     infos.getFunctionInfo(*fnIt).id);
-            if (calleeDist) {
-              calleeDist = 1+calleeDist; // count instruction itself
-              if (best==0 || calleeDist<best)
-                best = calleeDist;
-            }
+            unsigned entry = infos.getFunctionInfo(*fnIt).id;
+            distSuccs[id].push_back(DistEdge(entry, 1));
+            distPreds[entry].push_back(DistEdge(id, 1));
           }
         }
       } else {
         bestThrough = 1;
       }
-      
+
       if (bestThrough) {
         std::vector<Instruction*> succs = getSuccs(inst);
         for (std::vector<Instruction*>::iterator it2 = succs.begin(),
                ie = succs.end(); it2 != ie; ++it2) {
-          uint64_t dist = sm.getIndexedValue(stats::minDistToUncovered,
-                                             infos.getInfo(*it2).id);
-          if (dist) {
-            uint64_t val = bestThrough + dist;
-            if (best==0 || val<best)
-              best = val;
-          }
+          unsigned succ = infos.getInfo(*it2).id;
+          distSuccs[id].push_back(DistEdge(succ, bestThrough));
+          distPreds[succ].push_back(DistEdge(id, bestThrough));
         }
       }
+    }
+  }
 
-      if (best != cur) {
-        sm.setIndexedValue(stats::minDistToUncovered, 
-                           infos.getInfo(inst).id, 
-                           best);
-        changed = true;
-      }
+  // Update minDistToUncovered, 0 is unreachable. The first time every
+  // instruction is computed, afterwards only those whose distance may have
+  // depended on an instruction covered since.
+  std::vector<unsigned> affected;
+  if (fullUpdate) {
+    for (unsigned id = 0, e = distSuccs.size(); id != e; ++id) {
+      distAffected[id] = true;
+      affected.push_back(id);
     }
-  } while (changed);
+  } else {
+    collectAffected(newlyCovered, affected);
+  }
+  newlyCovered.clear();
+  propagateMinDistToUncovered(affected);
 
-  for (std::set<ExecutionState*>::iterator it = executor.states.begin(),
+  for (StateSet::iterator it = executor.states.begin(),
          ie = executor.states.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     uint64_t currentFrameMinDist = 0;
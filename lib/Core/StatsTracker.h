@@ -13,6 +13,7 @@
 #include "CallPathManager.h"
 
 #include <set>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -26,6 +27,7 @@ namespace klee {
   class Executor;  
   class InstructionInfoTable;
   class InterpreterHandler;
+  struct KFunction;
   struct KInstruction;
   struct StackFrame;
 
@@ -46,11 +48,17 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// Instructions covered since minDistToUncovered was last updated.
+    std::vector<unsigned> newlyCovered;
+
   public:
     static bool useStatistics();
 
   private:
-    void updateStateStatistics(uint64_t addend);
+    // moves the state's contribution to the States statistic to its
+    // current instruction (and call path)
+    void countState(ExecutionState &es);
+    void uncountState(ExecutionState &es);
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
@@ -72,6 +80,22 @@ namespace klee {
     void markBranchVisited(ExecutionState *visitedTrue, 
                            ExecutionState *visitedFalse);
     
+    // called when a state joins or leaves the executor's set of states
+    void stateAdded(ExecutionState &es);
+    void stateRemoved(ExecutionState &es);
+
+    // called after es has executed an instruction, with its pc at the next
+    // instruction to execute
+    void stateMoved(ExecutionState &es);
+
+    // whether marking these instructions covered would cover anything new
+    bool coversNew(const std::vector<KInstruction*> &instructions);
+
+    // called when es executed these instructions of kf without stepping
+    // them, as for calls through a function summary
+    void markCovered(ExecutionState &es, KFunction *kf,
+                     const std::vector<KInstruction*> &instructions);
+
     // called when execution is done and stats files should be flushed
     void done();
 
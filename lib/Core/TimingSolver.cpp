@@ -12,6 +12,7 @@
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
 #include "klee/Statistics.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/Debug.h"
@@ -314,6 +315,31 @@ TimingSolver::getInitialValues(const ExecutionState& state,
   return success;
 }
 
+bool
+TimingSolver::getInitialValues(const ExecutionState& state,
+                               const ConstraintManager &constraints,
+                               const std::vector<const Array*> &objects,
+                               std::vector< std::vector<unsigned char> >
+                                 &result,
+                               bool &hasSolution) {
+  sys::TimeValue now = util::getWallTimeVal();
+
+  if (!setDynamicTimeout(this)) {
+    return false;
+  }
+  bool success =
+    solver->impl->computeInitialValues(Query(constraints,
+                                             ConstantExpr::alloc(0, Expr::Bool)),
+                                       objects, result, hasSolution);
+
+  sys::TimeValue delta = util::getWallTimeVal();
+  delta -= now;
+  stats::solverTime += delta.usec();
+  state.queryCost += delta.usec()/1000000.;
+
+  return success;
+}
+
 std::pair< ref<Expr>, ref<Expr> >
 TimingSolver::getRange(const ExecutionState& state, ref<Expr> expr) {
   if (!setDynamicTimeout(this)) {
@@ -62,6 +62,15 @@ namespace klee {
                           const std::vector<const Array*> &objects,
                           std::vector< std::vector<unsigned char> > &result);
 
+    /// Like getInitialValues(), but under \a constraints, which extend those
+    /// of the state, and setting \a hasSolution to whether they are
+    /// satisfiable instead of failing when they are not.
+    bool getInitialValues(const ExecutionState&,
+                          const ConstraintManager &constraints,
+                          const std::vector<const Array*> &objects,
+                          std::vector< std::vector<unsigned char> > &result,
+                          bool &hasSolution);
+
     std::pair< ref<Expr>, ref<Expr> >
     getRange(const ExecutionState&, ref<Expr> query);
   };
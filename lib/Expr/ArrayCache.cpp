@@ -1,5 +1,7 @@
 #include "klee/util/ArrayCache.h"
 
+#include "llvm/ADT/StringExtras.h"
+
 namespace klee {
 
 ArrayCache::~ArrayCache() {
@@ -44,4 +46,26 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
     return array;
   }
 }
+
+const Array *
+ArrayCache::getConstantArray(const std::vector<uint8_t> &contents,
+                             uint64_t maxBytes) {
+  std::map<std::vector<uint8_t>, const Array *>::iterator it =
+      constantArraysByContents.find(contents);
+  if (it != constantArraysByContents.end())
+    return it->second;
+  if (constantArrayBytes + contents.size() > maxBytes)
+    return 0;
+  constantArrayBytes += contents.size();
+
+  std::vector<ref<ConstantExpr> > values(contents.size());
+  for (unsigned i = 0; i != contents.size(); ++i)
+    values[i] = ConstantExpr::create(contents[i], Expr::Int8);
+  std::string name =
+      "const_seg" + llvm::utostr(constantArraysByContents.size());
+  const Array *array = CreateArray(name, values.size(), &values[0],
+                                   &values[0] + values.size());
+  constantArraysByContents[contents] = array;
+  return array;
+}
 }
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr.h"
+#include "klee/CommandLine.h"
 #include "klee/Config/Version.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 
@@ -36,6 +37,22 @@ namespace {
    cl::desc("Enable various optimizations involving all-constant arrays."));
 }
 
+// Lives here rather than in lib/Basic because both constant folding and the
+// solver builders depend on it.
+llvm::cl::opt<bool>
+klee::FlushDenormals("flush-denormals",
+   llvm::cl::init(false),
+   llvm::cl::desc("Treat subnormal float and double operands and results as "
+                  "zero (FTZ/DAZ), as code built with -ffast-math does "
+                  "(default=off)."));
+
+llvm::cl::opt<bool>
+klee::BitPreservingNaN("bit-preserving-nan",
+   llvm::cl::init(false),
+   llvm::cl::desc("Treat float bitcasts as exact bit reinterpretations that "
+                  "also preserve NaN sign and payload, folding sign-bit "
+                  "operations through them (default=off)."));
+
 /***/
 
 unsigned Expr::count = 0;
@@ -174,6 +191,7 @@ void Expr::printKind(llvm::raw_ostream &os, Kind k) {
     X(FRem);
     X(FMin);
     X(FMax);
+    X(FFma);
     X(Eq);
     X(Ne);
     X(Ult);
@@ -413,6 +431,13 @@ ref<Expr> Expr::createFromKind(Kind k, std::vector<CreateArg> args) {
       BINARY_EXPR_CASE(FUne);
       BINARY_EXPR_CASE(FOne);
 
+    case FFma:
+      assert(numArgs == 4 && args[0].isExpr() && args[1].isExpr() &&
+             args[2].isExpr() && args[3].isRoundingMode() &&
+             "invalid args array for FFma opcode");
+      return FFmaExpr::create(args[0].expr, args[1].expr, args[2].expr,
+                              args[3].rm);
+
 #undef UNARY_RM_EXPR_CASE
 #undef UNARY_EXPR_CASE
 #undef BINARY_RM_EXPR_CASE
@@ -545,6 +570,14 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+/// Replaces a subnormal \a v by a zero of the same sign under
+/// -flush-denormals. x87 has no FTZ/DAZ, so Fl80 values are kept.
+static APFloat flushDenormal(const APFloat &v, Expr::Width w) {
+  if (!FlushDenormals || w == Expr::Fl80 || !v.isDenormal())
+    return v;
+  return APFloat::getZero(*fpWidthToSemantics(w), v.isNegative());
+}
+
 ref<ConstantExpr> FConstantExpr::FToU(Width W, llvm::APFloat::roundingMode rm) {
   if (!fpWidthToSemantics(getWidth()) || W > 64)
     klee_error("Unsupported FToU operation");
@@ -556,7 +589,7 @@ ref<ConstantExpr> FConstantExpr::FToU(Width W, llvm::APFloat::roundingMode rm) {
 
   uint64_t new_value = 0;
   bool isExact = true;
-  value.convertToInteger(&new_value, W, false, llvm::APFloat::rmTowardZero, &isExact);
+  flushDenormal(value, getWidth()).convertToInteger(&new_value, W, false, llvm::APFloat::rmTowardZero, &isExact);
   return ConstantExpr::alloc(new_value, W);
 }
 
@@ -579,7 +612,7 @@ ref<ConstantExpr> FConstantExpr::FToS(Width W, llvm::APFloat::roundingMode rm) {
 
   uint64_t new_value = 0;
   bool isExact = true;
-  value.convertToInteger(&new_value, W, true, llvm::APFloat::rmTowardZero, &isExact);
+  flushDenormal(value, getWidth()).convertToInteger(&new_value, W, true, llvm::APFloat::rmTowardZero, &isExact);
   return ConstantExpr::alloc(new_value, W);
 }
 
@@ -742,7 +775,8 @@ ref<ConstantExpr> FConstantExpr::FOrd(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes != APFloat::cmpUnordered;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -757,7 +791,8 @@ ref<ConstantExpr> FConstantExpr::FUno(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(true, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -772,7 +807,8 @@ ref<ConstantExpr> FConstantExpr::FUeq(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -787,7 +823,8 @@ ref<ConstantExpr> FConstantExpr::FOeq(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -802,7 +839,8 @@ ref<ConstantExpr> FConstantExpr::FUgt(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpGreaterThan;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -817,7 +855,8 @@ ref<ConstantExpr> FConstantExpr::FOgt(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpGreaterThan;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -832,7 +871,8 @@ ref<ConstantExpr> FConstantExpr::FUge(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -847,7 +887,8 @@ ref<ConstantExpr> FConstantExpr::FOge(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpGreaterThan || CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -862,7 +903,8 @@ ref<ConstantExpr> FConstantExpr::FUlt(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || CmpRes == APFloat::cmpLessThan;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -877,7 +919,8 @@ ref<ConstantExpr> FConstantExpr::FOlt(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpLessThan;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -892,7 +935,8 @@ ref<ConstantExpr> FConstantExpr::FUle(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -907,7 +951,8 @@ ref<ConstantExpr> FConstantExpr::FOle(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(false, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpLessThan || CmpRes == APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -922,7 +967,8 @@ ref<ConstantExpr> FConstantExpr::FUne(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(true, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes == APFloat::cmpUnordered || CmpRes != APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -937,7 +983,8 @@ ref<ConstantExpr> FConstantExpr::FOne(const ref<FConstantExpr> &RHS) {
     return ConstantExpr::alloc(true, Expr::Bool);
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   bool Result = CmpRes != APFloat::cmpUnordered && CmpRes != APFloat::cmpEqual;
   return ConstantExpr::alloc(Result, Expr::Bool);
@@ -978,9 +1025,9 @@ ref<FConstantExpr> FConstantExpr::FExt(Width W, llvm::APFloat::roundingMode rm)
   }
 
   bool losesInfo = false;
-  APFloat Res = value;
+  APFloat Res = flushDenormal(value, getWidth());
   Res.convert(*fpWidthToSemantics(W), rm, &losesInfo);
-  return FConstantExpr::alloc(Res);
+  return FConstantExpr::alloc(flushDenormal(Res, W));
 }
 
 ref<FConstantExpr> ConstantExpr::UToF(Width W, llvm::APFloat::roundingMode rm) {
@@ -1042,24 +1089,24 @@ ref<FConstantExpr> FConstantExpr::FSqrt(llvm::APFloat::roundingMode rm) {
 
   switch (getWidth()) {
   case Fl32: {
-    float f = value.convertToFloat();
+    float f = flushDenormal(value, Fl32).convertToFloat();
     fenv_t env;
     fegetenv(&env);
     fesetround(rounding_mode);
     f = sqrtf(f);
     fesetenv(&env);
     llvm::APFloat Res(f);
-    return FConstantExpr::alloc(Res);
+    return FConstantExpr::alloc(flushDenormal(Res, Fl32));
   }
   case Fl64: {
-    double d = value.convertToDouble();
+    double d = flushDenormal(value, Fl64).convertToDouble();
     fenv_t env;
     fegetenv(&env);
     fesetround(rounding_mode);
     d = sqrt(d);
     fesetenv(&env);
     llvm::APFloat Res(d);
-    return FConstantExpr::alloc(Res);
+    return FConstantExpr::alloc(flushDenormal(Res, Fl64));
   }
   case Fl80: {
     long double ld;
@@ -1091,7 +1138,7 @@ ref<FConstantExpr> FConstantExpr::FNearbyInt(llvm::APFloat::roundingMode rm) {
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  APFloat Res = value;
+  APFloat Res = flushDenormal(value, getWidth());
   Res.roundToIntegral(rm);
   return FConstantExpr::alloc(Res);
 }
@@ -1105,9 +1152,9 @@ ref<FConstantExpr> FConstantExpr::FAdd(const ref<FConstantExpr> &RHS, llvm::APFl
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  llvm::APFloat Res = value;
-  Res.add(RHS->getAPValue(), RM);
-  return FConstantExpr::alloc(Res);
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.add(flushDenormal(RHS->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
 }
 
 ref<FConstantExpr> FConstantExpr::FSub(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM) {
@@ -1119,9 +1166,9 @@ ref<FConstantExpr> FConstantExpr::FSub(const ref<FConstantExpr> &RHS, llvm::APFl
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  llvm::APFloat Res = value;
-  Res.subtract(RHS->getAPValue(), RM);
-  return FConstantExpr::alloc(Res);
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.subtract(flushDenormal(RHS->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
 }
 
 ref<FConstantExpr> FConstantExpr::FMul(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM) {
@@ -1133,9 +1180,9 @@ ref<FConstantExpr> FConstantExpr::FMul(const ref<FConstantExpr> &RHS, llvm::APFl
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  llvm::APFloat Res = value;
-  Res.multiply(RHS->getAPValue(), RM);
-  return FConstantExpr::alloc(Res);
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.multiply(flushDenormal(RHS->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
 }
 
 ref<FConstantExpr> FConstantExpr::FDiv(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM) {
@@ -1147,9 +1194,9 @@ ref<FConstantExpr> FConstantExpr::FDiv(const ref<FConstantExpr> &RHS, llvm::APFl
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  llvm::APFloat Res = value;
-  Res.divide(RHS->getAPValue(), RM);
-  return FConstantExpr::alloc(Res);
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.divide(flushDenormal(RHS->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
 }
 
 ref<FConstantExpr> FConstantExpr::FRem(const ref<FConstantExpr> &RHS, llvm::APFloat::roundingMode RM) {
@@ -1161,9 +1208,27 @@ ref<FConstantExpr> FConstantExpr::FRem(const ref<FConstantExpr> &RHS, llvm::APFl
     return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
   }
 
-  llvm::APFloat Res = value;
-  Res.mod(RHS->getAPValue(), RM);
-  return FConstantExpr::alloc(Res);
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.mod(flushDenormal(RHS->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
+}
+
+ref<FConstantExpr> FConstantExpr::FFma(const ref<FConstantExpr> &RHS,
+                                       const ref<FConstantExpr> &Addend,
+                                       llvm::APFloat::roundingMode RM) {
+  if (!getWidth() || !RHS->getWidth() || !Addend->getWidth())
+    klee_error("Unsupported FFma operation");
+
+  if (getWidth() == Fl80 &&
+      !(correctHiddenBit && RHS->correctHiddenBit && Addend->correctHiddenBit))
+  {
+    return FConstantExpr::alloc(APFloat::getNaN(*fpWidthToSemantics(Fl80)));
+  }
+
+  llvm::APFloat Res = flushDenormal(value, getWidth());
+  Res.fusedMultiplyAdd(flushDenormal(RHS->getAPValue(), getWidth()),
+                       flushDenormal(Addend->getAPValue(), getWidth()), RM);
+  return FConstantExpr::alloc(flushDenormal(Res, getWidth()));
 }
 
 ref<FConstantExpr> FConstantExpr::FMin(const ref<FConstantExpr> &RHS) {
@@ -1188,15 +1253,16 @@ ref<FConstantExpr> FConstantExpr::FMin(const ref<FConstantExpr> &RHS) {
     // else both have the correct hidden bit, continue with the actual comparison
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   if (CmpRes == APFloat::cmpLessThan || RHS->getAPValue().isNaN())
   {
-    return FConstantExpr::alloc(value);
+    return FConstantExpr::alloc(flushDenormal(value, getWidth()));
   }
   else
   {
-    return FConstantExpr::alloc(RHS->getAPValue());
+    return FConstantExpr::alloc(flushDenormal(RHS->getAPValue(), getWidth()));
   }
 }
 
@@ -1222,15 +1288,16 @@ ref<FConstantExpr> FConstantExpr::FMax(const ref<FConstantExpr> &RHS) {
     // else both have the correct hidden bit, continue with the actual comparison
   }
 
-  APFloat::cmpResult CmpRes = value.compare(RHS->getAPValue());
+  APFloat::cmpResult CmpRes = flushDenormal(value, getWidth()).compare(
+      flushDenormal(RHS->getAPValue(), getWidth()));
 
   if (CmpRes == APFloat::cmpLessThan || value.isNaN())
   {
-    return FConstantExpr::alloc(RHS->getAPValue());
+    return FConstantExpr::alloc(flushDenormal(RHS->getAPValue(), getWidth()));
   }
   else
   {
-    return FConstantExpr::alloc(value);
+    return FConstantExpr::alloc(flushDenormal(value, getWidth()));
   }
 }
 
@@ -2027,6 +2094,10 @@ static ref<Expr> FExtExpr_create(const ref<Expr> &e, Expr::Width w, llvm::APFloa
 ref<Expr> FExtExpr::create(const ref<Expr> &e, Width w, llvm::APFloat::roundingMode rm) {
   if (FConstantExpr *ce = dyn_cast<FConstantExpr>(e))
     return ce->FExt(w, rm);
+  // Converting to the same format is exact. x87 unnormals are the exception,
+  // as the conversion turns them into NaNs.
+  if (e->getWidth() == w && w != Fl80)
+    return e;
   return FExtExpr_create(e, w, rm);
 }
 
@@ -2092,6 +2163,17 @@ FB_RM_CREATE(FMulExpr, FMul)
 FB_RM_CREATE(FDivExpr, FDiv)
 FB_RM_CREATE(FRemExpr, FRem)
 
+ref<Expr> FFmaExpr::create(const ref<Expr> &l, const ref<Expr> &r,
+                           const ref<Expr> &a, llvm::APFloat::roundingMode rm) {
+  assert(l->getWidth() == r->getWidth() && l->getWidth() == a->getWidth() &&
+         "type mismatch");
+  if (FConstantExpr *cl = dyn_cast<FConstantExpr>(l))
+    if (FConstantExpr *cr = dyn_cast<FConstantExpr>(r))
+      if (FConstantExpr *ca = dyn_cast<FConstantExpr>(a))
+        return cl->FFma(cr, ca, rm);
+  return FFmaExpr::alloc(l, r, a, rm);
+}
+
 #define FCMPCREATE(_e_op, _op) \
 ref<Expr>  _e_op ::create(const ref<Expr> &l, const ref<Expr> &r) {     \
   assert(l->getWidth()==r->getWidth() && "type mismatch");              \
@@ -2131,6 +2213,22 @@ FCMPCREATE(FOleExpr, FOle)
 FCMPCREATE(FUneExpr, FUne)
 FCMPCREATE(FOneExpr, FOne)
 
+/// Returns the operand of a bitcast that is masked (And) or flipped (Xor)
+/// by the sign bit constant \a mask, or null if \a e does not have that
+/// shape.
+static ExplicitIntExpr *getSignBitOperand(const ref<Expr> &e, Expr::Kind k,
+                                          const llvm::APInt &mask) {
+  if (e->getKind() != k)
+    return 0;
+  ref<Expr> l = e->getKid(0), r = e->getKid(1);
+  if (isa<ConstantExpr>(l))
+    std::swap(l, r);
+  ConstantExpr *ce = dyn_cast<ConstantExpr>(r);
+  if (!ce || ce->getAPValue() != mask)
+    return 0;
+  return dyn_cast<ExplicitIntExpr>(l);
+}
+
 ref<Expr> ExplicitFloatExpr::create(const ref<Expr> &e, Width w) {
   if (ConstantExpr *ce = dyn_cast<ConstantExpr>(e))
   {
@@ -2144,14 +2242,41 @@ ref<Expr> ExplicitFloatExpr::create(const ref<Expr> &e, Width w) {
     return FSelectExpr::create(se->cond, t, f);
   }
   if (ExplicitIntExpr *ie = dyn_cast<ExplicitIntExpr>(e)) {
-    if (ie->getWidth() == w) {
+    if (ie->src->getWidth() == w)
       return ie->src;
-    } else assert(false && "double to int bitcasts of differeng lengths are not supported at the moment");
+  }
+  if (BitPreservingNaN) {
+    // (float)((int)f & ~signbit) == fabs(f)
+    if (ExplicitIntExpr *ie = getSignBitOperand(
+            e, Expr::And, llvm::APInt::getSignedMaxValue(e->getWidth())))
+      if (ie->src->getWidth() == w)
+        return FAbsExpr::create(ie->src);
+    // (float)((int)f ^ signbit) == -f, which is how fneg is lowered
+    if (w == Fl32 || w == Fl64)
+      if (ExplicitIntExpr *ie = getSignBitOperand(
+              e, Expr::Xor, llvm::APInt::getSignBit(e->getWidth())))
+        if (ie->src->getWidth() == w)
+          return FSubExpr::create(
+              FConstantExpr::alloc(llvm::APFloat::getZero(
+                  *fpWidthToSemantics(w), /*Negative=*/true)),
+              ie->src, llvm::APFloat::rmNearestTiesToEven);
   }
   assert(!isa<FExpr>(e));
   return ExplicitFloatExpr::alloc(e, w);
 }
 
+/// Matches -0.0 - f rounded to nearest, the form in which LLVM 3.4 expresses
+/// fneg and the one ExplicitFloatExpr::create folds the sign flip back to.
+/// Rounded downward, -0.0 - -0.0 is -0.0 rather than +0.0, so other rounding
+/// modes do not match.
+static bool isFNeg(const ref<Expr> &e) {
+  if (FSubExpr *se = dyn_cast<FSubExpr>(e))
+    if (FConstantExpr *ce = dyn_cast<FConstantExpr>(se->left))
+      return ce->getAPValue().isZero() && ce->getAPValue().isNegative() &&
+             se->getRoundingMode() == llvm::APFloat::rmNearestTiesToEven;
+  return false;
+}
+
 ref<Expr> ExplicitIntExpr::create(const ref<Expr> &e, Width w) {
   if (FConstantExpr *fce = dyn_cast<FConstantExpr>(e))
   {
@@ -2165,9 +2290,20 @@ ref<Expr> ExplicitIntExpr::create(const ref<Expr> &e, Width w) {
     return SelectExpr::create(se->cond, t, f);
   }
   if (ExplicitFloatExpr *fe = dyn_cast<ExplicitFloatExpr>(e)) {
-    if (fe->getWidth() == w) {
+    if (fe->src->getWidth() == w)
       return fe->src;
-    } else assert(false && "double to int bitcasts of differeng lengths are not supported at the moment");
+  }
+  if (BitPreservingNaN) {
+    // fabs and fneg only touch the sign bit, so a NaN keeps its payload and
+    // the result can be computed on the bit pattern of the operand.
+    if (FAbsExpr *ae = dyn_cast<FAbsExpr>(e))
+      return AndExpr::create(
+          ExplicitIntExpr::create(ae->expr, w),
+          ConstantExpr::alloc(llvm::APInt::getSignedMaxValue(w)));
+    if ((w == Fl32 || w == Fl64) && isFNeg(e))
+      return XorExpr::create(
+          ConstantExpr::alloc(llvm::APInt::getSignBit(w)),
+          ExplicitIntExpr::create(cast<FSubExpr>(e)->right, w));
   }
   assert(isa<FExpr>(e));
   return ExplicitIntExpr::alloc(e, w);
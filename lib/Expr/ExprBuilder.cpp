@@ -293,6 +293,10 @@ namespace {
     virtual ref<Expr> FMax(const ref<Expr> &LHS, const ref<Expr> &RHS) {
       return FMaxExpr::alloc(LHS, RHS);
     }
+
+    virtual ref<Expr> FFma(const ref<Expr> &LHS, const ref<Expr> &RHS, const ref<Expr> &Addend, llvm::APFloat::roundingMode RM) {
+      return FFmaExpr::alloc(LHS, RHS, Addend, RM);
+    }
   };
 
   /// ChainedBuilder - Helper class for construct specialized expression
@@ -586,6 +590,10 @@ namespace {
     virtual ref<Expr> FMax(const ref<Expr> &LHS, const ref<Expr> &RHS) {
       return Base->FMax(LHS, RHS);
     }
+
+    ref<Expr> FFma(const ref<Expr> &LHS, const ref<Expr> &RHS, const ref<Expr> &Addend, llvm::APFloat::roundingMode RM) {
+      return Base->FFma(LHS, RHS, Addend, RM);
+    }
   };
 
   /// ConstantSpecializedExprBuilder - A base expression builder class which
@@ -1227,6 +1235,10 @@ namespace {
 
         return FSelectExpr::create(se->cond, t, f);
       }
+      // Bitcasts are exact, so a round trip yields the original value.
+      if (ExplicitIntExpr *ie = dyn_cast<ExplicitIntExpr>(LHS))
+        if (ie->src->getWidth() == W)
+          return ie->src;
       return Builder.ExplicitFloat(cast<NonConstantExpr>(LHS), W);
     }
 
@@ -1235,13 +1247,16 @@ namespace {
       {
         return ce->ExplicitInt(W);
       }
-      if (SelectExpr *se = dyn_cast<SelectExpr>(LHS))
+      if (FSelectExpr *se = dyn_cast<FSelectExpr>(LHS))
       {
         ref<Expr> t = ExplicitIntExpr::create(se->trueExpr, W);
         ref<Expr> f = ExplicitIntExpr::create(se->falseExpr, W);
 
-        return FSelectExpr::create(se->cond, t, f);
+        return SelectExpr::create(se->cond, t, f);
       }
+      if (ExplicitFloatExpr *fe = dyn_cast<ExplicitFloatExpr>(LHS))
+        if (fe->src->getWidth() == W)
+          return fe->src;
       return Builder.ExplicitInt(cast<FNonConstantExpr>(LHS), W);
     }
 
@@ -1391,6 +1406,15 @@ namespace {
       return Builder.FMax(cast<FNonConstantExpr>(LHS),
                           cast<FNonConstantExpr>(RHS));
     }
+
+    virtual ref<Expr> FFma(const ref<Expr> &LHS, const ref<Expr> &RHS, const ref<Expr> &Addend, llvm::APFloat::roundingMode RM) {
+      if (FConstantExpr *LCE = dyn_cast<FConstantExpr>(LHS))
+        if (FConstantExpr *RCE = dyn_cast<FConstantExpr>(RHS))
+          if (FConstantExpr *ACE = dyn_cast<FConstantExpr>(Addend))
+            return LCE->FFma(RCE, ACE, RM);
+
+      return Builder.FFma(LHS, RHS, Addend, RM);
+    }
   };
 
   class ConstantFoldingBuilder :
@@ -0,0 +1,193 @@
+//===-- IfConversion.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Floating-point code is full of small branches that only pick one of two
+// values: min, max, clamp, abs, sign and short arithmetic on either side of
+// a comparison. Every one of them forks the executor when the comparison is
+// symbolic, although both arms are cheap and have no effects. This pass
+// executes both arms unconditionally in the block that branches and merges
+// their results with select instructions, which the executor evaluates
+// without forking.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Passes.h"
+
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <string>
+
+using namespace llvm;
+using namespace klee;
+
+char klee::IfConversionPass::ID = 0;
+
+/// Instructions that can be executed although the program would not have
+/// executed them: they have no effects, cannot fail and do not concretize
+/// their operands.
+static bool isSpeculatable(Instruction *i) {
+  switch (i->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::FCmp:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::ICmp:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::BitCast:
+  case Instruction::Select:
+    return !i->getType()->isVectorTy();
+  default:
+    return false;
+  }
+}
+
+/// Checks that \a arm is a block that only \a head branches to, that
+/// continues unconditionally, and whose instructions can all be speculated.
+bool klee::IfConversionPass::isConvertibleArm(BasicBlock *arm,
+                                              BasicBlock *head) {
+  if (arm == head || arm->getSinglePredecessor() != head)
+    return false;
+  BranchInst *bi = dyn_cast<BranchInst>(arm->getTerminator());
+  if (!bi || bi->isConditional())
+    return false;
+
+  unsigned count = 0;
+  for (BasicBlock::iterator i = arm->begin(); &*i != bi; ++i)
+    if (++count > maxArmInstructions || !isSpeculatable(&*i) ||
+        (i->getOpcode() == Instruction::FDiv && !speculateFPDivisions))
+      return false;
+  return true;
+}
+
+/// If-converts the conditional branch at the end of \a head, if it starts a
+/// triangle or a diamond of convertible arms that merges floating-point
+/// values or branches on a floating-point comparison.
+bool klee::IfConversionPass::convert(BasicBlock *head) {
+  BranchInst *bi = dyn_cast<BranchInst>(head->getTerminator());
+  if (!bi || bi->isUnconditional())
+    return false;
+  Value *cond = bi->getCondition();
+  BasicBlock *trueBB = bi->getSuccessor(0), *falseBB = bi->getSuccessor(1);
+
+  // Find the join block and the blocks it is entered from on either side.
+  BasicBlock *join, *truePred, *falsePred;
+  bool trueArm = isConvertibleArm(trueBB, head);
+  bool falseArm = isConvertibleArm(falseBB, head);
+  if (trueArm && falseArm &&
+      trueBB->getTerminator()->getSuccessor(0) ==
+        falseBB->getTerminator()->getSuccessor(0)) {
+    join = trueBB->getTerminator()->getSuccessor(0);
+    truePred = trueBB;
+    falsePred = falseBB;
+  } else if (trueArm && trueBB->getTerminator()->getSuccessor(0) == falseBB) {
+    join = falseBB;
+    truePred = trueBB;
+    falsePred = head;
+    falseArm = false;
+  } else if (falseArm && falseBB->getTerminator()->getSuccessor(0) == trueBB) {
+    join = trueBB;
+    truePred = head;
+    falsePred = falseBB;
+    trueArm = false;
+  } else {
+    return false;
+  }
+  if (join == head)
+    return false;
+
+  bool floating = isa<FCmpInst>(cond);
+  for (BasicBlock::iterator i = join->begin();
+       PHINode *pn = dyn_cast<PHINode>(i); ++i) {
+    if (pn->getType()->isVectorTy() || pn->getType()->isAggregateType())
+      return false;
+    if (pn->getType()->isFloatingPointTy())
+      floating = true;
+  }
+  if (!floating)
+    return false;
+
+  // Move the arms up, select the values the join receives, and continue to
+  // the join unconditionally.
+  BasicBlock::iterator insertPoint(bi);
+  if (trueArm)
+    head->getInstList().splice(insertPoint, trueBB->getInstList(),
+                               trueBB->begin(),
+                               BasicBlock::iterator(trueBB->getTerminator()));
+  if (falseArm)
+    head->getInstList().splice(insertPoint, falseBB->getInstList(),
+                               falseBB->begin(),
+                               BasicBlock::iterator(falseBB->getTerminator()));
+
+  for (BasicBlock::iterator i = join->begin();
+       PHINode *pn = dyn_cast<PHINode>(i); ++i) {
+    Value *trueValue = pn->getIncomingValueForBlock(truePred);
+    Value *falseValue = pn->getIncomingValueForBlock(falsePred);
+    Value *value = trueValue;
+    if (trueValue != falseValue)
+      value = SelectInst::Create(cond, trueValue, falseValue,
+                                 pn->getName() + ".ifconv", bi);
+    if (trueArm)
+      pn->removeIncomingValue(trueBB, false);
+    if (falseArm)
+      pn->removeIncomingValue(falseBB, false);
+    int index = pn->getBasicBlockIndex(head);
+    if (index < 0)
+      pn->addIncoming(value, head);
+    else
+      pn->setIncomingValue(index, value);
+  }
+
+  BranchInst::Create(join, bi);
+  bi->eraseFromParent();
+  if (trueArm)
+    trueBB->eraseFromParent();
+  if (falseArm)
+    falseBB->eraseFromParent();
+
+  // Merge the join into the head when nothing else enters it, so that a
+  // following branch, as in clamp, can be converted as well.
+  MergeBlockIntoPredecessor(join);
+  return true;
+}
+
+bool klee::IfConversionPass::runOnFunction(Function &f) {
+  unsigned converted = 0;
+  bool changed;
+  do {
+    changed = false;
+    for (Function::iterator bb = f.begin(), be = f.end(); bb != be; ++bb) {
+      if (convert(&*bb)) {
+        ++converted;
+        changed = true;
+        break;
+      }
+    }
+  } while (changed);
+
+  if (converted)
+    klee_message("if-converted %u branch%s in %s", converted,
+                 converted == 1 ? "" : "es", f.getName().str().c_str());
+  return converted != 0;
+}
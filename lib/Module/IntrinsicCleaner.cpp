@@ -87,6 +87,25 @@ bool IntrinsicCleanerPass::runOnBasicBlock(BasicBlock &b, Module &M) {
       case Intrinsic::vastart:
       case Intrinsic::vaend:
         break;
+
+        // Floating-point intrinsics are executed natively, lowering them
+        // would turn them into external calls.
+      case Intrinsic::fma:
+      case Intrinsic::fmuladd:
+      case Intrinsic::floor:
+      case Intrinsic::ceil:
+      case Intrinsic::trunc:
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+      case Intrinsic::rint:
+      case Intrinsic::nearbyint:
+      case Intrinsic::round:
+      case Intrinsic::copysign:
+#endif
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 6)
+      case Intrinsic::minnum:
+      case Intrinsic::maxnum:
+#endif
+        break;
         
         // Lower vacopy so that object resolution etc is handled by
         // normal instructions.
@@ -13,6 +13,7 @@
 
 #include "Passes.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Config/Version.h"
 #include "klee/Interpreter.h"
 #include "klee/Internal/Module/Cell.h"
@@ -102,6 +103,21 @@ namespace {
                         clEnumValEnd),
              cl::init(eSwitchTypeInternal));
   
+  cl::opt<bool>
+  IfConvertFPBranches("if-convert-fp-branches",
+                      cl::desc("Replace small floating-point branches whose "
+                               "arms have no effects by selects before "
+                               "execution, needs the Z3 solver "
+                               "(default=off)"),
+                      cl::init(false));
+
+  cl::opt<unsigned>
+  IfConvertMaxInstructions("if-convert-max-instructions",
+                           cl::desc("Maximum number of instructions in an "
+                                    "arm of an if-converted branch "
+                                    "(default=4)"),
+                           cl::init(4));
+
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
@@ -301,17 +317,14 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     }
   }
 
-  // Inject checks prior to optimization... we also perform the
-  // invariant transformations that we will end up doing later so that
-  // optimize is seeing what is as close as possible to the final
-  // module.
+  // Perform the invariant transformations that we will end up doing
+  // later so that optimize is seeing what is as close as possible to
+  // the final module.
   PassManager pm;
   pm.add(new RaiseAsmPass());
   pm.add(createFunctionScalarizerPass());
   pm.add(createScalarizerPass());
   pm.add(new InstCombiner());
-  if (opts.CheckDivZero) pm.add(new DivCheckPass());
-  if (opts.CheckOvershift) pm.add(new OvershiftCheckPass());
   // FIXME: This false here is to work around a bug in
   // IntrinsicLowering which caches values which may eventually be
   // deleted (via RAUW). This can be removed once LLVM fixes this
@@ -359,13 +372,6 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     );
   module = linkWithLibrary(module, LibPath.str());
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
@@ -385,6 +391,15 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   default: klee_error("invalid --switch-type");
   }
   pm3.add(new IntrinsicCleanerPass(*targetData));
+  if (IfConvertFPBranches) {
+    // The other solvers concretize floating-point operations, executing
+    // both arms would constrain the path by the arm it does not take.
+    if (CoreSolverToUse == Z3_SOLVER)
+      pm3.add(new IfConversionPass(IfConvertMaxInstructions,
+                                   !opts.CheckFPDivZero));
+    else
+      klee_warning("--if-convert-fp-branches needs the Z3 solver, ignoring");
+  }
   pm3.add(new PhiCleanerPass());
   pm3.run(*module);
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 3)
@@ -537,6 +552,8 @@ KFunction::KFunction(llvm::Function *_function,
   : function(_function),
     numArgs(function->arg_size()),
     numInstructions(0),
+    frameSize(0),
+    frameAlignment(0),
     trackCoverage(true) {
   for (llvm::Function::iterator bbit = function->begin(), 
          bbie = function->end(); bbit != bbie; ++bbit) {
@@ -571,6 +588,11 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Call:
+      case Instruction::Invoke:
+        ki = new KCallInstruction(); break;
+      case Instruction::Alloca:
+        ki = new KAllocaInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
@@ -121,32 +121,27 @@ public:
   virtual bool runOnFunction(llvm::Function &f);
 };
   
-class DivCheckPass : public llvm::ModulePass {
+/// IfConversionPass - Replace small branches over floating-point values whose
+/// arms have no effects by select instructions, so that symbolic comparisons
+/// do not fork. Meant for the Z3 solver, the others concretize the
+/// floating-point operations the arms execute unconditionally afterwards.
+/// Floating-point divisions are only moved out of the arms if the executor
+/// does not check them for division by zero.
+class IfConversionPass : public llvm::FunctionPass {
   static char ID;
-public:
-  DivCheckPass(): ModulePass(ID) {}
-  virtual bool runOnModule(llvm::Module &M);
-};
 
-/// This pass injects checks to check for overshifting.
-///
-/// Overshifting is where a Shl, LShr or AShr is performed
-/// where the shift amount is greater than width of the bitvector
-/// being shifted.
-/// In LLVM (and in C/C++) this undefined behaviour!
-///
-/// Example:
-/// \code
-///     unsigned char x=15;
-///     x << 4 ; // Defined behaviour
-///     x << 8 ; // Undefined behaviour
-///     x << 255 ; // Undefined behaviour
-/// \endcode
-class OvershiftCheckPass : public llvm::ModulePass {
-  static char ID;
+  unsigned maxArmInstructions;
+  bool speculateFPDivisions;
+
+  bool isConvertibleArm(llvm::BasicBlock *arm, llvm::BasicBlock *head);
+  bool convert(llvm::BasicBlock *head);
+
 public:
-  OvershiftCheckPass(): ModulePass(ID) {}
-  virtual bool runOnModule(llvm::Module &M);
+  IfConversionPass(unsigned _maxArmInstructions, bool _speculateFPDivisions)
+    : llvm::FunctionPass(ID), maxArmInstructions(_maxArmInstructions),
+      speculateFPDivisions(_speculateFPDivisions) {}
+
+  virtual bool runOnFunction(llvm::Function &f);
 };
 
 /// LowerSwitchPass - Replace all SwitchInst instructions with chained branch
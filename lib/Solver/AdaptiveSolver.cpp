@@ -0,0 +1,314 @@
+//===-- AdaptiveSolver.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Whether a layer of the solver chain pays for itself depends on the
+// workload: the counterexample cache can cost more than it saves on
+// floating-point queries, and independence splitting is useless when all
+// constraints share the same variables. The adaptive solver wraps a single
+// layer and periodically measures the cost of queries that skip it against
+// the cost of queries that go through it, bypassing the layer while it is not
+// profitable.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "adaptive-solver"
+#include "klee/Solver.h"
+
+#include "klee/CommandLine.h"
+
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/Debug.h"
+#include "klee/Internal/Support/Timer.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace klee;
+
+llvm::cl::opt<unsigned> klee::AdaptiveSolverWindow(
+    "adaptive-solver-window",
+    llvm::cl::desc("Number of queries over which the adaptive solver chain "
+                   "measures each layer (default=200)"),
+    llvm::cl::init(200));
+
+namespace {
+llvm::cl::opt<unsigned> AdaptiveSolverReprobe(
+    "adaptive-solver-reprobe",
+    llvm::cl::desc("Number of windows a decision of the adaptive solver "
+                   "chain is kept before the layer is measured again "
+                   "(default=10)"),
+    llvm::cl::init(10));
+
+llvm::cl::opt<unsigned> AdaptiveSolverProbeRate(
+    "adaptive-solver-probe-rate",
+    llvm::cl::desc("While the adaptive solver chain measures a layer, one in "
+                   "this many queries of each kind skips the layer to "
+                   "sample its direct cost (default=10)"),
+    llvm::cl::init(10));
+
+/// Forwards queries to the solver below a layer and accumulates how long the
+/// layer spent waiting for it.
+class ProbeSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+public:
+  /// Total time spent in the underlying solver, in microseconds.
+  uint64_t time;
+
+  ProbeSolver(Solver *_solver) : solver(_solver), time(0) {}
+  ~ProbeSolver() { delete solver; }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    WallTimer timer;
+    bool success = solver->impl->computeTruth(query, isValid);
+    time += timer.check();
+    return success;
+  }
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    WallTimer timer;
+    bool success = solver->impl->computeValidity(query, result);
+    time += timer.check();
+    return success;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    WallTimer timer;
+    bool success = solver->impl->computeValue(query, result);
+    time += timer.check();
+    return success;
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    WallTimer timer;
+    bool success = solver->impl->computeInitialValues(query, objects, values,
+                                                      hasSolution);
+    time += timer.check();
+    return success;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(double timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+/// Routes every query either through the layer or straight to the solver
+/// below it. Control alternates between two phases:
+///
+///  - Evaluate: one window of queries goes through the layer, except for a
+///    sample of one in -adaptive-solver-probe-rate queries of each kind, which
+///    skips it. The samples give the average cost of each kind of query
+///    without the layer. For the other queries the layer's overhead is the
+///    time not spent below it, and its saving is the direct cost of the
+///    query's kind minus the time spent below it.
+///  - Decided: if the net benefit over the evaluation window was negative the
+///    layer is bypassed, otherwise it is used, for the next
+///    -adaptive-solver-reprobe windows. Then the layer is evaluated again.
+///
+/// Truth, validity, value and initial values queries cost very different
+/// amounts below the layer, so each kind keeps its own direct cost.
+class AdaptiveSolver : public SolverImpl {
+private:
+  enum Phase { Evaluate, Decided };
+  enum QueryKind { Truth, Validity, Value, InitialValues, NumQueryKinds };
+
+  /// The layer, on top of direct.
+  Solver *layered;
+  /// The solver below the layer, owned by the layer, and its implementation.
+  Solver *direct;
+  ProbeSolver *probe;
+  /// The solver that answered the last query.
+  Solver *last;
+  std::string name;
+
+  Phase phase;
+  bool bypass;
+  /// Whether the current query is a sample that skips the layer.
+  bool sampling;
+  unsigned queriesLeft;
+  /// Queries of each kind since the last sample.
+  unsigned sinceSample[NumQueryKinds];
+  /// Average cost of a query of each kind that skips the layer, in
+  /// microseconds, valid once hasDirectCost is set.
+  uint64_t directCost[NumQueryKinds];
+  bool hasDirectCost[NumQueryKinds];
+
+  /// Accumulated per kind over the current window, in microseconds.
+  struct WindowStats {
+    uint64_t directQueries, directTime;
+    uint64_t layeredQueries, innerTime;
+    int64_t overhead;
+  } window[NumQueryKinds];
+
+  Solver *select(QueryKind kind);
+  void enter(Phase p, bool bypassLayer, unsigned windows);
+  void finishQuery(QueryKind kind, uint64_t elapsed, uint64_t innerTime);
+
+  /// Times one query and feeds the result to the controller.
+  class QueryTimer {
+    AdaptiveSolver &adaptive;
+    QueryKind kind;
+    uint64_t innerTime;
+    WallTimer timer;
+
+  public:
+    QueryTimer(AdaptiveSolver &_adaptive, QueryKind _kind)
+        : adaptive(_adaptive), kind(_kind),
+          innerTime(_adaptive.probe->time) {}
+    ~QueryTimer() {
+      adaptive.finishQuery(kind, timer.check(),
+                           adaptive.probe->time - innerTime);
+    }
+  };
+
+public:
+  AdaptiveSolver(Solver *s, Solver *(*createLayer)(Solver *),
+                 const char *_name);
+  ~AdaptiveSolver() { delete layered; }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    Solver *target = select(Truth);
+    QueryTimer t(*this, Truth);
+    return target->impl->computeTruth(query, isValid);
+  }
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    Solver *target = select(Validity);
+    QueryTimer t(*this, Validity);
+    return target->impl->computeValidity(query, result);
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    Solver *target = select(Value);
+    QueryTimer t(*this, Value);
+    return target->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    Solver *target = select(InitialValues);
+    QueryTimer t(*this, InitialValues);
+    return target->impl->computeInitialValues(query, objects, values,
+                                              hasSolution);
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return last->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return layered->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(double timeout) {
+    layered->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+}
+
+AdaptiveSolver::AdaptiveSolver(Solver *s, Solver *(*createLayer)(Solver *),
+                               const char *_name)
+    : probe(new ProbeSolver(s)), name(_name), sampling(false) {
+  direct = new Solver(probe);
+  layered = createLayer(direct);
+  last = layered;
+  for (unsigned i = 0; i != NumQueryKinds; ++i) {
+    // The first query of each kind is sampled.
+    sinceSample[i] = AdaptiveSolverProbeRate;
+    directCost[i] = 0;
+    hasDirectCost[i] = false;
+  }
+  enter(Evaluate, false, 1);
+}
+
+Solver *AdaptiveSolver::select(QueryKind kind) {
+  sampling = false;
+  if (phase == Evaluate &&
+      ++sinceSample[kind] >= std::max(1U, AdaptiveSolverProbeRate.getValue())) {
+    sinceSample[kind] = 0;
+    sampling = true;
+  }
+  return last = (bypass || sampling) ? direct : layered;
+}
+
+void AdaptiveSolver::enter(Phase p, bool bypassLayer, unsigned windows) {
+  phase = p;
+  bypass = bypassLayer;
+  queriesLeft = std::max(1U, AdaptiveSolverWindow * windows);
+  for (unsigned i = 0; i != NumQueryKinds; ++i) {
+    WindowStats &w = window[i];
+    w.directQueries = w.directTime = w.layeredQueries = w.innerTime = 0;
+    w.overhead = 0;
+  }
+}
+
+void AdaptiveSolver::finishQuery(QueryKind kind, uint64_t elapsed,
+                                 uint64_t innerTime) {
+  WindowStats &w = window[kind];
+  if (bypass || sampling) {
+    ++stats::adaptiveBypassedQueries;
+    ++w.directQueries;
+    w.directTime += elapsed;
+  } else {
+    ++w.layeredQueries;
+    w.innerTime += innerTime;
+    w.overhead += (int64_t) elapsed - (int64_t) innerTime;
+  }
+  if (--queriesLeft)
+    return;
+
+  // Queries that skipped the layer, sampled or bypassed, refresh the direct
+  // cost of their kind.
+  for (unsigned i = 0; i != NumQueryKinds; ++i) {
+    if (window[i].directQueries) {
+      directCost[i] = window[i].directTime / window[i].directQueries;
+      hasDirectCost[i] = true;
+    }
+  }
+
+  switch (phase) {
+  case Evaluate: {
+    // Kinds that were never sampled cannot be judged and are left out.
+    int64_t overhead = 0, savings = 0;
+    for (unsigned i = 0; i != NumQueryKinds; ++i) {
+      if (!hasDirectCost[i])
+        continue;
+      overhead += window[i].overhead;
+      savings += (int64_t) (directCost[i] * window[i].layeredQueries) -
+                 (int64_t) window[i].innerTime;
+    }
+    bool unprofitable = savings < overhead;
+    KLEE_DEBUG(llvm::errs() << "adaptive solver: " << name
+                            << " layer saved " << savings << "us for "
+                            << overhead << "us overhead, "
+                            << (unprofitable ? "bypassing" : "keeping")
+                            << " it\n");
+    if (unprofitable)
+      ++stats::adaptiveLayerBypasses;
+    enter(Decided, unprofitable, AdaptiveSolverReprobe);
+    break;
+  }
+  case Decided:
+    enter(Evaluate, false, 1);
+    break;
+  }
+}
+
+Solver *klee::createAdaptiveSolver(Solver *s,
+                                   Solver *(*createLayer)(Solver *),
+                                   const char *name) {
+  return new Solver(new AdaptiveSolver(s, createLayer, name));
+}
@@ -17,6 +17,12 @@
 
 #include "klee/SolverStats.h"
 
+#include "SolverCache.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <list>
+
 #include <ciso646>
 #ifdef _LIBCPP_VERSION
 #include <unordered_map>
@@ -28,7 +34,16 @@
 
 using namespace klee;
 
-class CachingSolver : public SolverImpl {
+namespace {
+  llvm::cl::opt<unsigned>
+  QueryCacheMaxMemory("query-cache-max-memory",
+                      llvm::cl::desc("Budget of the query cache in megabytes, "
+                                     "least recently used entries are "
+                                     "evicted beyond it (default=0 (off))"),
+                      llvm::cl::init(0));
+}
+
+class CachingSolver : public SolverImpl, public SolverCache {
 private:
   ref<Expr> canonicalizeQuery(ref<Expr> originalQuery,
                               bool &negationUsed);
@@ -66,15 +81,34 @@ private:
     }
   };
 
+  /// Entries from the most to the least recently used. The keys of an
+  /// unordered_map do not move, so they can be referred to from here.
+  typedef std::list<const CacheEntry*> lru_ty;
+
+  struct CacheValue {
+    IncompleteSolver::PartialValidity result;
+    lru_ty::iterator lruPosition;
+  };
+
   typedef unordered_map<CacheEntry, 
-                        IncompleteSolver::PartialValidity, 
+                        CacheValue, 
                         CacheEntryHash> cache_map;
   
   Solver *solver;
   cache_map cache;
+  lru_ty lru;
+
+  /// Estimate of the memory held by an entry. The expressions themselves are
+  /// shared with the states and not counted.
+  static uint64_t entryBytes(const CacheEntry &ce) {
+    return sizeof(cache_map::value_type) + 4 * sizeof(void*) +
+           ce.constraints.size() * sizeof(ref<Expr>);
+  }
+
+  void evict(uint64_t target);
 
 public:
-  CachingSolver(Solver *s) : solver(s) {}
+  CachingSolver(Solver *s) : SolverCache(QueryCacheMaxMemory), solver(s) {}
   ~CachingSolver() { cache.clear(); delete solver; }
 
   bool computeValidity(const Query&, Solver::Validity &result);
@@ -124,9 +158,10 @@ bool CachingSolver::cacheLookup(const Query& query,
   cache_map::iterator it = cache.find(ce);
   
   if (it != cache.end()) {
+    lru.splice(lru.begin(), lru, it->second.lruPosition);
     result = (negationUsed ?
-              IncompleteSolver::negatePartialValidity(it->second) :
-              it->second);
+              IncompleteSolver::negatePartialValidity(it->second.result) :
+              it->second.result);
     return true;
   }
   
@@ -140,10 +175,28 @@ void CachingSolver::cacheInsert(const Query& query,
   ref<Expr> canonicalQuery = canonicalizeQuery(query.expr, negationUsed);
 
   CacheEntry ce(query.constraints, canonicalQuery);
-  IncompleteSolver::PartialValidity cachedResult = 
-    (negationUsed ? IncompleteSolver::negatePartialValidity(result) : result);
+  CacheValue cv;
+  cv.result = (negationUsed ? IncompleteSolver::negatePartialValidity(result)
+                            : result);
   
-  cache.insert(std::make_pair(ce, cachedResult));
+  std::pair<cache_map::iterator, bool> res =
+    cache.insert(std::make_pair(ce, cv));
+  if (!res.second)
+    return;
+  lru.push_front(&res.first->first);
+  res.first->second.lruPosition = lru.begin();
+  addBytes(entryBytes(ce));
+  enforceBudget();
+}
+
+void CachingSolver::evict(uint64_t target) {
+  while (getBytes() > target && !lru.empty()) {
+    cache_map::iterator it = cache.find(*lru.back());
+    assert(it != cache.end() && "LRU list out of sync");
+    removeBytes(entryBytes(it->first));
+    lru.pop_back();
+    cache.erase(it);
+  }
 }
 
 bool CachingSolver::computeValidity(const Query& query,
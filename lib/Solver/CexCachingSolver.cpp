@@ -22,8 +22,12 @@
 
 #include "klee/Internal/Support/ErrorHandling.h"
 
+#include "SolverCache.h"
+
 #include "llvm/Support/CommandLine.h"
 
+#include <list>
+
 using namespace klee;
 using namespace llvm;
 
@@ -44,6 +48,13 @@ namespace {
   cl::opt<bool>
   CexCacheExperimental("cex-cache-exp", cl::init(false));
 
+  cl::opt<unsigned>
+  CexCacheMaxMemory("cex-cache-max-memory",
+                    cl::desc("Budget of the counterexample cache in "
+                             "megabytes, least recently used assignments are "
+                             "evicted beyond it (default=0 (off))"),
+                    cl::init(0));
+
 }
 
 ///
@@ -57,8 +68,9 @@ struct AssignmentLessThan {
 };
 
 
-class CexCachingSolver : public SolverImpl {
+class CexCachingSolver : public SolverImpl, public SolverCache {
   typedef std::set<Assignment*, AssignmentLessThan> assignmentsTable_ty;
+  typedef std::list<Assignment*> lru_ty;
 
   Solver *solver;
   
@@ -66,6 +78,19 @@ class CexCachingSolver : public SolverImpl {
   // memo table
   assignmentsTable_ty assignmentsTable;
 
+  /// The assignments from the most to the least recently used, and the
+  /// position of each one in that list.
+  lru_ty lru;
+  std::map<Assignment*, lru_ty::iterator> lruPositions;
+
+  /// Number of entries in the cache and the estimated bytes of their keys.
+  uint64_t numEntries, entriesBytes;
+
+  static uint64_t assignmentBytes(const Assignment *a);
+  void touch(Assignment *a);
+  void releaseEntries(unsigned removed);
+  void evict(uint64_t target);
+
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
   
@@ -79,7 +104,9 @@ class CexCachingSolver : public SolverImpl {
   bool getAssignment(const Query& query, Assignment *&result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver)
+      : SolverCache(CexCacheMaxMemory), solver(_solver), numEntries(0),
+        entriesBytes(0) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -104,6 +131,15 @@ struct NonNullAssignment {
   bool operator()(Assignment *a) const { return a!=0; }
 };
 
+struct EvictedAssignment {
+  const std::set<Assignment*> &evicted;
+
+  EvictedAssignment(const std::set<Assignment*> &_evicted)
+    : evicted(_evicted) {}
+
+  bool operator()(Assignment *a) const { return a && evicted.count(a); }
+};
+
 struct NullOrSatisfyingAssignment {
   KeyType &key;
   
@@ -206,9 +242,11 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
   }
 
   bool found = searchForAssignment(key, result);
-  if (found)
+  if (found) {
     ++stats::queryCexCacheHits;
-  else ++stats::queryCexCacheMisses;
+    if (result)
+      touch(result);
+  } else ++stats::queryCexCacheMisses;
     
   return found;
 }
@@ -237,6 +275,11 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     if (!res.second) {
       delete binding;
       binding = *res.first;
+      touch(binding);
+    } else {
+      lru.push_front(binding);
+      lruPositions[binding] = lru.begin();
+      addBytes(assignmentBytes(binding));
     }
     
     if (DebugCexCacheCheckBinding)
@@ -252,9 +295,72 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   result = binding;
   cache.insert(key, binding);
 
+  // Rough cost of the trie nodes of the key, most of them are usually
+  // shared with other entries, and of its copy in the lookup index.
+  uint64_t keyBytes = key.size() * (2 * sizeof(ref<Expr>) +
+                                    sizeof(Assignment*) +
+                                    sizeof(std::map<int, int>) +
+                                    4 * sizeof(void*) + sizeof(unsigned)) +
+                      64;
+  ++numEntries;
+  entriesBytes += keyBytes;
+  addBytes(keyBytes);
+  // The binding just computed is the most recently used and survives this.
+  enforceBudget();
+
   return true;
 }
 
+uint64_t CexCachingSolver::assignmentBytes(const Assignment *a) {
+  uint64_t bytes = sizeof(Assignment);
+  for (Assignment::bindings_ty::const_iterator it = a->bindings.begin(),
+         ie = a->bindings.end(); it != ie; ++it)
+    bytes += sizeof(*it) + 4 * sizeof(void*) + it->second.capacity();
+  return bytes;
+}
+
+void CexCachingSolver::touch(Assignment *a) {
+  std::map<Assignment*, lru_ty::iterator>::iterator it = lruPositions.find(a);
+  assert(it != lruPositions.end() && "assignment not in the LRU list");
+  lru.splice(lru.begin(), lru, it->second);
+}
+
+void CexCachingSolver::releaseEntries(unsigned removed) {
+  uint64_t bytes = numEntries ? entriesBytes * removed / numEntries : 0;
+  numEntries -= removed;
+  entriesBytes -= bytes;
+  removeBytes(bytes);
+}
+
+/// Evicts the least recently used assignments, with all the cache entries
+/// that refer to them. The most recently used assignment is kept, as it may
+/// be the result of the query in progress. If that is not enough, because
+/// the memory is held by entries for unsatisfiable queries, all entries are
+/// dropped.
+void CexCachingSolver::evict(uint64_t target) {
+  std::set<Assignment*> evicted;
+  while (getBytes() > target && lru.size() > 1) {
+    Assignment *a = lru.back();
+    lru.pop_back();
+    lruPositions.erase(a);
+    assignmentsTable.erase(a);
+    removeBytes(assignmentBytes(a));
+    evicted.insert(a);
+  }
+
+  if (!evicted.empty()) {
+    releaseEntries(cache.removeIf(EvictedAssignment(evicted)));
+    for (std::set<Assignment*>::iterator it = evicted.begin(),
+           ie = evicted.end(); it != ie; ++it)
+      delete *it;
+  }
+
+  if (getBytes() > target && numEntries) {
+    cache.clear();
+    releaseEntries(numEntries);
+  }
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
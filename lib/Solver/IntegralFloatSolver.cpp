@@ -0,0 +1,407 @@
+//===-- IntegralFloatSolver.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Programs often keep counters, indices and pixel values in floating-point
+// variables that only ever hold integers produced by SToF/UToF. This solver
+// proves such terms integral and small enough to be exactly representable, in
+// which case every operation on them is exact and rounding can be ignored.
+// Comparisons and conversions back to integers over these terms are rewritten
+// into bitvector arithmetic before the query reaches the underlying solver,
+// which removes the floating-point theory from the query altogether when
+// nothing else needs it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/util/ExprHashMap.h"
+#include "klee/util/ExprVisitor.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// The integer value of a float term that is known to be integral.
+struct IntegralValue {
+  /// An equivalent Int64 expression.
+  ref<Expr> value;
+  /// The number of bits needed to hold the value as a signed integer.
+  unsigned bits;
+  /// Whether the value is known not to be negative.
+  bool nonNegative;
+
+  IntegralValue() : bits(0), nonNegative(false) {}
+  IntegralValue(ref<Expr> v, unsigned b, bool nn)
+    : value(v), bits(b), nonNegative(nn) {}
+};
+
+/// Returns the number of significand bits of the float format \a width,
+/// counting the hidden bit, or 0 for an unsupported width.
+static unsigned getPrecision(Expr::Width width) {
+  switch (width) {
+  case Expr::Fl32: return 24;
+  case Expr::Fl64: return 53;
+  case Expr::Fl80: return 64;
+  default: return 0;
+  }
+}
+
+/// Returns true if every integer needing \a bits signed bits is exactly
+/// representable in the float format \a width and in an Int64.
+static bool isExact(unsigned bits, Expr::Width width) {
+  return bits <= Expr::Int64 && bits <= getPrecision(width) + 1;
+}
+
+class IntegralFloatRewriter : public ExprVisitor {
+private:
+  /// Analysis results, including failures (null value).
+  ExprHashMap<IntegralValue> integral;
+
+  bool getIntegral(const ref<Expr> &e, IntegralValue &result);
+  bool computeIntegral(const ref<Expr> &e, IntegralValue &result);
+
+public:
+  IntegralFloatRewriter() {}
+
+  Action visitExprPost(const Expr &e);
+};
+
+bool IntegralFloatRewriter::getIntegral(const ref<Expr> &e,
+                                        IntegralValue &result) {
+  ExprHashMap<IntegralValue>::iterator it = integral.find(e);
+  if (it == integral.end()) {
+    IntegralValue v;
+    if (!computeIntegral(e, v))
+      v = IntegralValue();
+    it = integral.insert(std::make_pair(e, v)).first;
+  }
+  result = it->second;
+  return !result.value.isNull();
+}
+
+bool IntegralFloatRewriter::computeIntegral(const ref<Expr> &e,
+                                            IntegralValue &result) {
+  Expr::Width width = e->getWidth();
+  if (!getPrecision(width))
+    return false;
+
+  switch (e->getKind()) {
+  case Expr::FConstant: {
+    // x87 constants may be unnormals, which APFloat does not model.
+    if (width == Expr::Fl80)
+      return false;
+    const llvm::APFloat &f = cast<FConstantExpr>(e)->getAPValue();
+    if (!f.isFinite())
+      return false;
+    uint64_t v = 0;
+    bool exact = false;
+    if (f.convertToInteger(&v, Expr::Int64, true, llvm::APFloat::rmTowardZero,
+                           &exact) != llvm::APFloat::opOK || !exact)
+      return false;
+    llvm::APInt ap(Expr::Int64, v);
+    result = IntegralValue(ConstantExpr::alloc(ap), ap.getMinSignedBits(),
+                           !ap.isNegative());
+    return true;
+  }
+
+  case Expr::SToF: {
+    ref<Expr> src = cast<SToFExpr>(e)->src;
+    unsigned bits = src->getWidth();
+    if (!isExact(bits, width))
+      return false;
+    result = IntegralValue(SExtExpr::create(src, Expr::Int64), bits, false);
+    return true;
+  }
+
+  case Expr::UToF: {
+    ref<Expr> src = cast<UToFExpr>(e)->src;
+    unsigned bits = src->getWidth() + 1;
+    if (!isExact(bits, width))
+      return false;
+    result = IntegralValue(ZExtExpr::create(src, Expr::Int64), bits, true);
+    return true;
+  }
+
+  case Expr::FExt: {
+    IntegralValue v;
+    if (!getIntegral(cast<FExtExpr>(e)->src, v) || !isExact(v.bits, width))
+      return false;
+    result = v;
+    return true;
+  }
+
+  case Expr::FNearbyInt:
+    return getIntegral(cast<FNearbyIntExpr>(e)->expr, result);
+
+  case Expr::FAbs: {
+    IntegralValue v;
+    if (!getIntegral(cast<FAbsExpr>(e)->expr, v) ||
+        !isExact(v.bits + 1, width))
+      return false;
+    if (v.nonNegative) {
+      result = v;
+      return true;
+    }
+    ref<Expr> zero = ConstantExpr::alloc(0, Expr::Int64);
+    result = IntegralValue(
+        SelectExpr::create(SltExpr::create(v.value, zero),
+                           SubExpr::create(zero, v.value), v.value),
+        v.bits + 1, true);
+    return true;
+  }
+
+  case Expr::FSelect: {
+    FSelectExpr *se = cast<FSelectExpr>(e);
+    IntegralValue t, f;
+    if (!getIntegral(se->trueExpr, t) || !getIntegral(se->falseExpr, f))
+      return false;
+    result = IntegralValue(SelectExpr::create(se->cond, t.value, f.value),
+                           std::max(t.bits, f.bits),
+                           t.nonNegative && f.nonNegative);
+    return true;
+  }
+
+  case Expr::FMin:
+  case Expr::FMax: {
+    FBinaryExpr *be = cast<FBinaryExpr>(e);
+    IntegralValue l, r;
+    if (!getIntegral(be->left, l) || !getIntegral(be->right, r))
+      return false;
+    ref<Expr> lt = SltExpr::create(l.value, r.value);
+    ref<Expr> v = e->getKind() == Expr::FMin
+                      ? SelectExpr::create(lt, l.value, r.value)
+                      : SelectExpr::create(lt, r.value, l.value);
+    result = IntegralValue(v, std::max(l.bits, r.bits),
+                           e->getKind() == Expr::FMin
+                               ? l.nonNegative && r.nonNegative
+                               : l.nonNegative || r.nonNegative);
+    return true;
+  }
+
+  case Expr::FAdd:
+  case Expr::FSub:
+  case Expr::FMul: {
+    // The rounding mode is irrelevant as long as the result is exact.
+    FBinaryExpr *be = cast<FBinaryExpr>(e);
+    IntegralValue l, r;
+    if (!getIntegral(be->left, l) || !getIntegral(be->right, r))
+      return false;
+    unsigned bits = e->getKind() == Expr::FMul
+                        ? l.bits + r.bits
+                        : std::max(l.bits, r.bits) + 1;
+    if (!isExact(bits, width))
+      return false;
+    switch (e->getKind()) {
+    case Expr::FAdd:
+      result = IntegralValue(AddExpr::create(l.value, r.value), bits,
+                             l.nonNegative && r.nonNegative);
+      break;
+    case Expr::FSub:
+      result = IntegralValue(SubExpr::create(l.value, r.value), bits, false);
+      break;
+    default:
+      result = IntegralValue(MulExpr::create(l.value, r.value), bits,
+                             l.nonNegative && r.nonNegative);
+      break;
+    }
+    return true;
+  }
+
+  case Expr::FFma: {
+    FFmaExpr *fe = cast<FFmaExpr>(e);
+    IntegralValue l, r, a;
+    if (!getIntegral(fe->left, l) || !getIntegral(fe->right, r) ||
+        !getIntegral(fe->addend, a))
+      return false;
+    unsigned bits = std::max(l.bits + r.bits, a.bits) + 1;
+    if (!isExact(bits, width))
+      return false;
+    result = IntegralValue(
+        AddExpr::create(MulExpr::create(l.value, r.value), a.value), bits,
+        l.nonNegative && r.nonNegative && a.nonNegative);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+ExprVisitor::Action IntegralFloatRewriter::visitExprPost(const Expr &e) {
+  ref<Expr> expr(const_cast<Expr *>(&e));
+  IntegralValue l, r;
+
+  switch (e.getKind()) {
+  case Expr::FToS:
+  case Expr::FToU: {
+    // Out of range conversions are undefined, so only rewrite those that
+    // are known to be in range.
+    const CastRoundExpr &ce = static_cast<const CastRoundExpr &>(e);
+    Expr::Width w = ce.getWidth();
+    if (w > Expr::Int64 || !getIntegral(ce.src, l))
+      return Action::doChildren();
+    if (e.getKind() == Expr::FToS ? l.bits > w
+                                  : !l.nonNegative || l.bits > w + 1)
+      return Action::doChildren();
+    ++stats::integralFloatRewrites;
+    return Action::changeTo(ExtractExpr::create(l.value, 0, w));
+  }
+
+  case Expr::FOrd: case Expr::FUno:
+  case Expr::FOeq: case Expr::FUeq:
+  case Expr::FOne: case Expr::FUne:
+  case Expr::FOlt: case Expr::FUlt:
+  case Expr::FOle: case Expr::FUle:
+  case Expr::FOgt: case Expr::FUgt:
+  case Expr::FOge: case Expr::FUge:
+    break;
+
+  default:
+    return Action::doChildren();
+  }
+
+  // Integral operands are never NaN, so ordered and unordered comparisons
+  // coincide.
+  if (!getIntegral(e.getKid(0), l) || !getIntegral(e.getKid(1), r))
+    return Action::doChildren();
+
+  ref<Expr> result;
+  switch (e.getKind()) {
+  case Expr::FOrd: result = ConstantExpr::alloc(1, Expr::Bool); break;
+  case Expr::FUno: result = ConstantExpr::alloc(0, Expr::Bool); break;
+  case Expr::FOeq: case Expr::FUeq:
+    result = EqExpr::create(l.value, r.value); break;
+  case Expr::FOne: case Expr::FUne:
+    result = NeExpr::create(l.value, r.value); break;
+  case Expr::FOlt: case Expr::FUlt:
+    result = SltExpr::create(l.value, r.value); break;
+  case Expr::FOle: case Expr::FUle:
+    result = SleExpr::create(l.value, r.value); break;
+  case Expr::FOgt: case Expr::FUgt:
+    result = SgtExpr::create(l.value, r.value); break;
+  default:
+    result = SgeExpr::create(l.value, r.value); break;
+  }
+  ++stats::integralFloatRewrites;
+  return Action::changeTo(result);
+}
+
+class IntegralFloatSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+  /// Rewrites the constraints and expression of \a query into \a
+  /// constraints and \a expr. Returns false if nothing changed.
+  bool rewrite(const Query &query, std::vector< ref<Expr> > &constraints,
+               ref<Expr> &expr);
+
+public:
+  IntegralFloatSolver(Solver *_solver) : solver(_solver) {}
+  ~IntegralFloatSolver() { delete solver; }
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+}
+
+bool IntegralFloatSolver::rewrite(const Query &query,
+                                  std::vector< ref<Expr> > &constraints,
+                                  ref<Expr> &expr) {
+  IntegralFloatRewriter rewriter;
+  bool changed = false;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it) {
+    ref<Expr> e = rewriter.visit(*it);
+    changed |= e != *it;
+    constraints.push_back(e);
+  }
+  expr = rewriter.visit(query.expr);
+  changed |= expr != query.expr;
+  if (changed)
+    ++stats::integralFloatQueries;
+  return changed;
+}
+
+bool IntegralFloatSolver::computeTruth(const Query& query, bool &isValid) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!rewrite(query, constraints, expr))
+    return solver->impl->computeTruth(query, isValid);
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeTruth(Query(tmp, expr), isValid);
+}
+
+bool IntegralFloatSolver::computeValidity(const Query& query,
+                                          Solver::Validity &result) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!rewrite(query, constraints, expr))
+    return solver->impl->computeValidity(query, result);
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValidity(Query(tmp, expr), result);
+}
+
+bool IntegralFloatSolver::computeValue(const Query& query, ref<Expr> &result) {
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!rewrite(query, constraints, expr))
+    return solver->impl->computeValue(query, result);
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeValue(Query(tmp, expr), result);
+}
+
+bool IntegralFloatSolver::computeInitialValues(const Query& query,
+                                               const std::vector<const Array*>
+                                                 &objects,
+                                               std::vector< std::vector<unsigned char> >
+                                                 &values,
+                                               bool &hasSolution) {
+  // The rewrite preserves the meaning of every symbolic byte, so a model of
+  // the rewritten query is a model of the original one.
+  std::vector< ref<Expr> > constraints;
+  ref<Expr> expr;
+  if (!rewrite(query, constraints, expr))
+    return solver->impl->computeInitialValues(query, objects, values,
+                                              hasSolution);
+  ConstraintManager tmp(constraints);
+  return solver->impl->computeInitialValues(Query(tmp, expr), objects, values,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus IntegralFloatSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *IntegralFloatSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void IntegralFloatSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+Solver *klee::createIntegralFloatSolver(Solver *s) {
+  return new Solver(new IntegralFloatSolver(s));
+}
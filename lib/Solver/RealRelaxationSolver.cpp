@@ -0,0 +1,562 @@
+//===-- RealRelaxationSolver.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// An incomplete solver for floating-point queries. The constraints are
+// relaxed to real arithmetic (rounding is ignored, NaNs and infinities do not
+// exist), the relaxation is solved by Z3 and the model is rounded to the
+// nearest floats. The rounded assignment is only used if it satisfies the
+// original query under IEEE semantics, so the relaxation never produces wrong
+// answers. Anything else, including an unsatisfiable relaxation, is left to
+// the bit-precise solver.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/Solver.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#ifdef ENABLE_Z3
+#include "Z3Builder.h"
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/IncompleteSolver.h"
+#include "klee/SolverStats.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprHashMap.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+llvm::cl::opt<unsigned>
+RealRelaxationTimeout("real-relaxation-timeout",
+                      llvm::cl::desc("Timeout in milliseconds for solving a "
+                                     "real arithmetic relaxation "
+                                     "(default=1000)"),
+                      llvm::cl::init(1000));
+
+/// A float the relaxation treats as a real variable, i.e. a bitcast of
+/// bytes read from an unmodified symbolic array at constant offsets.
+struct RelaxedFloat {
+  Expr::Width width;
+  Z3ASTHandle var;
+  /// The array and index of each byte, least significant byte first.
+  std::vector<std::pair<const Array *, unsigned> > bytes;
+};
+
+static const llvm::fltSemantics &floatSemantics(Expr::Width width) {
+  return width == Expr::Fl32 ? llvm::APFloat::IEEEsingle
+                             : llvm::APFloat::IEEEdouble;
+}
+
+/// Collects the bytes of \a e, most significant first, if it is a
+/// concatenation of reads from symbolic arrays at constant indices.
+static bool collectBytes(const ref<Expr> &e,
+                         std::vector<std::pair<const Array *, unsigned> > &bytes) {
+  if (ConcatExpr *ce = dyn_cast<ConcatExpr>(e))
+    return collectBytes(ce->getLeft(), bytes) &&
+           collectBytes(ce->getRight(), bytes);
+
+  ReadExpr *re = dyn_cast<ReadExpr>(e);
+  if (!re || re->getWidth() != Expr::Int8 || re->updates.head ||
+      re->updates.root->isConstantArray())
+    return false;
+  ConstantExpr *index = dyn_cast<ConstantExpr>(re->index);
+  if (!index)
+    return false;
+  bytes.push_back(std::make_pair(re->updates.root,
+                                 (unsigned) index->getZExtValue()));
+  return true;
+}
+}
+
+namespace klee {
+
+class RealRelaxationSolver : public IncompleteSolver {
+private:
+  enum QueryClass { Truth, Value, InitialValues, NumQueryClasses };
+
+  /// Only used for its context.
+  Z3Builder *builder;
+  ::Z3_params solverParameters;
+  Z3SortHandle realSort;
+  // Growth of the memory held by Z3 during the queries run in this context
+  // since it was (re)created, as in the core Z3 solver.
+  int64_t contextMemory;
+
+  uint64_t attempts[NumQueryClasses];
+  uint64_t hits[NumQueryClasses];
+
+  // Per query state
+  std::vector<RelaxedFloat> floats;
+  ExprHashMap<unsigned> floatIndex;
+  ExprHashMap<Z3ASTHandle> translated;
+
+  Z3ASTHandle realConstant(const llvm::APFloat &value, Expr::Width width);
+  bool translateFloat(const ref<Expr> &e, Z3ASTHandle &result);
+  bool translate(const ref<Expr> &e, Z3ASTHandle &result);
+  bool roundModel(::Z3_model model, Assignment &assignment);
+  bool solveRelaxation(const Query &query, bool checkExpr, QueryClass qc,
+                       Assignment &assignment);
+  bool findAssignment(const Query &query, bool checkExpr, QueryClass qc,
+                      Assignment &assignment);
+
+  void createContext();
+  void destroyContext();
+  void recycleContextIfNeeded(uint64_t memoryBeforeQuery);
+
+public:
+  RealRelaxationSolver();
+  ~RealRelaxationSolver();
+
+  IncompleteSolver::PartialValidity computeTruth(const Query&);
+  bool computeValue(const Query&, ref<Expr> &result);
+  bool computeInitialValues(const Query&,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+};
+
+RealRelaxationSolver::RealRelaxationSolver() : builder(0) {
+  createContext();
+  for (unsigned i = 0; i != NumQueryClasses; ++i)
+    attempts[i] = hits[i] = 0;
+}
+
+RealRelaxationSolver::~RealRelaxationSolver() {
+  static const char *names[NumQueryClasses] = { "truth", "value",
+                                                "initial values" };
+  for (unsigned i = 0; i != NumQueryClasses; ++i)
+    if (attempts[i])
+      klee_message("real relaxation: %lu/%lu %s queries answered (%.1f%%)",
+                   (unsigned long) hits[i], (unsigned long) attempts[i],
+                   names[i], 100. * hits[i] / attempts[i]);
+  destroyContext();
+}
+
+void RealRelaxationSolver::createContext() {
+  builder = new Z3Builder(/*autoClearConstructCache=*/false);
+  solverParameters = Z3_mk_params(builder->ctx);
+  Z3_params_inc_ref(builder->ctx, solverParameters);
+  Z3_params_set_uint(builder->ctx, solverParameters,
+                     Z3_mk_string_symbol(builder->ctx, "timeout"),
+                     RealRelaxationTimeout);
+  realSort = Z3SortHandle(Z3_mk_real_sort(builder->ctx), builder->ctx);
+  contextMemory = 0;
+}
+
+void RealRelaxationSolver::destroyContext() {
+  // Handles have to be released before the context goes away.
+  translated.clear();
+  floatIndex.clear();
+  floats.clear();
+  realSort = Z3SortHandle();
+  Z3_params_dec_ref(builder->ctx, solverParameters);
+  delete builder;
+  builder = 0;
+}
+
+/// Recreates the context once the queries run in it have grown the memory
+/// held by Z3 past --z3-max-context-memory. Nothing is kept across queries.
+void RealRelaxationSolver::recycleContextIfNeeded(uint64_t memoryBeforeQuery) {
+  if (!MaxZ3ContextMemory)
+    return;
+  contextMemory += (int64_t)(Z3_get_estimated_alloc_size() - memoryBeforeQuery);
+  if (contextMemory <= 0 ||
+      ((uint64_t)contextMemory >> 20) <= MaxZ3ContextMemory)
+    return;
+  ++stats::z3ContextRecycles;
+  destroyContext();
+  createContext();
+}
+
+/// Returns the exact rational value of a finite float.
+Z3ASTHandle RealRelaxationSolver::realConstant(const llvm::APFloat &value,
+                                               Expr::Width width) {
+  ::Z3_context ctx = builder->ctx;
+  Z3SortHandle sort(width == Expr::Fl32 ? Z3_mk_fpa_sort_32(ctx)
+                                        : Z3_mk_fpa_sort_64(ctx), ctx);
+  Z3ASTHandle fp(width == Expr::Fl32
+                     ? Z3_mk_fpa_numeral_float(ctx, value.convertToFloat(), sort)
+                     : Z3_mk_fpa_numeral_double(ctx, value.convertToDouble(),
+                                                sort), ctx);
+  Z3ASTHandle real(Z3_mk_fpa_to_real(ctx, fp), ctx);
+  return Z3ASTHandle(Z3_simplify(ctx, real), ctx);
+}
+
+bool RealRelaxationSolver::translateFloat(const ref<Expr> &e,
+                                          Z3ASTHandle &result) {
+  ExprHashMap<unsigned>::iterator it = floatIndex.find(e);
+  if (it != floatIndex.end()) {
+    result = floats[it->second].var;
+    return true;
+  }
+
+  RelaxedFloat rf;
+  rf.width = e->getWidth();
+  if (rf.width != Expr::Fl32 && rf.width != Expr::Fl64)
+    return false;
+  if (!collectBytes(cast<ExplicitFloatExpr>(e)->src, rf.bytes))
+    return false;
+  std::reverse(rf.bytes.begin(), rf.bytes.end());
+
+  ::Z3_context ctx = builder->ctx;
+  rf.var = Z3ASTHandle(Z3_mk_fresh_const(ctx, "f", realSort), ctx);
+  floatIndex.insert(std::make_pair(e, (unsigned) floats.size()));
+  floats.push_back(rf);
+  result = rf.var;
+  return true;
+}
+
+/// Translates \a e into real arithmetic. Returns false if \a e uses
+/// anything but floats, float arithmetic, comparisons and boolean logic.
+bool RealRelaxationSolver::translate(const ref<Expr> &e, Z3ASTHandle &result) {
+  ExprHashMap<Z3ASTHandle>::iterator it = translated.find(e);
+  if (it != translated.end()) {
+    result = it->second;
+    return true;
+  }
+
+  ::Z3_context ctx = builder->ctx;
+  Z3ASTHandle kids[3];
+  for (unsigned i = 0; i != e->getNumKids() && i != 3; ++i)
+    if (e->getKind() != Expr::ExplicitFloat &&
+        !translate(e->getKid(i), kids[i]))
+      return false;
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    if (e->getWidth() != Expr::Bool)
+      return false;
+    result = Z3ASTHandle(e->isTrue() ? Z3_mk_true(ctx) : Z3_mk_false(ctx),
+                         ctx);
+    break;
+
+  case Expr::FConstant: {
+    const llvm::APFloat &value = cast<FConstantExpr>(e)->getAPValue();
+    if ((e->getWidth() != Expr::Fl32 && e->getWidth() != Expr::Fl64) ||
+        value.isNaN() || value.isInfinity())
+      return false;
+    result = realConstant(value, e->getWidth());
+    break;
+  }
+
+  case Expr::ExplicitFloat:
+    if (!translateFloat(e, result))
+      return false;
+    break;
+
+  // Arithmetic, with rounding abstracted away
+  case Expr::FAdd: {
+    ::Z3_ast args[2] = { kids[0], kids[1] };
+    result = Z3ASTHandle(Z3_mk_add(ctx, 2, args), ctx);
+    break;
+  }
+  case Expr::FSub: {
+    ::Z3_ast args[2] = { kids[0], kids[1] };
+    result = Z3ASTHandle(Z3_mk_sub(ctx, 2, args), ctx);
+    break;
+  }
+  case Expr::FMul: {
+    ::Z3_ast args[2] = { kids[0], kids[1] };
+    result = Z3ASTHandle(Z3_mk_mul(ctx, 2, args), ctx);
+    break;
+  }
+  case Expr::FDiv:
+    result = Z3ASTHandle(Z3_mk_div(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::FFma: {
+    ::Z3_ast factors[2] = { kids[0], kids[1] };
+    Z3ASTHandle product(Z3_mk_mul(ctx, 2, factors), ctx);
+    ::Z3_ast args[2] = { product, kids[2] };
+    result = Z3ASTHandle(Z3_mk_add(ctx, 2, args), ctx);
+    break;
+  }
+  case Expr::FExt:
+    result = kids[0];
+    break;
+  case Expr::FAbs: {
+    Z3ASTHandle zero(Z3_mk_real(ctx, 0, 1), ctx);
+    Z3ASTHandle neg(Z3_mk_unary_minus(ctx, kids[0]), ctx);
+    Z3ASTHandle nonNegative(Z3_mk_ge(ctx, kids[0], zero), ctx);
+    result = Z3ASTHandle(Z3_mk_ite(ctx, nonNegative, kids[0], neg), ctx);
+    break;
+  }
+  case Expr::FMin:
+  case Expr::FMax: {
+    Z3ASTHandle pickLeft(e->getKind() == Expr::FMin
+                             ? Z3_mk_le(ctx, kids[0], kids[1])
+                             : Z3_mk_ge(ctx, kids[0], kids[1]), ctx);
+    result = Z3ASTHandle(Z3_mk_ite(ctx, pickLeft, kids[0], kids[1]), ctx);
+    break;
+  }
+  case Expr::FSelect:
+  case Expr::Select:
+    if (e->getWidth() != Expr::Bool && !isa<FExpr>(e))
+      return false;
+    result = Z3ASTHandle(Z3_mk_ite(ctx, kids[0], kids[1], kids[2]), ctx);
+    break;
+
+  // Comparisons; without NaNs ordered and unordered variants coincide
+  case Expr::FOrd:
+    result = Z3ASTHandle(Z3_mk_true(ctx), ctx);
+    break;
+  case Expr::FUno:
+    result = Z3ASTHandle(Z3_mk_false(ctx), ctx);
+    break;
+  case Expr::FOeq:
+  case Expr::FUeq:
+    result = Z3ASTHandle(Z3_mk_eq(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::FOne:
+  case Expr::FUne: {
+    Z3ASTHandle eq(Z3_mk_eq(ctx, kids[0], kids[1]), ctx);
+    result = Z3ASTHandle(Z3_mk_not(ctx, eq), ctx);
+    break;
+  }
+  case Expr::FOlt:
+  case Expr::FUlt:
+    result = Z3ASTHandle(Z3_mk_lt(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::FOle:
+  case Expr::FUle:
+    result = Z3ASTHandle(Z3_mk_le(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::FOgt:
+  case Expr::FUgt:
+    result = Z3ASTHandle(Z3_mk_gt(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::FOge:
+  case Expr::FUge:
+    result = Z3ASTHandle(Z3_mk_ge(ctx, kids[0], kids[1]), ctx);
+    break;
+
+  // Boolean structure
+  case Expr::Not:
+    if (e->getWidth() != Expr::Bool)
+      return false;
+    result = Z3ASTHandle(Z3_mk_not(ctx, kids[0]), ctx);
+    break;
+  case Expr::And:
+  case Expr::Or: {
+    if (e->getWidth() != Expr::Bool)
+      return false;
+    ::Z3_ast args[2] = { kids[0], kids[1] };
+    result = Z3ASTHandle(e->getKind() == Expr::And ? Z3_mk_and(ctx, 2, args)
+                                                   : Z3_mk_or(ctx, 2, args),
+                         ctx);
+    break;
+  }
+  case Expr::Xor:
+    if (e->getWidth() != Expr::Bool)
+      return false;
+    result = Z3ASTHandle(Z3_mk_xor(ctx, kids[0], kids[1]), ctx);
+    break;
+  case Expr::Eq:
+    if (e->getKid(0)->getWidth() != Expr::Bool)
+      return false;
+    result = Z3ASTHandle(Z3_mk_eq(ctx, kids[0], kids[1]), ctx);
+    break;
+
+  default:
+    return false;
+  }
+
+  translated.insert(std::make_pair(e, result));
+  return true;
+}
+
+/// Rounds the value of each relaxed float in \a model to the nearest float
+/// and stores its bytes in \a assignment.
+bool RealRelaxationSolver::roundModel(::Z3_model model,
+                                      Assignment &assignment) {
+  ::Z3_context ctx = builder->ctx;
+  for (std::vector<RelaxedFloat>::iterator it = floats.begin(),
+         ie = floats.end(); it != ie; ++it) {
+    ::Z3_ast value;
+    if (!Z3_model_eval(ctx, model, it->var, /*model_completion=*/Z3_TRUE,
+                       &value))
+      return false;
+    Z3ASTHandle valueHandle(value, ctx);
+    if (!Z3_is_numeral_ast(ctx, value) && !Z3_is_algebraic_number(ctx, value))
+      return false;
+
+    // Z3 marks truncated decimals with a trailing '?'
+    llvm::StringRef decimal(Z3_get_numeral_decimal_string(ctx, value, 40));
+    if (decimal.endswith("?"))
+      decimal = decimal.drop_back();
+    llvm::APFloat rounded(floatSemantics(it->width));
+    rounded.convertFromString(decimal, llvm::APFloat::rmNearestTiesToEven);
+    if (!rounded.isFinite())
+      return false;
+
+    llvm::APInt bits = rounded.bitcastToAPInt();
+    for (unsigned i = 0, e = it->bytes.size(); i != e; ++i) {
+      const Array *array = it->bytes[i].first;
+      unsigned index = it->bytes[i].second;
+      std::vector<unsigned char> &data = assignment.bindings[array];
+      if (data.size() != array->size)
+        data.resize(array->size, 0);
+      if (index >= data.size())
+        return false;
+      data[index] = bits.lshr(8 * i).getLoBits(8).getZExtValue();
+    }
+  }
+  return true;
+}
+
+/// Looks for an assignment that satisfies the constraints of \a query, and
+/// the negation of its expression if \a checkExpr is set, by solving the
+/// real relaxation and validating the rounded model.
+bool RealRelaxationSolver::findAssignment(const Query &query, bool checkExpr,
+                                          QueryClass qc,
+                                          Assignment &assignment) {
+  uint64_t memoryBeforeQuery = Z3_get_estimated_alloc_size();
+  bool success = solveRelaxation(query, checkExpr, qc, assignment);
+
+  translated.clear();
+  floatIndex.clear();
+  floats.clear();
+  recycleContextIfNeeded(memoryBeforeQuery);
+  return success;
+}
+
+bool RealRelaxationSolver::solveRelaxation(const Query &query, bool checkExpr,
+                                           QueryClass qc,
+                                           Assignment &assignment) {
+  ::Z3_context ctx = builder->ctx;
+
+  std::vector<Z3ASTHandle> formulas;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it) {
+    Z3ASTHandle f;
+    if (!translate(*it, f))
+      return false;
+    formulas.push_back(f);
+  }
+  if (checkExpr) {
+    Z3ASTHandle f;
+    if (!translate(query.expr, f))
+      return false;
+    formulas.push_back(Z3ASTHandle(Z3_mk_not(ctx, f), ctx));
+  }
+  // Purely integer queries are not worth relaxing.
+  if (floats.empty())
+    return false;
+
+  ++attempts[qc];
+  ++stats::realRelaxationQueries;
+
+  ::Z3_solver solver = Z3_mk_solver(ctx);
+  Z3_solver_inc_ref(ctx, solver);
+  Z3_solver_set_params(ctx, solver, solverParameters);
+  for (std::vector<Z3ASTHandle>::iterator it = formulas.begin(),
+         ie = formulas.end(); it != ie; ++it)
+    Z3_solver_assert(ctx, solver, *it);
+
+  // Keep the real values inside the range of their format.
+  for (std::vector<RelaxedFloat>::iterator it = floats.begin(),
+         ie = floats.end(); it != ie; ++it) {
+    llvm::APFloat largest =
+        llvm::APFloat::getLargest(floatSemantics(it->width));
+    Z3ASTHandle max = realConstant(largest, it->width);
+    Z3ASTHandle min(Z3_mk_unary_minus(ctx, max), ctx);
+    Z3ASTHandle belowMax(Z3_mk_le(ctx, it->var, max), ctx);
+    Z3ASTHandle aboveMin(Z3_mk_ge(ctx, it->var, min), ctx);
+    Z3_solver_assert(ctx, solver, belowMax);
+    Z3_solver_assert(ctx, solver, aboveMin);
+  }
+
+  bool success = false;
+  if (Z3_solver_check(ctx, solver) == Z3_L_TRUE) {
+    ::Z3_model model = Z3_solver_get_model(ctx, solver);
+    Z3_model_inc_ref(ctx, model);
+    success = roundModel(model, assignment);
+    Z3_model_dec_ref(ctx, model);
+  }
+  Z3_solver_dec_ref(ctx, solver);
+
+  // The rounded model has to satisfy the query under IEEE semantics.
+  if (success)
+    success = assignment.satisfies(query.constraints.begin(),
+                                   query.constraints.end());
+  if (success && checkExpr)
+    success = assignment.evaluate(query.expr)->isFalse();
+
+  if (success) {
+    ++hits[qc];
+    ++stats::realRelaxationHits;
+  }
+  return success;
+}
+
+IncompleteSolver::PartialValidity
+RealRelaxationSolver::computeTruth(const Query& query) {
+  Assignment assignment;
+  if (findAssignment(query, /*checkExpr=*/true, Truth, assignment))
+    return IncompleteSolver::MayBeFalse;
+  return IncompleteSolver::None;
+}
+
+bool RealRelaxationSolver::computeValue(const Query& query,
+                                        ref<Expr> &result) {
+  Assignment assignment;
+  if (!findAssignment(query, /*checkExpr=*/false, Value, assignment))
+    return false;
+
+  ref<Expr> value = assignment.evaluate(query.expr);
+  if (!isa<ConstantExpr>(value) && !isa<FConstantExpr>(value))
+    return false;
+  result = value;
+  return true;
+}
+
+bool
+RealRelaxationSolver::computeInitialValues(const Query& query,
+                                           const std::vector<const Array*>
+                                             &objects,
+                                           std::vector< std::vector<unsigned char> >
+                                             &values,
+                                           bool &hasSolution) {
+  Assignment assignment;
+  if (!findAssignment(query, /*checkExpr=*/true, InitialValues, assignment))
+    return false;
+
+  hasSolution = true;
+  for (unsigned i = 0; i != objects.size(); ++i) {
+    const Array *array = objects[i];
+    Assignment::bindings_ty::iterator it = assignment.bindings.find(array);
+    if (it != assignment.bindings.end())
+      values.push_back(it->second);
+    else
+      values.push_back(std::vector<unsigned char>(array->size, 0));
+  }
+  return true;
+}
+
+}
+
+Solver *klee::createRealRelaxationSolver(Solver *s) {
+  return new Solver(new StagedSolverImpl(new RealRelaxationSolver(), s));
+}
+
+#else
+
+Solver *klee::createRealRelaxationSolver(Solver *s) {
+  klee_warning("the real relaxation solver requires Z3, ignoring");
+  return s;
+}
+
+#endif // ENABLE_Z3
@@ -0,0 +1,65 @@
+//===-- SolverCache.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverCache.h"
+
+#include "klee/Solver.h"
+
+#include <cassert>
+#include <set>
+
+using namespace klee;
+
+static uint64_t totalBytes = 0;
+
+static std::set<SolverCache*> &getCaches() {
+  static std::set<SolverCache*> caches;
+  return caches;
+}
+
+SolverCache::SolverCache(uint64_t budgetMB)
+    : bytes(0), budget(budgetMB << 20) {
+  getCaches().insert(this);
+}
+
+SolverCache::~SolverCache() {
+  getCaches().erase(this);
+  totalBytes -= bytes;
+}
+
+void SolverCache::addBytes(uint64_t n) {
+  bytes += n;
+  totalBytes += n;
+}
+
+void SolverCache::removeBytes(uint64_t n) {
+  assert(n <= bytes && "cache accounting went negative");
+  bytes -= n;
+  totalBytes -= n;
+}
+
+uint64_t SolverCache::shrinkAll() {
+  uint64_t before = totalBytes;
+  for (std::set<SolverCache*>::iterator it = getCaches().begin(),
+         ie = getCaches().end(); it != ie; ++it)
+    (*it)->evict((*it)->bytes / 2);
+  return before - totalBytes;
+}
+
+uint64_t SolverCache::getTotalBytes() {
+  return totalBytes;
+}
+
+uint64_t klee::shrinkSolverCaches() {
+  return SolverCache::shrinkAll();
+}
+
+uint64_t klee::getSolverCacheMemoryUsage() {
+  return SolverCache::getTotalBytes();
+}
@@ -0,0 +1,57 @@
+//===-- SolverCache.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERCACHE_H
+#define KLEE_SOLVERCACHE_H
+
+#include <stdint.h>
+
+namespace klee {
+
+/// Memory accounting shared by the solver layers that memoize results. Each
+/// cache keeps an estimate of the bytes it holds and evicts its least
+/// recently used entries when it goes over its budget. All caches are
+/// registered so that shrinkSolverCaches() can release memory across them
+/// when the executor runs out of memory.
+class SolverCache {
+  uint64_t bytes;
+  uint64_t budget;
+
+protected:
+  /// \param budgetMB - The budget in megabytes, 0 for none.
+  SolverCache(uint64_t budgetMB);
+  virtual ~SolverCache();
+
+  void addBytes(uint64_t n);
+  void removeBytes(uint64_t n);
+
+  /// Evicts entries until at most target bytes are accounted, least recently
+  /// used first.
+  virtual void evict(uint64_t target) = 0;
+
+  /// Brings the cache back well under its budget once it exceeds it, so that
+  /// evictions happen in batches.
+  void enforceBudget() {
+    if (budget && bytes > budget)
+      evict(budget - budget / 4);
+  }
+
+public:
+  uint64_t getBytes() const { return bytes; }
+
+  /// Evicts about half of every cache. Returns the number of bytes released.
+  static uint64_t shrinkAll();
+
+  /// The bytes held by all caches.
+  static uint64_t getTotalBytes();
+};
+
+}
+
+#endif
@@ -11,6 +11,8 @@
 
 using namespace klee;
 
+Statistic stats::adaptiveBypassedQueries("AdaptiveBypassedQueries", "QABq");
+Statistic stats::adaptiveLayerBypasses("AdaptiveLayerBypasses", "QABl");
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
@@ -23,6 +25,11 @@ Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::integralFloatQueries("IntegralFloatQueries", "QIF");
+Statistic stats::integralFloatRewrites("IntegralFloatRewrites", "QIFrw");
+Statistic stats::realRelaxationHits("RealRelaxationHits", "QRRhits");
+Statistic stats::realRelaxationQueries("RealRelaxationQueries", "QRR");
+Statistic stats::z3ContextRecycles("Z3ContextRecycles", "Z3rc");
 
 #ifdef DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
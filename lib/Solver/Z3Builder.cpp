@@ -10,6 +10,7 @@
 #ifdef ENABLE_Z3
 #include "Z3Builder.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/Bits.h"
@@ -341,6 +342,19 @@ Z3ASTHandle Z3Builder::isFPNegativeExpr(Z3ASTHandle expr) {
   return Z3ASTHandle(Z3_mk_fpa_is_negative(ctx, expr), ctx);
 }
 
+Z3ASTHandle Z3Builder::flushDenormalExpr(Z3ASTHandle expr, int width) {
+  // x87 has no FTZ/DAZ
+  if (!FlushDenormals || (width != Expr::Fl32 && width != Expr::Fl64))
+    return expr;
+
+  Z3SortHandle sort(Z3_get_sort(ctx, expr), ctx);
+  return iteExpr(isSubnormalExpr(expr),
+                 iteExpr(isFPNegativeExpr(expr),
+                         Z3ASTHandle(Z3_mk_fpa_zero(ctx, sort, true), ctx),
+                         Z3ASTHandle(Z3_mk_fpa_zero(ctx, sort, false), ctx)),
+                 expr);
+}
+
 Z3_ast Z3Builder::getRoundingModeAST(llvm::APFloat::roundingMode rm) {
   switch (rm) {
   default:
@@ -365,6 +379,12 @@ Z3ASTHandle Z3Builder::fpZero(Z3SortHandle sort) {
   return Z3ASTHandle(Z3_mk_fpa_zero(ctx, sort, false), ctx);
 }
 
+Z3SortHandle Z3Builder::getFl80Sort() {
+  // the second parameter is the number of bits in the exponent, the third is
+  // the number of bits in the mantissa, *including* the hidden bit
+  return Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
+}
+
 Z3ASTHandle Z3Builder::writeExpr(Z3ASTHandle array, Z3ASTHandle index,
                                  Z3ASTHandle value) {
   return Z3ASTHandle(Z3_mk_store(ctx, array, index, value), ctx);
@@ -479,24 +499,33 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
 
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
-Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
+Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out,
+                                 Z3ASTHandle *unnormal_out) {
   // TODO: We could potentially use Z3_simplify() here
   // to store simpler expressions.
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
-    return constructActual(e, width_out);
+    return constructActual(e, width_out, unnormal_out);
   } else {
     ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
         constructed.find(e);
     if (it != constructed.end()) {
       if (width_out)
         *width_out = it->second.second;
+      if (unnormal_out && it->second.second == Expr::Fl80)
+        *unnormal_out = constructedUnnormal[e];
       return it->second.first;
     } else {
       int width;
       if (!width_out)
         width_out = &width;
-      Z3ASTHandle res = constructActual(e, width_out);
+      Z3ASTHandle unnormal;
+      Z3ASTHandle res = constructActual(e, width_out, &unnormal);
       constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      if (*width_out == Expr::Fl80) {
+        constructedUnnormal.insert(std::make_pair(e, unnormal));
+        if (unnormal_out)
+          *unnormal_out = unnormal;
+      }
       return res;
     }
   }
@@ -504,10 +533,14 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
 
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
-Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
+Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out,
+                                       Z3ASTHandle *unnormal_out) {
   int width;
   if (!width_out)
     width_out = &width;
+  Z3ASTHandle unnormal;
+  if (!unnormal_out)
+    unnormal_out = &unnormal;
 
   ++stats::queryConstructs;
 
@@ -556,25 +589,12 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
       mnt &= 0x7FFFFFFFFFFFFFFF;
 
-      Z3ASTHandle conv = Z3ASTHandle(Z3_mk_fpa_fp(ctx,
-                                                  Z3ASTHandle(Z3_mk_unsigned_int(ctx, sign, Z3_mk_bv_sort(ctx, 1)), ctx),
-                                                  Z3ASTHandle(Z3_mk_unsigned_int(ctx, exp, Z3_mk_bv_sort(ctx, 15)), ctx),
-                                                  Z3ASTHandle(Z3_mk_unsigned_int(ctx, mnt, Z3_mk_bv_sort(ctx, 63)), ctx)),
-                                     ctx);
-
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), conv);
-
-      if (correctHiddenBit) {
-        arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      }
-      else
-      {
-        arr = writeExpr(arr, bvOne(1), fpNan(sort));
-      }
-
-      return arr;
+      *unnormal_out = correctHiddenBit ? getFalse() : getTrue();
+      return Z3ASTHandle(Z3_mk_fpa_fp(ctx,
+                                      bvConst32(1, sign),
+                                      bvConst32(15, exp),
+                                      bvConst64(63, mnt)),
+                         ctx);
     }
     }
   }
@@ -582,7 +602,7 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
   // Special
   case Expr::NotOptimized: {
     NotOptimizedExpr *noe = cast<NotOptimizedExpr>(e);
-    return construct(noe->src, width_out);
+    return construct(noe->src, width_out, unnormal_out);
   }
 
   case Expr::Read: {
@@ -604,8 +624,11 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
   case Expr::FSelect: {
     FSelectExpr *se = cast<FSelectExpr>(e);
     Z3ASTHandle cond = construct(se->cond, 0);
-    Z3ASTHandle tExpr = construct(se->trueExpr, width_out);
-    Z3ASTHandle fExpr = construct(se->falseExpr, width_out);
+    Z3ASTHandle tUnnormal, fUnnormal;
+    Z3ASTHandle tExpr = construct(se->trueExpr, width_out, &tUnnormal);
+    Z3ASTHandle fExpr = construct(se->falseExpr, width_out, &fUnnormal);
+    if (*width_out == Expr::Fl80)
+      *unnormal_out = iteExpr(cond, tUnnormal, fUnnormal);
     return iteExpr(cond, tExpr, fExpr);
   }
 
@@ -660,7 +683,9 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
   case Expr::FExt: {
     FCastRoundExpr *ce = cast<FCastRoundExpr>(e);
     int srcWidth;
-    Z3ASTHandle src = construct(ce->src, &srcWidth);
+    Z3ASTHandle srcUnnormal;
+    Z3ASTHandle src = construct(ce->src, &srcWidth, &srcUnnormal);
+    src = flushDenormalExpr(src, srcWidth);
 
     *width_out = ce->getWidth();
 
@@ -675,45 +700,43 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     case Expr::Fl64:
       sort = Z3SortHandle(Z3_mk_fpa_sort_64(ctx), ctx);
       break;
-    case Expr::Fl80: {
-      sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), Z3ASTHandle(Z3_mk_fpa_to_fp_float(ctx, getRoundingModeAST(ce->getRoundingMode()), src, sort), ctx));
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
-    }
+    case Expr::Fl80:
+      sort = getFl80Sort();
+      *unnormal_out = getFalse();
+      break;
     case 128:
       sort = Z3SortHandle(Z3_mk_fpa_sort_128(ctx), ctx);
       break;
     }
 
+    // Narrowing can produce a denormal, flush it like the constant folding
+    // in FConstantExpr::FExt does.
+    Z3ASTHandle result = flushDenormalExpr(
+        Z3ASTHandle(Z3_mk_fpa_to_fp_float(
+                        ctx, getRoundingModeAST(ce->getRoundingMode()), src,
+                        sort),
+                    ctx),
+        *width_out);
+
     // casting unnormal f80s results in NaN
     if (srcWidth == Expr::Fl80)
-    {
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(src, bvOne(1)));
-      src = readExpr(src, bvZero(1));
-      return iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_to_fp_float(ctx, getRoundingModeAST(ce->getRoundingMode()), src, sort), ctx));
-    }
-    else
-    {
-      return Z3ASTHandle(Z3_mk_fpa_to_fp_float(ctx, getRoundingModeAST(ce->getRoundingMode()), src, sort), ctx);
-    }
+      return iteExpr(srcUnnormal, fpNan(sort), result);
+    return result;
   }
 
   case Expr::FToU: {
     int srcWidth;
     CastRoundExpr *ce = cast<CastRoundExpr>(e);
-    Z3ASTHandle src = construct(ce->src, &srcWidth);
+    Z3ASTHandle srcUnnormal;
+    Z3ASTHandle src = construct(ce->src, &srcWidth, &srcUnnormal);
+    src = flushDenormalExpr(src, srcWidth);
 
     *width_out = ce->getWidth();
 
     // casting unnormal f80s results in 0
     if (srcWidth == Expr::Fl80)
     {
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(src, bvOne(1)));
-      src = readExpr(src, bvZero(1));
-      return iteExpr(wrongHiddenBit, 
+      return iteExpr(srcUnnormal, 
                      bvZero(*width_out), 
                      Z3ASTHandle(Z3_mk_fpa_to_ubv(ctx, getRoundingModeAST(ce->getRoundingMode()), src, *width_out), ctx));
     }
@@ -726,15 +749,15 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
   case Expr::FToS: {
     int srcWidth;
     CastRoundExpr *ce = cast<CastRoundExpr>(e);
-    Z3ASTHandle src = construct(ce->src, &srcWidth);
+    Z3ASTHandle wrongHiddenBit;
+    Z3ASTHandle src = construct(ce->src, &srcWidth, &wrongHiddenBit);
+    src = flushDenormalExpr(src, srcWidth);
 
     *width_out = ce->getWidth();
 
     // casting unnormal f80s results in 0 for char and short, in the least value for int and long long 
     if (srcWidth == Expr::Fl80)
     {
-      Z3ASTHandle num = readExpr(src, bvZero(1));
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(src, bvOne(1)));
       if (*width_out == Expr::Int32)
       {
         return iteExpr(wrongHiddenBit,
@@ -777,14 +800,10 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     case Expr::Fl64:
       sort = Z3SortHandle(Z3_mk_fpa_sort_64(ctx), ctx);
       break;
-    case Expr::Fl80: {
-      sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), Z3ASTHandle(Z3_mk_fpa_to_fp_unsigned(ctx, getRoundingModeAST(ce->getRoundingMode()), src, sort), ctx));
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
-    }
+    case Expr::Fl80:
+      sort = getFl80Sort();
+      *unnormal_out = getFalse();
+      break;
     case 128:
       sort = Z3SortHandle(Z3_mk_fpa_sort_128(ctx), ctx);
       break;
@@ -810,14 +829,10 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     case Expr::Fl64:
       sort = Z3SortHandle(Z3_mk_fpa_sort_64(ctx), ctx);
       break;
-    case Expr::Fl80: {
-      sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), Z3ASTHandle(Z3_mk_fpa_to_fp_unsigned(ctx, getRoundingModeAST(ce->getRoundingMode()), src, sort), ctx));
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
-    }
+    case Expr::Fl80:
+      sort = getFl80Sort();
+      *unnormal_out = getFalse();
+      break;
     case 128:
       sort = Z3SortHandle(Z3_mk_fpa_sort_128(ctx), ctx);
       break;
@@ -844,22 +859,17 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
       break;
     case Expr::Fl80: {
       // turn the 80-bit bitvector into a 79-bit one, discarding the 63rd bit
-
-      // the second parameter is the number of bits in the exponent, the third is the number of bits in the mantissa, *including* the hidden bit
-      sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
+      sort = getFl80Sort();
 
       Z3ASTHandle sign = extractExpr(79, 79, src);
       Z3ASTHandle exp = extractExpr(78, 64, src);
       Z3ASTHandle hiddenBit = extractExpr(63, 63, src);
       Z3ASTHandle mnt = extractExpr(62, 0, src);
 
-      Z3ASTHandle correctHiddenBit = eqExpr(hiddenBit, iteExpr(eqExpr(bvRedorExpr(exp), bvZero(1)), bvZero(1), bvOne(1)));
-
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), Z3ASTHandle(Z3_mk_fpa_to_fp_bv(ctx, concatExpr(sign, exp, mnt), sort), ctx));
-      arr = writeExpr(arr, bvOne(1), iteExpr(correctHiddenBit, fpZero(sort), fpNan(sort)));
+      // the hidden bit has to be set iff the exponent is not all zeros
+      *unnormal_out = notExpr(eqExpr(hiddenBit, bvRedorExpr(exp)));
 
-      return arr;
+      return Z3ASTHandle(Z3_mk_fpa_fp(ctx, sign, exp, mnt), ctx);
     }
     case 128:
       sort = Z3SortHandle(Z3_mk_fpa_sort_128(ctx), ctx);
@@ -871,7 +881,8 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::ExplicitInt: {
     ExplicitIntExpr *ce = cast<ExplicitIntExpr>(e);
-    Z3ASTHandle src = construct(ce->src, width_out);
+    Z3ASTHandle srcUnnormal;
+    Z3ASTHandle src = construct(ce->src, width_out, &srcUnnormal);
 
     Z3ASTHandle ret = Z3ASTHandle(Z3_mk_fpa_to_ieee_bv(ctx, src), ctx);
 
@@ -881,10 +892,12 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
       Z3ASTHandle exp = extractExpr(77, 63, ret);
       Z3ASTHandle mnt = extractExpr(62, 0, ret);
 
-      // if the exponent is all zeros, bit 63 has to be 0, else it has to be 1
-      Z3ASTHandle ite = iteExpr(eqExpr(bvRedorExpr(exp), bvZero(1)), bvZero(1), bvOne(1));
+      // if the exponent is all zeros, bit 63 has to be 0, else it has to be 1;
+      // unnormals carry the opposite bit
+      Z3ASTHandle hiddenBit = bvRedorExpr(exp);
+      hiddenBit = iteExpr(srcUnnormal, bvNotExpr(hiddenBit), hiddenBit);
 
-      ret = concatExpr(sign, exp, ite, mnt);
+      ret = concatExpr(sign, exp, hiddenBit, mnt);
     }
 
     return ret;
@@ -893,21 +906,14 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
   // Floating-point special functions
   case Expr::FAbs: {
     FAbsExpr *fe = cast<FAbsExpr>(e);
-    Z3ASTHandle expr = construct(fe->expr, width_out);
+    // fabs doesn't care about unnormal f80s - probably just sets the sign bit
+    // without reading the rest, so the flag is passed through unchanged
+    Z3ASTHandle expr = construct(fe->expr, width_out, unnormal_out);
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FAbs");
 
-    // fabs doesn't care about unnormal f80s - probably just sets the sign bit without reading the rest
-    if (*width_out == Expr::Fl80)
-    {
-      expr = writeExpr(expr, bvZero(1), Z3ASTHandle(Z3_mk_fpa_abs(ctx, readExpr(expr, bvZero(1))), ctx));
-      return expr;
-    }
-    else
-    {
-      Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_abs(ctx, expr), ctx);
-      return result;
-    }
+    Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_abs(ctx, expr), ctx);
+    return result;
   }
 
   case Expr::FpClassify: {
@@ -916,10 +922,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FpClassify");
     // classification functions don't care about unnormal f80s (in Clang 3.4)
-    if (*width_out == Expr::Fl80)
-    {
-      expr = readExpr(expr, bvZero(1));
-    }
 
     *width_out = sizeof(int) * 8;
 
@@ -950,10 +952,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FIsFinite");
     // classification functions don't care about unnormal f80s (in Clang 3.4)
-    if (*width_out == Expr::Fl80)
-    {
-      expr = readExpr(expr, bvZero(1));
-    }
 
     *width_out = sizeof(int) * 8;
 
@@ -971,10 +969,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FIsNan");
     // classification functions don't care about unnormal f80s (in Clang 3.4)
-    if (*width_out == Expr::Fl80)
-    {
-      expr = readExpr(expr, bvZero(1));
-    }
 
     *width_out = sizeof(int) * 8;
 
@@ -988,7 +982,8 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FIsInf: {
     FIsInfExpr *fe = cast<FIsInfExpr>(e);
-    Z3ASTHandle expr = construct(fe->expr, width_out);
+    Z3ASTHandle wrongHiddenBit;
+    Z3ASTHandle expr = construct(fe->expr, width_out, &wrongHiddenBit);
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FIsInf");
     // isinf does care about unnormal f80s for some reason
@@ -997,9 +992,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     {
       *width_out = sizeof(int) * 8;
 
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(expr, bvOne(1)));
-      expr = readExpr(expr, bvZero(1));
       Z3ASTHandle result = iteExpr(wrongHiddenBit, bvZero(*width_out), iteExpr(isInfinityExpr(expr), iteExpr(isFPNegativeExpr(expr), bvMinusOne(*width_out), bvOne(*width_out)), bvZero(*width_out)));
       return result;
     }
@@ -1022,44 +1014,36 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FSqrt: {
     FSqrtExpr *fe = cast<FSqrtExpr>(e);
-    Z3ASTHandle expr = construct(fe->expr, width_out);
+    Z3ASTHandle wrongHiddenBit;
+    Z3ASTHandle expr = construct(fe->expr, width_out, &wrongHiddenBit);
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FSqrt");
+    expr = flushDenormalExpr(expr, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(expr, bvOne(1)));
-      expr = readExpr(expr, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_sqrt(ctx, getRoundingModeAST(fe->getRoundingMode()), expr), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_sqrt(ctx, getRoundingModeAST(fe->getRoundingMode()), expr), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_sqrt(ctx, getRoundingModeAST(fe->getRoundingMode()), expr), ctx);
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FNearbyInt: {
     FNearbyIntExpr *fe = cast<FNearbyIntExpr>(e);
-    Z3ASTHandle expr = construct(fe->expr, width_out);
+    Z3ASTHandle wrongHiddenBit;
+    Z3ASTHandle expr = construct(fe->expr, width_out, &wrongHiddenBit);
 
     assert((*width_out == Expr::Int32 || *width_out == Expr::Int64 || *width_out == Expr::Fl80) && "non-float argument to FNearbyInt");
+    expr = flushDenormalExpr(expr, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = isNanExpr(readExpr(expr, bvOne(1)));
-      expr = readExpr(expr, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_round_to_integral(ctx, getRoundingModeAST(fe->getRoundingMode()), expr), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_round_to_integral(ctx, getRoundingModeAST(fe->getRoundingMode()), expr), ctx));
     }
     else
     {
@@ -1271,154 +1255,134 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FAdd: {
     FAddExpr *fe = cast<FAddExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FAdd");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_add(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_add(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_add(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx);
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FSub: {
     FSubExpr *fe = cast<FSubExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FSub");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
     
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_sub(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_sub(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_sub(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx);
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FMul: {
     FMulExpr *fe = cast<FMulExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FMul");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_mul(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_mul(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_mul(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx);
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FDiv: {
     FDivExpr *fe = cast<FDivExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FDiv");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_div(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_div(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_div(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right), ctx);
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FRem: {
     FRemExpr *fe = cast<FRemExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FRem");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBit, fpNan(sort), Z3ASTHandle(Z3_mk_fpa_rem(ctx, left, right), ctx));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_rem(ctx, left, right), ctx));
     }
     else
     {
       Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_rem(ctx, left, right), ctx); // Z3's frem doesn't ask for rounding mode
-      return result;
+      return flushDenormalExpr(result, *width_out);
     }
   }
 
   case Expr::FMin: {
     FMinExpr *fe = cast<FMinExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle wrongHiddenBitLeft, wrongHiddenBitRight;
+    Z3ASTHandle left = construct(fe->left, width_out, &wrongHiddenBitLeft);
+    Z3ASTHandle right = construct(fe->right, width_out, &wrongHiddenBitRight);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FMin");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     // fmin is weird with unnormal f80s - if one operand is unnormal it returns the other operand, if both are unnormal it returns the left one
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBitLeft = isNanExpr(readExpr(left, bvOne(1)));
-      Z3ASTHandle wrongHiddenBitRight = isNanExpr(readExpr(right, bvOne(1)));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBitLeft, iteExpr(wrongHiddenBitRight, left, right), iteExpr(wrongHiddenBitRight, left, Z3ASTHandle(Z3_mk_fpa_min(ctx, left, right), ctx)));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBitLeft, iteExpr(wrongHiddenBitRight, left, right), iteExpr(wrongHiddenBitRight, left, Z3ASTHandle(Z3_mk_fpa_min(ctx, left, right), ctx)));
     }
     else
     {
@@ -1429,24 +1393,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FMax: {
     FMaxExpr *fe = cast<FMaxExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle wrongHiddenBitLeft, wrongHiddenBitRight;
+    Z3ASTHandle left = construct(fe->left, width_out, &wrongHiddenBitLeft);
+    Z3ASTHandle right = construct(fe->right, width_out, &wrongHiddenBitRight);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FMax");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     // fmax is weird with unnormal f80s - if one operand is unnormal it returns the other operand, if both are unnormal it returns the left one
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBitLeft = isNanExpr(readExpr(left, bvOne(1)));
-      Z3ASTHandle wrongHiddenBitRight = isNanExpr(readExpr(right, bvOne(1)));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-      Z3ASTHandle result = iteExpr(wrongHiddenBitLeft, iteExpr(wrongHiddenBitRight, left, right), iteExpr(wrongHiddenBitRight, left, Z3ASTHandle(Z3_mk_fpa_max(ctx, left, right), ctx)));
-      Z3ASTHandle arr = Z3ASTHandle(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, "[F80, unnormal]"), getArraySort(getBvSort(1), sort)), ctx);
-      arr = writeExpr(arr, bvZero(1), result);
-      arr = writeExpr(arr, bvOne(1), fpZero(sort));
-      return arr;
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBitLeft, iteExpr(wrongHiddenBitRight, left, right), iteExpr(wrongHiddenBitRight, left, Z3ASTHandle(Z3_mk_fpa_max(ctx, left, right), ctx)));
     }
     else
     {
@@ -1455,6 +1414,31 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     }
   }
 
+  case Expr::FFma: {
+    FFmaExpr *fe = cast<FFmaExpr>(e);
+    Z3ASTHandle leftUnnormal, rightUnnormal, addendUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
+    Z3ASTHandle addend = construct(fe->addend, width_out, &addendUnnormal);
+
+    assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FFma");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
+    addend = flushDenormalExpr(addend, *width_out);
+
+    if (*width_out == Expr::Fl80)
+    {
+      Z3ASTHandle wrongHiddenBit = orExpr(orExpr(leftUnnormal, rightUnnormal), addendUnnormal);
+      *unnormal_out = getFalse();
+      return iteExpr(wrongHiddenBit, fpNan(getFl80Sort()), Z3ASTHandle(Z3_mk_fpa_fma(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right, addend), ctx));
+    }
+    else
+    {
+      Z3ASTHandle result = Z3ASTHandle(Z3_mk_fpa_fma(ctx, getRoundingModeAST(fe->getRoundingMode()), left, right, addend), ctx);
+      return flushDenormalExpr(result, *width_out);
+    }
+  }
+
   // Comparison
 
   case Expr::Eq: {
@@ -1521,11 +1505,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOrd");
 
     // don't care about unnormal f80s, just act like isnan
-    if (*width_out == Expr::Fl80)
-    {
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-    }
 
     *width_out = 1;
     Z3ASTHandle result = andExpr(notExpr(isNanExpr(left)), notExpr(isNanExpr(right)));
@@ -1540,11 +1519,6 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUno");
 
     // don't care about unnormal f80s, just act like isnan
-    if (*width_out == Expr::Fl80)
-    {
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
-    }
 
     *width_out = 1;
     Z3ASTHandle result = orExpr(isNanExpr(left), isNanExpr(right));
@@ -1553,19 +1527,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUeq: {
     FUeqExpr *fe = cast<FUeqExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUeq");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_eq(ctx, left, right), ctx)));
     }
     else
@@ -1579,19 +1553,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOeq: {
     FOeqExpr *fe = cast<FOeqExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOeq");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), Z3ASTHandle(Z3_mk_fpa_eq(ctx, left, right), ctx));
     }
     else
@@ -1605,19 +1579,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUgt: {
     FUgtExpr *fe = cast<FUgtExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUgt");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_gt(ctx, left, right), ctx)));
     }
     else
@@ -1631,19 +1605,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOgt: {
     FOgtExpr *fe = cast<FOgtExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOgt");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), Z3ASTHandle(Z3_mk_fpa_gt(ctx, left, right), ctx));
     }
     else
@@ -1657,19 +1631,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUge: {
     FUgeExpr *fe = cast<FUgeExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUge");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_geq(ctx, left, right), ctx)));
     }
     else
@@ -1683,19 +1657,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOge: {
     FOgeExpr *fe = cast<FOgeExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOge");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), Z3ASTHandle(Z3_mk_fpa_geq(ctx, left, right), ctx));
     }
     else
@@ -1709,19 +1683,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUlt: {
     FUltExpr *fe = cast<FUltExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUlt");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_lt(ctx, left, right), ctx)));
     }
     else
@@ -1735,19 +1709,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOlt: {
     FOltExpr *fe = cast<FOltExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOlt");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), Z3ASTHandle(Z3_mk_fpa_lt(ctx, left, right), ctx));
     }
     else
@@ -1761,19 +1735,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUle: {
     FUleExpr *fe = cast<FUleExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUle");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_leq(ctx, left, right), ctx)));
     }
     else
@@ -1787,19 +1761,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOle: {
     FOleExpr *fe = cast<FOleExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOle");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       result = andExpr(notExpr(wrongHiddenBit), Z3ASTHandle(Z3_mk_fpa_leq(ctx, left, right), ctx));
     }
     else
@@ -1813,19 +1787,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FUne: {
     FUneExpr *fe = cast<FUneExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FUne");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       // != is the only comparison that is true for unnormal f80s
       result = orExpr(wrongHiddenBit, notExpr(Z3ASTHandle(Z3_mk_fpa_eq(ctx, left, right), ctx)));
     }
@@ -1840,19 +1814,19 @@ Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
 
   case Expr::FOne: {
     FOneExpr *fe = cast<FOneExpr>(e);
-    Z3ASTHandle left = construct(fe->left, width_out);
-    Z3ASTHandle right = construct(fe->right, width_out);
+    Z3ASTHandle leftUnnormal, rightUnnormal;
+    Z3ASTHandle left = construct(fe->left, width_out, &leftUnnormal);
+    Z3ASTHandle right = construct(fe->right, width_out, &rightUnnormal);
 
     assert((*width_out == Expr::Fl32 || *width_out == Expr::Fl64 || *width_out == Expr::Fl80) && "non-float argument to FOne");
+    left = flushDenormalExpr(left, *width_out);
+    right = flushDenormalExpr(right, *width_out);
 
     Z3ASTHandle result;
 
     if (*width_out == Expr::Fl80)
     {
-      Z3SortHandle sort = Z3SortHandle(Z3_mk_fpa_sort(ctx, 15, 64), ctx);
-      Z3ASTHandle wrongHiddenBit = orExpr(isNanExpr(readExpr(left, bvOne(1))), isNanExpr(readExpr(right, bvOne(1))));
-      left = readExpr(left, bvZero(1));
-      right = readExpr(right, bvZero(1));
+      Z3ASTHandle wrongHiddenBit = orExpr(leftUnnormal, rightUnnormal);
       // != is the only comparison that is true for unnormal f80s
       result = orExpr(wrongHiddenBit, notExpr(orExpr(isNanExpr(left), isNanExpr(right), Z3ASTHandle(Z3_mk_fpa_eq(ctx, left, right), ctx))));
     }
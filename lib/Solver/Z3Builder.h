@@ -107,6 +107,10 @@ public:
 
 class Z3Builder {
   ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  // x87 long doubles are encoded as a (15, 64) float plus a boolean that is
+  // true iff the value is an unnormal (wrong explicit integer bit). This maps
+  // constructed Fl80 expressions to that flag.
+  ExprHashMap<Z3ASTHandle> constructedUnnormal;
   Z3ArrayExprHash _arr_hash;
 
 private:
@@ -149,10 +153,13 @@ private:
   Z3ASTHandle isInfinityExpr(Z3ASTHandle expr);
   Z3ASTHandle isFPZeroExpr(Z3ASTHandle expr);
   Z3ASTHandle isSubnormalExpr(Z3ASTHandle expr);
+  /// Maps subnormal Fl32/Fl64 values to zero under -flush-denormals.
+  Z3ASTHandle flushDenormalExpr(Z3ASTHandle expr, int width);
   Z3ASTHandle isFPNegativeExpr(Z3ASTHandle expr);
   Z3_ast getRoundingModeAST(llvm::APFloat::roundingMode rm);
   Z3ASTHandle fpNan(Z3SortHandle sort);
   Z3ASTHandle fpZero(Z3SortHandle sort);
+  Z3SortHandle getFl80Sort();
 
   // Array operations
   Z3ASTHandle writeExpr(Z3ASTHandle array, Z3ASTHandle index,
@@ -178,8 +185,12 @@ private:
   Z3ASTHandle getInitialArray(const Array *os);
   Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
 
-  Z3ASTHandle constructActual(ref<Expr> e, int *width_out);
-  Z3ASTHandle construct(ref<Expr> e, int *width_out);
+  /// For expressions of width Fl80, \a unnormal_out (if non-null) receives a
+  /// boolean AST which is true iff the value is an unnormal long double.
+  Z3ASTHandle constructActual(ref<Expr> e, int *width_out,
+                              Z3ASTHandle *unnormal_out);
+  Z3ASTHandle construct(ref<Expr> e, int *width_out,
+                        Z3ASTHandle *unnormal_out = 0);
 
   Z3ASTHandle buildArray(const char *name, unsigned indexWidth,
                          unsigned valueWidth);
@@ -205,7 +216,10 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache() {
+    constructed.clear();
+    constructedUnnormal.clear();
+  }
 };
 }
 
@@ -8,16 +8,29 @@
 //===----------------------------------------------------------------------===//
 #include "klee/Config/config.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver.h"
 #ifdef ENABLE_Z3
 #include "Z3Builder.h"
+#include "klee/CommandLine.h"
 #include "klee/Constraints.h"
-#include "klee/Solver.h"
 #include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
+/// Z3 only reports how much it has allocated in the whole process, across
+/// all of its contexts. A context's growth is therefore estimated from the
+/// change in that figure over the queries run in it.
+llvm::cl::opt<unsigned> klee::MaxZ3ContextMemory(
+    "z3-max-context-memory",
+    llvm::cl::desc("Recreate a Z3 context once it has grown by more than "
+                   "this many megabytes, estimated from Z3's process-wide "
+                   "allocation during its queries (0=off, default=1024)"),
+    llvm::cl::init(1024));
+
 namespace klee {
 
 class Z3SolverImpl : public SolverImpl {
@@ -28,6 +41,15 @@ private:
   ::Z3_params solverParameters;
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
+  // Growth of the memory held by Z3 during the queries run in this context
+  // since it was (re)created. The estimate Z3 gives is for the whole
+  // process, so growth outside our queries, e.g. in the context of another
+  // solver, is not counted.
+  int64_t contextMemory;
+
+  void createContext();
+  void destroyContext();
+  void recycleContextIfNeeded(uint64_t memoryBeforeQuery);
 
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
@@ -65,18 +87,42 @@ public:
 };
 
 Z3SolverImpl::Z3SolverImpl()
-    : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+    : builder(0), timeout(0.0), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  createContext();
+}
+
+Z3SolverImpl::~Z3SolverImpl() { destroyContext(); }
+
+void Z3SolverImpl::createContext() {
+  builder = new Z3Builder(/*autoClearConstructCache=*/false);
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
   timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
   setCoreSolverTimeout(timeout);
+  contextMemory = 0;
 }
 
-Z3SolverImpl::~Z3SolverImpl() {
+void Z3SolverImpl::destroyContext() {
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
+  builder = 0;
+}
+
+/// Z3 keeps symbol tables, hash-consed terms and tactic caches alive for the
+/// lifetime of a context, even after we drop all our references. Nothing
+/// except the per-query construct cache is kept across queries, so the
+/// context can be thrown away and rebuilt between two queries.
+void Z3SolverImpl::recycleContextIfNeeded(uint64_t memoryBeforeQuery) {
+  if (!MaxZ3ContextMemory)
+    return;
+  contextMemory += (int64_t)(Z3_get_estimated_alloc_size() - memoryBeforeQuery);
+  if (contextMemory <= 0 ||
+      ((uint64_t)contextMemory >> 20) <= MaxZ3ContextMemory)
+    return;
+  ++stats::z3ContextRecycles;
+  destroyContext();
+  createContext();
 }
 
 Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
@@ -166,6 +212,7 @@ bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
   TimerStatIncrementer t(stats::queryTime);
+  uint64_t memoryBeforeQuery = Z3_get_estimated_alloc_size();
   // TODO: Does making a new solver for each query have a performance
   // impact vs making one global solver and using push and pop?
   // TODO: is the "simple_solver" the right solver to use for
@@ -208,6 +255,7 @@ bool Z3SolverImpl::internalRunSolver(
   // ``Query`` rather than only sharing within a single call to
   // ``builder->construct()``.
   builder->clearConstructCache();
+  recycleContextIfNeeded(memoryBeforeQuery);
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -300,3 +348,11 @@ SolverImpl::SolverRunStatus Z3SolverImpl::getOperationStatusCode() {
 }
 }
 #endif // ENABLE_Z3
+
+uint64_t klee::getSolverMemoryUsage() {
+#ifdef ENABLE_Z3
+  return Z3_get_estimated_alloc_size();
+#else
+  return 0;
+#endif
+}
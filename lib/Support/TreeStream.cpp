@@ -7,45 +7,20 @@
 //
 //===----------------------------------------------------------------------===//
 
-#define DEBUG_TYPE "TreeStreamWriter"
 #include "klee/Internal/ADT/TreeStream.h"
 
-#include "klee/Internal/Support/Debug.h"
-
+#include <algorithm>
 #include <cassert>
-#include <iomanip>
-#include <fstream>
-#include <iterator>
-#include <map>
-
-#include "llvm/Support/raw_ostream.h"
-#include <string.h>
 
 using namespace klee;
 
 ///
 
-TreeStreamWriter::TreeStreamWriter(const std::string &_path) 
-  : lastID(0),
-    bufferCount(0),
-    path(_path),
-    output(new std::ofstream(path.c_str(), 
-                             std::ios::out | std::ios::binary)),
-    ids(1) {
-  if (!output->good()) {
-    delete output;
-    output = 0;
-  }
+TreeStreamWriter::TreeStreamWriter() {
+  nodes.push_back(Node(0, 0));
 }
 
 TreeStreamWriter::~TreeStreamWriter() {
-  flush();
-  if (output)
-    delete output;
-}
-
-bool TreeStreamWriter::good() {
-  return !!output;
 }
 
 TreeOStream TreeStreamWriter::open() {
@@ -53,118 +28,113 @@ TreeOStream TreeStreamWriter::open() {
 }
 
 TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
-  assert(output && os.writer==this);
-  flushBuffer();
-  unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
-  return TreeOStream(*this, id);
-}
+  assert(os.writer==this && os.id<nodes.size() && !nodes[os.id].closed);
+  Node n(os.id, nodes[os.id].length);
 
-void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
-#if 1
-  if (bufferCount && 
-      (os.id!=lastID || size+bufferCount>bufferSize))
-    flushBuffer();
-  if (bufferCount) { // (os.id==lastID && size+bufferCount<=bufferSize)
-    memcpy(&buffer[bufferCount], s, size);
-    bufferCount += size;
-  } else if (size<bufferSize) {
-    lastID = os.id;
-    memcpy(buffer, s, size);
-    bufferCount = size;
+  TreeStreamID id;
+  if (freeIDs.empty()) {
+    id = nodes.size();
+    nodes.push_back(n);
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(buffer, size);
+    id = freeIDs.back();
+    freeIDs.pop_back();
+    nodes[id] = n;
   }
-#else
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  output->write(reinterpret_cast<const char*>(&size), 4);
-  output->write(s, size);
-#endif
+  nodes[os.id].children.push_back(id);
+  return TreeOStream(*this, id);
 }
 
-void TreeStreamWriter::flushBuffer() {
-  if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
-    bufferCount = 0;
+void TreeStreamWriter::close(TreeOStream &os) {
+  assert(os.writer==this && os.id>0 && os.id<nodes.size() &&
+         !nodes[os.id].closed && "closing a stream that is not open");
+  nodes[os.id].closed = true;
+  collapse(os.id);
+  os.writer = 0;
+  os.id = 0;
+}
+
+/// Releases the closed node \a id if it has no children, or merges it into
+/// its child if it has one, and continues with its parent.
+void TreeStreamWriter::collapse(TreeStreamID id) {
+  while (id && nodes[id].closed && nodes[id].children.size() <= 1) {
+    Node &n = nodes[id];
+    TreeStreamID parent = n.parent;
+    if (n.children.size() == 1) {
+      mergeIntoChild(id);
+      return;
+    }
+
+    std::vector<uint64_t>().swap(n.bits);
+    freeIDs.push_back(id);
+    std::vector<TreeStreamID> &siblings = nodes[parent].children;
+    siblings.erase(std::find(siblings.begin(), siblings.end(), id));
+    id = parent;
   }
 }
 
-void TreeStreamWriter::flush() {
-  flushBuffer();
-  output->flush();
+/// Moves the bits of the closed node \a id its only child shares into the
+/// child, which takes its place in the tree, and releases the node.
+void TreeStreamWriter::mergeIntoChild(TreeStreamID id) {
+  Node &n = nodes[id];
+  TreeStreamID childID = n.children[0];
+  Node &child = nodes[childID];
+
+  uint64_t shared = child.forkPosition;
+  std::vector<uint64_t> bits(n.bits.begin(),
+                             n.bits.begin() + (shared + 63) / 64);
+  if (shared % 64)
+    bits.back() &= ((uint64_t) 1 << (shared % 64)) - 1;
+  bits.resize((shared + child.length + 63) / 64);
+  for (uint64_t i = 0; i != child.length; ++i)
+    if ((child.bits[i / 64] >> (i % 64)) & 1)
+      bits[(shared + i) / 64] |= (uint64_t) 1 << ((shared + i) % 64);
+
+  child.bits.swap(bits);
+  child.length += shared;
+  child.parent = n.parent;
+  child.forkPosition = n.forkPosition;
+  for (std::vector<TreeStreamID>::iterator it = child.children.begin(),
+         ie = child.children.end(); it != ie; ++it)
+    nodes[*it].forkPosition += shared;
+
+  std::vector<TreeStreamID> &siblings = nodes[n.parent].children;
+  *std::find(siblings.begin(), siblings.end(), id) = childID;
+  std::vector<uint64_t>().swap(n.bits);
+  n.children.clear();
+  freeIDs.push_back(id);
+}
+
+void TreeStreamWriter::write(TreeOStream &os, bool bit) {
+  assert(os.id>0 && os.id<nodes.size() && "write to the root stream");
+  assert(!nodes[os.id].closed && "write to a closed stream");
+  Node &n = nodes[os.id];
+  unsigned offset = n.length % 64;
+  if (!offset)
+    n.bits.push_back(0);
+  if (bit)
+    n.bits.back() |= (uint64_t) 1 << offset;
+  ++n.length;
 }
 
 void TreeStreamWriter::readStream(TreeStreamID streamID,
-                                  std::vector<unsigned char> &out) {
-  assert(streamID>0 && streamID<ids);
-  flush();
-  
-  std::ifstream is(path.c_str(),
-                   std::ios::in | std::ios::binary);
-  assert(is.good());
-  KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
-
-  std::map<unsigned,unsigned> parents;
-  std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
-    } else {
-      unsigned size = tag;
-      while (size--) is.get();
-    }
+                                  std::vector<bool> &out) {
+  assert(streamID>0 && streamID<nodes.size() && !nodes[streamID].closed);
+
+  // Find the chain of nodes back to the root, and how much of each one
+  // belongs to this stream.
+  std::vector<std::pair<TreeStreamID, uint64_t> > chain;
+  uint64_t length = nodes[streamID].length;
+  for (TreeStreamID id = streamID; id; id = nodes[id].parent) {
+    chain.push_back(std::make_pair(id, length));
+    length = nodes[id].forkPosition;
+  }
+
+  for (std::vector<std::pair<TreeStreamID, uint64_t> >::reverse_iterator
+         it = chain.rbegin(), ie = chain.rend(); it != ie; ++it) {
+    const std::vector<uint64_t> &bits = nodes[it->first].bits;
+    for (uint64_t i = 0; i != it->second; ++i)
+      out.push_back((bits[i / 64] >> (i % 64)) & 1);
   }
-  KLEE_DEBUG({
-      llvm::errs() << "roots: ";
-      for (size_t i = 0, e = roots.size(); i < e; ++i) {
-        llvm::errs() << roots[i] << " ";
-      }
-      llvm::errs() << "\n";
-    });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-      if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-        roots.pop_back();
-    } else {
-      unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
-      }
-    }
-  }  
 }
 
 ///
@@ -187,19 +157,7 @@ unsigned TreeOStream::getID() const {
   return id;
 }
 
-void TreeOStream::write(const char *buffer, unsigned size) {
-  assert(writer);
-  writer->write(*this, buffer, size);
-}
-
-TreeOStream &TreeOStream::operator<<(const std::string &s) {
+void TreeOStream::writeBit(bool bit) {
   assert(writer);
-  write(s.c_str(), s.size());
-  return *this;
+  writer->write(*this, bit);
 }
-
-void TreeOStream::flush() {
-  assert(writer);
-  writer->flush();
-}
-
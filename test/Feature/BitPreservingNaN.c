@@ -0,0 +1,36 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --bit-preserving-nan --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SIGN 0x8000000000000000ULL
+
+static uint64_t bits(double d) {
+  uint64_t b;
+  memcpy(&b, &d, sizeof(b));
+  return b;
+}
+
+int main() {
+  double x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  uint64_t b = bits(x);
+
+  // fabs and fneg only touch the sign bit, so NaN payloads survive them. The
+  // solver leaves the bits of a NaN unspecified, so these only hold because
+  // the bitcasts fold to integer operations on the bits of x.
+  assert(bits(fabs(x)) == (b & ~SIGN));
+  if (b << 1) {
+    assert(bits(-x) == (b ^ SIGN));
+    assert(bits(-fabs(x)) == (b | SIGN));
+  }
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
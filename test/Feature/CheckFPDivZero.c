@@ -0,0 +1,18 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --check-fp-div-zero %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep -c div.err | grep 1
+
+#include "klee/klee.h"
+
+int main() {
+  double x, d;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&d, sizeof(d), "d");
+
+  // CHECK: CheckFPDivZero.c:15: divide by zero
+  volatile double q = x / d;
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
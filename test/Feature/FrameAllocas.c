@@ -0,0 +1,44 @@
+// RUN: %llvmgcc %s -emit-llvm -g -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+static void fill(int *a, unsigned n, int v) {
+  unsigned i;
+  for (i = 0; i < n; ++i)
+    a[i] = v + i;
+}
+
+// Counts the depths x is above. Every frame keeps a few locals in its frame
+// block, passes them to a callee and forks before recursing.
+static int walk(int depth, int x) {
+  int a[4], b[2];
+  char c;
+  int rest = 0;
+
+  fill(a, 4, depth);
+  fill(b, 2, -depth);
+  if (x > depth)
+    c = 1;
+  else
+    c = 0;
+  if (depth)
+    rest = walk(depth - 1, x);
+
+  assert(a[0] == depth && a[3] == depth + 3);
+  assert(b[0] == -depth && b[1] == 1 - depth);
+  return rest + c;
+}
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  int n = walk(10, x);
+  assert(n <= 11);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 12
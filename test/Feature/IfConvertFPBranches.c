@@ -0,0 +1,33 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --optimize --if-convert-fp-branches --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+__attribute__((noinline)) double clamp(double x, double lo, double hi) {
+  if (x < lo)
+    return lo;
+  if (x > hi)
+    return hi;
+  return x;
+}
+
+__attribute__((noinline)) double shape(double x) {
+  double y;
+  if (x < 0.0)
+    y = -x * 2.0 + 1.0;
+  else
+    y = x * 0.5;
+  return y;
+}
+
+int main() {
+  double x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+  // Without if-conversion both calls fork on x.
+  return clamp(shape(x), 0.0, 10.0) > 5.0;
+}
+// CHECK: KLEE: if-converted 1 branch in shape
+// CHECK: KLEE: done: completed paths = 1
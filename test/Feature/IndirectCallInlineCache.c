@@ -0,0 +1,36 @@
+// RUN: %llvmgcc %s -emit-llvm -g -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+static int add1(int x) { return x + 1; }
+static int add2(int x) { return x + 2; }
+static int add3(int x) { return x + 3; }
+static int add4(int x) { return x + 4; }
+static int add5(int x) { return x + 5; }
+
+static int call(int (*f)(int), int x) { return f(x); }
+
+#define is_symbolic ((int (*)(int)) klee_is_symbolic)
+
+int main() {
+  // More targets than the inline cache of the call site in call() holds,
+  // among them an external function and a special function.
+  int (*table[])(int) = { add1, add2, abs, add3, is_symbolic, add4, add5 };
+  int expected[] = { 11, 12, 10, 13, 0, 14, 15 };
+  unsigned n = sizeof(table) / sizeof(table[0]);
+
+  for (unsigned round = 0; round < 3; ++round)
+    for (unsigned i = 0; i < n; ++i)
+      assert(call(table[i], 10) == expected[i]);
+
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  assert(call(is_symbolic, x));
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 1
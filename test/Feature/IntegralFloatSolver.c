@@ -0,0 +1,27 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --use-integral-float-solver --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-ISTATS < %t.klee-out/run.istats %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  int i;
+  klee_make_symbolic(&i, sizeof(i), "i");
+
+  // Both comparisons only involve integers converted to double, so they are
+  // answered with bitvector arithmetic.
+  double d = i;
+  if (d * 2.0 > 100.0)
+    assert(i > 50);
+  else
+    assert((long long) d <= 50);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
+
+// CHECK-ISTATS: event: QIF : IntegralFloatQueries
+// CHECK-ISTATS: event: QIFrw : IntegralFloatRewrites
@@ -0,0 +1,25 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize=0 --long-double-as-double --exit-on-error %t1.bc
+// RUN: test -f %t.klee-out/test000001.precision
+
+#include <assert.h>
+
+int main() {
+  unsigned N = 0;
+
+  // With double precision this underflows as quickly as a double does.
+  long double V = .1;
+  while (V != 0) {
+    V *= V;
+    N++;
+  }
+  assert(N == 9);
+
+  // The in-memory layout of long double is unchanged.
+  long double A[2] = { 1.5, 2.5 };
+  assert(sizeof(A) == 2 * sizeof(long double));
+  assert(A[0] + A[1] == 4.0);
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --use-real-relaxation-solver --exit-on-error %t1.bc > %t.log 2>&1
+// RUN: FileCheck %s < %t.log
+// RUN: test -f %t.klee-out/test000003.ktest
+// RUN: not test -f %t.klee-out/test000004.ktest
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -DUNIQUE -o %t2.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --solver-backend=z3 --use-real-relaxation-solver --exit-on-error %t2.bc 2>&1 | FileCheck --check-prefix=CHECK-UNIQUE %s
+// RUN: %ktest-tool --write-ints %t.klee-out-2/test000001.ktest | FileCheck --check-prefix=CHECK-MODEL %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  float x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+
+#ifdef UNIQUE
+  // 1.5f is the only float whose double is 3.0f, so the test case has to
+  // hold exactly the model the relaxation rounded to.
+  klee_assume(x * 2.0f == 3.0f);
+  return 0;
+#endif
+
+  // Every branch condition is plain float arithmetic on symbolic bytes, so
+  // the relaxation sees all of them. Each model it hands out must satisfy
+  // the path under IEEE semantics, which the asserts re-check concretely.
+  if (x * 2.0f > 3.0f) {
+    if (x < 100.0f) {
+      assert(x > 1.5f && x < 100.0f);
+      return 1;
+    }
+    assert(x >= 100.0f);
+    return 2;
+  }
+  assert(!(x > 1.5f));
+  return 0;
+}
+// The counterexample cache turns every query into an initial values query.
+// CHECK: KLEE: real relaxation: {{[1-9][0-9]*}}/{{[0-9]+}} initial values queries answered
+// CHECK: KLEE: done: completed paths = 3
+
+// Every query was answered by the relaxation, including the test case.
+// CHECK-UNIQUE: KLEE: real relaxation: [[N:[0-9]+]]/[[N]] initial values queries answered
+// CHECK-UNIQUE: KLEE: done: completed paths = 1
+// CHECK-MODEL: data: 1069547520
@@ -0,0 +1,35 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --optimize --summarize-pure-functions --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+__attribute__((noinline)) double clamp(double x, double lo, double hi) {
+  if (x < lo)
+    return lo;
+  if (x > hi)
+    return hi;
+  return x;
+}
+
+__attribute__((noinline)) double lerp(double a, double b, double t) {
+  return a + (b - a) * t;
+}
+
+int main() {
+  double t;
+  klee_make_symbolic(&t, sizeof(t), "t");
+
+  // Without summaries every call to clamp forks three ways.
+  double y = clamp(lerp(0.0, 10.0, t), 0.0, 10.0);
+  double z = clamp(lerp(0.0, 10.0, t), 0.0, 10.0);
+
+  if (y == y)
+    assert(y >= 0.0 && y <= 10.0);
+  assert(y == z || y != y);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
@@ -0,0 +1,35 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --optimize --summarize-pure-functions --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+// The bitcast looks through the float wrapper of the parameter, the summary
+// still has to bind what is left of it to the argument.
+__attribute__((noinline)) int sign(double d) {
+  union {
+    double d;
+    int64_t i;
+  } u;
+  u.d = d;
+  return u.i < 0;
+}
+
+int main() {
+  double x;
+  int64_t bits;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  memcpy(&bits, &x, sizeof(bits));
+
+  if (sign(x))
+    assert(bits < 0);
+  else
+    assert(bits >= 0);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
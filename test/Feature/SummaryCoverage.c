@@ -0,0 +1,26 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize --summarize-pure-functions --write-cov --exit-on-error %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-COV < %t.klee-out/test000001.cov %s
+
+#include "klee/klee.h"
+
+// Calls to clamp are summarized rather than executed, the lines on the
+// feasible paths through it must still count as covered.
+__attribute__((noinline)) int clamp(int x, int lo, int hi) {
+  if (x < lo)
+    return lo;
+  if (x > hi)
+    return hi;
+  return x;
+}
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  return clamp(x, 0, 10) == 11;
+}
+// CHECK: KLEE: done: completed paths = 1
+
+// CHECK-COV: SummaryCoverage.c:11
+// CHECK-COV: SummaryCoverage.c:13
@@ -0,0 +1,27 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --optimize --summarize-pure-functions --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+// The truncation only reads the low byte of the parameter, which the summary
+// has to bind to the low byte of the argument.
+__attribute__((noinline)) unsigned char low(int x, int wide) {
+  if (wide)
+    return 255;
+  return (unsigned char) x;
+}
+
+int main() {
+  int x, wide;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&wide, sizeof(wide), "wide");
+
+  unsigned char c = low(x, wide);
+  if (!wide)
+    assert(c == (x & 0xff));
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
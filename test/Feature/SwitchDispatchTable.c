@@ -0,0 +1,44 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --switch-type=internal --exit-on-error %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  unsigned char op;
+  int kind;
+
+  klee_make_symbolic(&op, sizeof(op), "op");
+  klee_assume(op < 40);
+
+  switch (op) {
+  case 0 ... 9:
+    kind = 1;
+    break;
+  case 10:
+    kind = 2;
+    break;
+  case 20 ... 39:
+    kind = 3;
+    break;
+  // Not reachable under the assumption above.
+  case 100 ... 199:
+    kind = 4;
+    break;
+  case 250:
+    kind = 5;
+    break;
+  default:
+    kind = 0;
+    assert(op > 10 && op < 20);
+    break;
+  }
+
+  assert(kind != 4 && kind != 5);
+  if (kind == 3)
+    assert(op >= 20);
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 4
@@ -0,0 +1,27 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --switch-type=internal --write-paths --write-sym-paths %t.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000008.path
+// RUN: test -f %t.klee-out/test000008.sym.path
+
+#include "klee/klee.h"
+
+// The states a symbolic switch creates each need their own path streams:
+// they keep forking and terminate one after the other.
+int main() {
+  int x, y, r = 0;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  switch (x) {
+  case 1: r = 10; break;
+  case 2: r = 20; break;
+  case 3: r = 30; break;
+  default: r = 40; break;
+  }
+
+  if (y > r)
+    return 1;
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 8
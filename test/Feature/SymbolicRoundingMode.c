@@ -0,0 +1,30 @@
+// REQUIRES: z3
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-backend=z3 --symbolic-rounding-mode --exit-on-error %t1.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <fenv.h>
+
+int main() {
+  int mode;
+  klee_make_symbolic(&mode, sizeof(mode), "mode");
+  klee_assume((mode == FE_TONEAREST) | (mode == FE_UPWARD));
+
+  // The mode stays symbolic, so nothing forks here.
+  assert(fesetround(mode) == 0);
+
+  double one = 1.0, three = 3.0;
+  double third = one / three;
+
+  // Only rounding upwards overshoots.
+  if (third * three > one)
+    assert(fegetround() == FE_UPWARD);
+  else
+    assert(fegetround() == FE_TONEAREST);
+
+  return 0;
+}
+// CHECK: KLEE: done: completed paths = 2
@@ -1,10 +1,10 @@
 // RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t.bc
 // RUN: rm -rf %t.klee-out
 // RUN: %klee --output-dir=%t.klee-out -write-paths %t.bc 2> %t.log
-// RUN: cat %t.klee-out/test000001.path | wc -l | grep -q 1
-// RUN: cat %t.klee-out/test000002.path | wc -l | grep -q 1
-// RUN: cat %t.klee-out/test000003.path | wc -l | grep -q 1
-// RUN: cat %t.klee-out/test000004.path | wc -l | grep -q 1
+// RUN: head -n 1 %t.klee-out/test000001.path | grep -q "^klee-path 1$"
+// RUN: head -n 1 %t.klee-out/test000002.path | grep -q "^klee-path 1$"
+// RUN: head -n 1 %t.klee-out/test000003.path | grep -q "^klee-path 1$"
+// RUN: head -n 1 %t.klee-out/test000004.path | grep -q "^klee-path 1$"
 int main(){
 	int a, b;
 	klee_make_symbolic (&a, sizeof(int), "a");
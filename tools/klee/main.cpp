@@ -162,14 +162,20 @@ namespace {
 
   cl::opt<bool>
   CheckDivZero("check-div-zero",
-               cl::desc("Inject checks for division-by-zero"),
+               cl::desc("Check for division-by-zero"),
                cl::init(true));
 
   cl::opt<bool>
   CheckOvershift("check-overshift",
-               cl::desc("Inject checks for overshift"),
+               cl::desc("Check for overshift"),
                cl::init(true));
 
+  cl::opt<bool>
+  CheckFPDivZero("check-fp-div-zero",
+                 cl::desc("Check for floating-point division by zero "
+                          "(default=off)"),
+                 cl::init(false));
+
   cl::opt<std::string>
   OutputDir("output-dir",
             cl::desc("Directory to write results in (defaults to klee-out-N)"),
@@ -263,7 +269,9 @@ public:
   std::string getTestFilename(const std::string &suffix, unsigned id);
   llvm::raw_fd_ostream *openTestFile(const std::string &suffix, unsigned id);
 
-  // load a .path file
+  // write and load a .path file
+  static void writePathFile(llvm::raw_ostream &os,
+                            const std::vector<bool> &branches);
   static void loadPathFile(std::string name,
                            std::vector<bool> &buffer);
 
@@ -364,14 +372,12 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
 
   if (WritePaths) {
-    m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
-    assert(m_pathWriter->good());
+    m_pathWriter = new TreeStreamWriter();
     m_interpreter->setPathWriter(m_pathWriter);
   }
 
   if (WriteSymPaths) {
-    m_symPathWriter = new TreeStreamWriter(getOutputFilename("symPaths.ts"));
-    assert(m_symPathWriter->good());
+    m_symPathWriter = new TreeStreamWriter();
     m_interpreter->setSymbolicPathWriter(m_symPathWriter);
   }
 }
@@ -470,16 +476,20 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       delete f;
     }
 
+    if (m_interpreter->isLongDoubleDowngraded(state)) {
+      llvm::raw_ostream *f = openTestFile("precision", id);
+      *f << "x86_fp80 values were executed with double precision "
+            "(-long-double-as-double); replaying this test natively may "
+            "take a different path.\n";
+      delete f;
+    }
+
     if (m_pathWriter) {
-      std::vector<unsigned char> concreteBranches;
+      std::vector<bool> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
       llvm::raw_fd_ostream *f = openTestFile("path", id);
-      for (std::vector<unsigned char>::iterator I = concreteBranches.begin(),
-                                                E = concreteBranches.end();
-           I != E; ++I) {
-        *f << *I << "\n";
-      }
+      writePathFile(*f, concreteBranches);
       delete f;
     }
 
@@ -510,13 +520,11 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     }
 
     if (m_symPathWriter) {
-      std::vector<unsigned char> symbolicBranches;
+      std::vector<bool> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
                                   symbolicBranches);
       llvm::raw_fd_ostream *f = openTestFile("sym.path", id);
-      for (std::vector<unsigned char>::iterator I = symbolicBranches.begin(), E = symbolicBranches.end(); I!=E; ++I) {
-        *f << *I << "\n";
-      }
+      writePathFile(*f, symbolicBranches);
       delete f;
     }
 
@@ -548,6 +556,22 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   }
 }
 
+// A .path file starts with a "klee-path <number of branches>" line, followed
+// by the branches packed eight to a byte, the first one in the lowest bit.
+static const char pathFileMagic[] = "klee-path";
+
+void KleeHandler::writePathFile(llvm::raw_ostream &os,
+                                const std::vector<bool> &branches) {
+  os << pathFileMagic << " " << branches.size() << "\n";
+  for (size_t i = 0, e = branches.size(); i < e; i += 8) {
+    unsigned char byte = 0;
+    for (size_t j = i; j < e && j < i + 8; ++j)
+      if (branches[j])
+        byte |= 1 << (j - i);
+    os << byte;
+  }
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -556,11 +580,29 @@ void KleeHandler::loadPathFile(std::string name,
   if (!f.good())
     assert(0 && "unable to open path file");
 
-  while (f.good()) {
+  std::string magic;
+  f >> magic;
+  if (magic != pathFileMagic) {
+    // older text format, one branch per line
+    f.clear();
+    f.seekg(0, std::ios::beg);
     unsigned value;
-    f >> value;
-    buffer.push_back(!!value);
-    f.get();
+    while (f >> value)
+      buffer.push_back(!!value);
+    if (!f.eof())
+      klee_error("malformed path file: %s", name.c_str());
+    return;
+  }
+
+  size_t numBranches = 0;
+  if (!(f >> numBranches) || f.get() != '\n')
+    klee_error("malformed path file: %s", name.c_str());
+  for (size_t i = 0; i < numBranches; i += 8) {
+    int byte = f.get();
+    if (!f)
+      klee_error("truncated path file: %s", name.c_str());
+    for (size_t j = i; j < numBranches && j < i + 8; ++j)
+      buffer.push_back((byte >> (j - i)) & 1);
   }
 }
 
@@ -1335,7 +1377,8 @@ int main(int argc, char **argv, char **envp) {
   Interpreter::ModuleOptions Opts(LibraryDir.c_str(), EntryPoint,
                                   /*Optimize=*/OptimizeModule,
                                   /*CheckDivZero=*/CheckDivZero,
-                                  /*CheckOvershift=*/CheckOvershift);
+                                  /*CheckOvershift=*/CheckOvershift,
+                                  /*CheckFPDivZero=*/CheckFPDivZero);
 
   switch (Libc) {
   case NoLibc: /* silence compiler warning */
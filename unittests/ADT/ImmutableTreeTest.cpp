@@ -0,0 +1,136 @@
+//===-- ImmutableTreeTest.cpp -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef ImmutableMap<int, int> Map;
+typedef std::map<int, int> Reference;
+
+void expectSame(const Map &m, const Reference &r) {
+  ASSERT_EQ(r.size(), m.size());
+
+  Reference::const_iterator ri = r.begin();
+  for (Map::iterator it = m.begin(), ie = m.end(); it != ie; ++it, ++ri) {
+    EXPECT_EQ(ri->first, it->first);
+    EXPECT_EQ(ri->second, it->second);
+  }
+
+  // walk backwards from the end as well
+  Map::iterator it = m.end();
+  for (Reference::const_reverse_iterator rr = r.rbegin(), re = r.rend();
+       rr != re; ++rr) {
+    --it;
+    EXPECT_EQ(rr->first, it->first);
+  }
+
+  for (int k = -1; k <= 1000; k += 3) {
+    const Map::value_type *v = m.lookup(k);
+    Reference::const_iterator f = r.find(k);
+    ASSERT_EQ(f == r.end(), v == 0);
+    if (v) {
+      EXPECT_EQ(f->second, v->second);
+    }
+
+    const Map::value_type *p = m.lookup_previous(k);
+    Reference::const_iterator u = r.upper_bound(k);
+    if (u == r.begin()) {
+      EXPECT_TRUE(p == 0);
+    } else {
+      --u;
+      ASSERT_TRUE(p != 0);
+      EXPECT_EQ(u->first, p->first);
+    }
+
+    Map::iterator lb = m.lower_bound(k);
+    Reference::const_iterator rl = r.lower_bound(k);
+    ASSERT_EQ(rl == r.end(), lb == m.end());
+    if (rl != r.end()) {
+      EXPECT_EQ(rl->first, lb->first);
+    }
+
+    Map::iterator ub = m.upper_bound(k);
+    Reference::const_iterator ru = r.upper_bound(k);
+    ASSERT_EQ(ru == r.end(), ub == m.end());
+    if (ru != r.end()) {
+      EXPECT_EQ(ru->first, ub->first);
+    }
+  }
+}
+
+TEST(ImmutableTreeTest, Empty) {
+  Map m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(0u, m.size());
+  EXPECT_TRUE(m.begin() == m.end());
+  EXPECT_TRUE(m.lookup(0) == 0);
+  EXPECT_TRUE(m.lookup_previous(0) == 0);
+  EXPECT_TRUE(m.remove(0).empty());
+}
+
+TEST(ImmutableTreeTest, InsertKeepsExisting) {
+  Map m = Map().insert(std::make_pair(1, 1));
+  m = m.insert(std::make_pair(1, 2));
+  EXPECT_EQ(1, m.lookup(1)->second);
+  m = m.replace(std::make_pair(1, 2));
+  EXPECT_EQ(2, m.lookup(1)->second);
+}
+
+// Versions of the same tree must not see each other's modifications, through
+// enough insertions and removals to split and merge nodes at several levels.
+TEST(ImmutableTreeTest, Persistence) {
+  std::srand(1);
+  std::vector<Map> maps(1);
+  std::vector<Reference> refs(1);
+
+  for (int step = 0; step < 20000; ++step) {
+    unsigned which = std::rand() % maps.size();
+    int op = std::rand() % 10, key = std::rand() % 1000;
+    if (op == 0 && maps.size() < 8) {
+      maps.push_back(maps[which]);
+      refs.push_back(refs[which]);
+    } else if (op < 4) {
+      maps[which] = maps[which].insert(std::make_pair(key, step));
+      refs[which].insert(std::make_pair(key, step));
+    } else if (op < 6) {
+      maps[which] = maps[which].replace(std::make_pair(key, step));
+      refs[which][key] = step;
+    } else {
+      maps[which] = maps[which].remove(key);
+      refs[which].erase(key);
+    }
+  }
+
+  for (unsigned i = 0; i < maps.size(); ++i)
+    expectSame(maps[i], refs[i]);
+
+  for (unsigned i = 0; i < maps.size(); ++i) {
+    while (!refs[i].empty()) {
+      int key = (refs[i].size() % 2) ? refs[i].begin()->first
+                                     : refs[i].rbegin()->first;
+      maps[i] = maps[i].remove(key);
+      refs[i].erase(key);
+    }
+    expectSame(maps[i], refs[i]);
+  }
+
+  maps.clear();
+  EXPECT_EQ(0u, Map::getAllocated());
+}
+
+}
@@ -0,0 +1,218 @@
+//===-- MapOfSetsTest.cpp ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/MapOfSets.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef std::set<unsigned> Set;
+typedef MapOfSets<unsigned, int> Map;
+typedef std::vector<std::pair<Set, int> > Reference;
+
+struct Divisible {
+  int by;
+  Divisible(int _by) : by(_by) {}
+  bool operator()(int v) const { return v % by == 0; }
+};
+
+struct Negative {
+  bool operator()(int v) const { return v < 0; }
+};
+
+Set randomSet(unsigned maxSize, unsigned universe) {
+  Set s;
+  for (unsigned i = 0, n = rand() % (maxSize + 1); i < n; ++i)
+    s.insert(rand() % universe);
+  return s;
+}
+
+const Set *findSet(const Reference &r, int value) {
+  for (Reference::const_iterator it = r.begin(), ie = r.end(); it != ie; ++it)
+    if (it->second == value)
+      return &it->first;
+  return 0;
+}
+
+void checkSearches(Map &m, const Reference &r, const Set &query, int by) {
+  bool hasSubset = false, hasSuperset = false;
+  for (Reference::const_iterator it = r.begin(), ie = r.end(); it != ie; ++it) {
+    if (it->second % by)
+      continue;
+    if (std::includes(query.begin(), query.end(),
+                      it->first.begin(), it->first.end()))
+      hasSubset = true;
+    if (std::includes(it->first.begin(), it->first.end(),
+                      query.begin(), query.end()))
+      hasSuperset = true;
+  }
+
+  int *subset = m.findSubset(query, Divisible(by));
+  ASSERT_EQ(hasSubset, subset != 0);
+  if (subset) {
+    const Set *s = findSet(r, *subset);
+    ASSERT_TRUE(s != 0);
+    EXPECT_EQ(0, *subset % by);
+    EXPECT_TRUE(std::includes(query.begin(), query.end(),
+                              s->begin(), s->end()));
+  }
+
+  int *superset = m.findSuperset(query, Divisible(by));
+  ASSERT_EQ(hasSuperset, superset != 0);
+  if (superset) {
+    const Set *s = findSet(r, *superset);
+    ASSERT_TRUE(s != 0);
+    EXPECT_EQ(0, *superset % by);
+    EXPECT_TRUE(std::includes(s->begin(), s->end(),
+                              query.begin(), query.end()));
+  }
+}
+
+TEST(MapOfSetsTest, EmptySet) {
+  Map m;
+  Set empty, one;
+  one.insert(1);
+
+  EXPECT_EQ(0, m.findSubset(one, Divisible(1)));
+  EXPECT_EQ(0, m.findSuperset(empty, Divisible(1)));
+
+  m.insert(empty, 4);
+  ASSERT_TRUE(m.findSubset(one, Divisible(1)) != 0);
+  EXPECT_EQ(4, *m.findSubset(one, Divisible(1)));
+  EXPECT_EQ(4, *m.findSuperset(empty, Divisible(1)));
+  EXPECT_EQ(0, m.findSuperset(one, Divisible(1)));
+
+  m.insert(one, 6);
+  EXPECT_EQ(6, *m.findSuperset(one, Divisible(1)));
+  EXPECT_EQ(6, *m.findSubset(one, Divisible(3)));
+  EXPECT_EQ(0, m.findSubset(empty, Divisible(3)));
+}
+
+TEST(MapOfSetsTest, Overwrite) {
+  Map m;
+  Set s;
+  s.insert(3);
+  s.insert(5);
+  m.insert(s, 1);
+  m.insert(s, 2);
+  EXPECT_EQ(2, *m.lookup(s));
+  EXPECT_EQ(2, *m.findSubset(s, Divisible(1)));
+  EXPECT_EQ(1u, m.removeIf(Divisible(1)));
+  EXPECT_EQ(0, m.lookup(s));
+}
+
+TEST(MapOfSetsTest, RandomizedAgainstReference) {
+  srand(1);
+  Map m;
+  Reference r;
+
+  for (unsigned round = 0; round < 6; ++round) {
+    for (unsigned i = 0; i < 300; ++i) {
+      Set s = randomSet(6, 24);
+      if (m.lookup(s))
+        continue;
+      int value = r.size() + round * 1000 + 1;
+      m.insert(s, value);
+      r.push_back(std::make_pair(s, value));
+    }
+
+    for (unsigned i = 0; i < 300; ++i) {
+      Set query = randomSet(10, 24);
+      checkSearches(m, r, query, 1);
+      checkSearches(m, r, query, 7);
+    }
+
+    // drop a third of the entries and check everything still agrees
+    unsigned expected = 0;
+    for (Reference::iterator it = r.begin(); it != r.end();) {
+      if (it->second % 3 == 0) {
+        it = r.erase(it);
+        ++expected;
+      } else {
+        ++it;
+      }
+    }
+    EXPECT_EQ(expected, m.removeIf(Divisible(3)));
+    for (Reference::iterator it = r.begin(), ie = r.end(); it != ie; ++it) {
+      ASSERT_TRUE(m.lookup(it->first) != 0);
+      EXPECT_EQ(it->second, *m.lookup(it->first));
+    }
+  }
+
+  m.clear();
+  EXPECT_EQ(0, m.findSubset(randomSet(10, 24), Divisible(1)));
+  EXPECT_EQ(0, m.findSuperset(Set(), Divisible(1)));
+}
+
+// Models the counterexample cache of a long run: many paths share a prefix
+// of path constraints, every entry is such a prefix plus the constraints of
+// one query. Failing searches are the expensive ones, they report the
+// average time per search. It takes seconds and checks nothing the other
+// tests do not, run it with --gtest_also_run_disabled_tests.
+TEST(MapOfSetsTest, DISABLED_Benchmark) {
+  const unsigned numPaths = 500, depth = 200, numEntries = 100000;
+  const unsigned numSearches = 2000;
+  srand(2);
+
+  std::vector<std::vector<unsigned> > paths(numPaths);
+  unsigned nextKey = 0;
+  for (unsigned i = 0; i < numPaths; ++i) {
+    // paths fork from each other, sharing the prefix
+    if (i) {
+      const std::vector<unsigned> &parent = paths[rand() % i];
+      paths[i].assign(parent.begin(), parent.begin() + rand() % depth);
+    }
+    while (paths[i].size() < depth)
+      paths[i].push_back(nextKey++);
+  }
+
+  Map m;
+  for (unsigned i = 0; i < numEntries; ++i) {
+    const std::vector<unsigned> &path = paths[rand() % numPaths];
+    Set s(path.begin(), path.begin() + rand() % depth);
+    s.insert(nextKey + rand() % 10000);
+    m.insert(s, i);
+  }
+
+  std::vector<Set> queries;
+  for (unsigned i = 0; i < numSearches; ++i) {
+    const std::vector<unsigned> &path = paths[rand() % numPaths];
+    Set s(path.begin(), path.begin() + rand() % depth);
+    s.insert(nextKey + rand() % 10000);
+    queries.push_back(s);
+  }
+
+  std::clock_t start = std::clock();
+  for (unsigned i = 0; i < numSearches; ++i)
+    EXPECT_EQ(0, m.findSubset(queries[i], Negative()));
+  double subsetTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (unsigned i = 0; i < numSearches; ++i)
+    EXPECT_EQ(0, m.findSuperset(queries[i], Negative()));
+  double supersetTime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  std::cout << "MapOfSets with " << numEntries << " sets: "
+            << subsetTime * 1e6 / numSearches << "us per subset search, "
+            << supersetTime * 1e6 / numSearches
+            << "us per superset search\n";
+}
+
+}
@@ -0,0 +1,104 @@
+//===-- TreeStreamTest.cpp --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/TreeStream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+std::vector<bool> read(TreeStreamWriter &w, const TreeOStream &os) {
+  std::vector<bool> out;
+  w.readStream(os.getID(), out);
+  return out;
+}
+
+TEST(TreeStreamTest, SharedPrefix) {
+  TreeStreamWriter w;
+  TreeOStream a = w.open();
+  a.writeBit(true);
+  a.writeBit(false);
+  TreeOStream b = w.open(a);
+  a.writeBit(true);
+  b.writeBit(false);
+  b.writeBit(false);
+
+  bool expectedA[] = { true, false, true };
+  bool expectedB[] = { true, false, false, false };
+  EXPECT_EQ(std::vector<bool>(expectedA, expectedA + 3), read(w, a));
+  EXPECT_EQ(std::vector<bool>(expectedB, expectedB + 4), read(w, b));
+}
+
+TEST(TreeStreamTest, CloseKeepsSharedPrefix) {
+  TreeStreamWriter w;
+  TreeOStream a = w.open();
+  for (unsigned i = 0; i < 100; ++i)
+    a.writeBit(i % 3 == 0);
+  TreeOStream b = w.open(a);
+  a.writeBit(false);
+  b.writeBit(true);
+  TreeOStream c = w.open(b);
+  c.writeBit(false);
+  std::vector<bool> expectedB = read(w, b), expectedC = read(w, c);
+
+  // Closing a merges the prefix it shares with b into b.
+  w.close(a);
+  EXPECT_EQ(expectedB, read(w, b));
+  EXPECT_EQ(expectedC, read(w, c));
+
+  // Closing b leaves c as the only stream, in a single node.
+  w.close(b);
+  EXPECT_EQ(expectedC, read(w, c));
+  TreeOStream d = w.open();
+  TreeOStream e = w.open();
+  EXPECT_TRUE(d.getID() <= 3 && e.getID() <= 3);
+  EXPECT_TRUE(read(w, d).empty());
+}
+
+// Models a long run where states keep forking and terminating: the number of
+// nodes must stay bounded by the number of live streams, and every live
+// stream must still read back what was written to it.
+TEST(TreeStreamTest, TerminatedStreamsAreReleased) {
+  srand(1);
+  TreeStreamWriter w;
+  std::vector<TreeOStream> live(1, w.open());
+  std::vector<std::vector<bool> > reference(1);
+  unsigned maxID = 0;
+  for (unsigned i = 0; i < 20000; ++i) {
+    unsigned p = rand() % live.size();
+    bool bit = rand() % 2;
+    live[p].writeBit(bit);
+    reference[p].push_back(bit);
+    live.push_back(w.open(live[p]));
+    reference.push_back(reference[p]);
+
+    if (live.size() > 16) {
+      unsigned victim = rand() % live.size();
+      w.close(live[victim]);
+      live.erase(live.begin() + victim);
+      reference.erase(reference.begin() + victim);
+    }
+    for (unsigned j = 0; j != live.size(); ++j)
+      maxID = std::max(maxID, live[j].getID());
+    if (i % 1000 == 0) {
+      for (unsigned j = 0; j != live.size(); ++j) {
+        ASSERT_EQ(reference[j], read(w, live[j]));
+      }
+    }
+  }
+  EXPECT_LT(maxID, 64u);
+}
+
+}
@@ -10,6 +10,7 @@
 #include <iostream>
 #include "gtest/gtest.h"
 
+#include "klee/CommandLine.h"
 #include "klee/Expr.h"
 #include "klee/util/ArrayCache.h"
 
@@ -113,6 +114,105 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, BitcastRoundTrip) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr4", 256);
+  ref<Expr> read64 = Expr::createTempRead(array, 64);
+
+  ref<Expr> f = ExplicitFloatExpr::create(read64, Expr::Fl64);
+  EXPECT_EQ(Expr::ExplicitFloat, f->getKind());
+  EXPECT_EQ(read64, ExplicitIntExpr::create(f, Expr::Int64));
+
+  ref<Expr> fabs = FAbsExpr::create(f);
+  ref<Expr> i = ExplicitIntExpr::create(fabs, Expr::Int64);
+  EXPECT_EQ(Expr::ExplicitInt, i->getKind());
+  EXPECT_EQ(fabs, ExplicitFloatExpr::create(i, Expr::Fl64));
+}
+
+TEST(ExprTest, BitPreservingNaNSignFolds) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr7", 256);
+  ref<Expr> read64 = Expr::createTempRead(array, 64);
+  ref<Expr> f = ExplicitFloatExpr::create(read64, Expr::Fl64);
+  ref<Expr> negZero = FConstantExpr::alloc(
+      llvm::APFloat::getZero(llvm::APFloat::IEEEdouble, true));
+
+  BitPreservingNaN = true;
+  ref<Expr> neg = FSubExpr::create(negZero, f,
+                                   llvm::APFloat::rmNearestTiesToEven);
+  ref<Expr> bits = ExplicitIntExpr::create(neg, Expr::Int64);
+  EXPECT_EQ(Expr::Xor, bits->getKind());
+  EXPECT_EQ(neg, ExplicitFloatExpr::create(bits, Expr::Fl64));
+
+  // Rounded downward, -0.0 - -0.0 is -0.0, so this is not a sign flip.
+  ref<Expr> down = FSubExpr::create(negZero, f,
+                                    llvm::APFloat::rmTowardNegative);
+  EXPECT_EQ(Expr::ExplicitInt,
+            ExplicitIntExpr::create(down, Expr::Int64)->getKind());
+
+  ref<Expr> abs = ExplicitIntExpr::create(FAbsExpr::create(f), Expr::Int64);
+  EXPECT_EQ(Expr::And, abs->getKind());
+  EXPECT_EQ(Expr::FAbs, ExplicitFloatExpr::create(abs, Expr::Fl64)->getKind());
+  BitPreservingNaN = false;
+}
+
+TEST(ExprTest, FusedMultiplyAdd) {
+  const llvm::APFloat::roundingMode rm = llvm::APFloat::rmNearestTiesToEven;
+  ref<Expr> a = FConstantExpr::alloc(llvm::APFloat(1.0 + 0x1p-52));
+  ref<Expr> b = FConstantExpr::alloc(llvm::APFloat(1.0 - 0x1p-52));
+  ref<Expr> c = FConstantExpr::alloc(llvm::APFloat(-1.0));
+
+  // a * b rounds to 1, only the fused operation keeps the low bits
+  ref<Expr> unfused = FAddExpr::create(FMulExpr::create(a, b, rm), c, rm);
+  EXPECT_TRUE(cast<FConstantExpr>(unfused)->getAPValue().isZero());
+  ref<Expr> fused = FFmaExpr::create(a, b, c, rm);
+  EXPECT_EQ(-0x1p-104,
+            cast<FConstantExpr>(fused)->getAPValue().convertToDouble());
+
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr6", 256);
+  ref<Expr> f = ExplicitFloatExpr::create(Expr::createTempRead(array, 64),
+                                          Expr::Fl64);
+  EXPECT_EQ(Expr::FFma, FFmaExpr::create(f, b, c, rm)->getKind());
+}
+
+TEST(ExprTest, RoundingModeEquality) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr5", 256);
+  ref<Expr> f = ExplicitFloatExpr::create(Expr::createTempRead(array, 64),
+                                          Expr::Fl64);
+  ref<Expr> c = Expr::createTempRead(array, Expr::Bool);
+
+  ref<Expr> up = FAddExpr::create(f, f, llvm::APFloat::rmTowardPositive);
+  ref<Expr> down = FAddExpr::create(f, f, llvm::APFloat::rmTowardNegative);
+  EXPECT_NE(up, down);
+  EXPECT_EQ(up, FAddExpr::create(f, f, llvm::APFloat::rmTowardPositive));
+  EXPECT_EQ(Expr::FSelect, FSelectExpr::create(c, up, down)->getKind());
+
+  ref<Expr> s = SToFExpr::create(Expr::createTempRead(array, 64), Expr::Fl32,
+                                 llvm::APFloat::rmTowardZero);
+  EXPECT_NE(s, SToFExpr::create(Expr::createTempRead(array, 64), Expr::Fl32,
+                                llvm::APFloat::rmNearestTiesToEven));
+}
+
+TEST(ExprTest, FlushDenormals) {
+  ref<Expr> tiny = FConstantExpr::alloc(
+      llvm::APFloat::getSmallest(llvm::APFloat::IEEEdouble, true));
+  ref<Expr> one = FConstantExpr::alloc(llvm::APFloat(1.0));
+
+  ref<Expr> product = FMulExpr::create(tiny, one,
+                                       llvm::APFloat::rmNearestTiesToEven);
+  EXPECT_TRUE(cast<FConstantExpr>(product)->getAPValue().isDenormal());
+
+  FlushDenormals = true;
+  product = FMulExpr::create(tiny, one, llvm::APFloat::rmNearestTiesToEven);
+  EXPECT_TRUE(cast<FConstantExpr>(product)->getAPValue().isZero());
+  EXPECT_TRUE(cast<FConstantExpr>(product)->getAPValue().isNegative());
+  EXPECT_TRUE(FOeqExpr::create(tiny, FConstantExpr::alloc(
+      llvm::APFloat::getZero(llvm::APFloat::IEEEdouble)))->isTrue());
+  FlushDenormals = false;
+}
+
 TEST(ExprTest, ReadExprFoldingBasic) {
   unsigned size = 5;
 
@@ -14,9 +14,13 @@
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
 #include "klee/util/ArrayCache.h"
 #include "llvm/ADT/StringExtras.h"
 
+#include <unistd.h>
+
 using namespace klee;
 
 namespace {
@@ -166,4 +170,140 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+/// Answers every query as invalid after sleeping for a fixed time.
+class SleepingSolver : public SolverImpl {
+  Solver *below;
+  unsigned delay;
+
+public:
+  /// Forwards to \a _below if it is not null, after sleeping.
+  SleepingSolver(Solver *_below, unsigned _delay)
+      : below(_below), delay(_delay) {}
+  ~SleepingSolver() { delete below; }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    usleep(delay);
+    if (below)
+      return below->impl->computeTruth(query, isValid);
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    usleep(delay);
+    if (below)
+      return below->impl->computeValue(query, result);
+    result = ConstantExpr::alloc(0, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    usleep(delay);
+    if (below)
+      return below->impl->computeInitialValues(query, objects, values,
+                                               hasSolution);
+    values.clear();
+    for (unsigned i = 0; i != objects.size(); ++i)
+      values.push_back(std::vector<unsigned char>(objects[i]->size));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+/// A layer that only adds time in front of the solver below it.
+Solver *createSlowLayer(Solver *s) {
+  return new Solver(new SleepingSolver(s, 2000));
+}
+
+/// A layer that answers every query itself, like a cache that always hits.
+Solver *createCachingLayer(Solver *s) {
+  delete s;
+  return new Solver(new SleepingSolver(0, 0));
+}
+
+/// Runs two windows of truth queries through an adaptive solver over a
+/// direct solver taking 2ms a query. Returns how many times the layer was
+/// bypassed and, in the second window, how many queries skipped it.
+void runAdaptiveSolver(Solver *(*createLayer)(Solver *),
+                       uint64_t &layerBypasses,
+                       uint64_t &bypassedQueries) {
+  AdaptiveSolverWindow = 20;
+  Solver *solver = createAdaptiveSolver(
+      new Solver(new SleepingSolver(0, 2000)), createLayer, "test");
+  const Array *array = ac.CreateArray("adaptive", 1);
+  ref<Expr> expr = EqExpr::create(Expr::createTempRead(array, Expr::Int8),
+                                  ConstantExpr::alloc(1, Expr::Int8));
+  ConstraintManager constraints;
+  bool result;
+
+  uint64_t bypassesBefore = stats::adaptiveLayerBypasses;
+  for (unsigned i = 0; i != 20; ++i)
+    ASSERT_TRUE(solver->mustBeTrue(Query(constraints, expr), result));
+  layerBypasses = stats::adaptiveLayerBypasses - bypassesBefore;
+
+  uint64_t queriesBefore = stats::adaptiveBypassedQueries;
+  for (unsigned i = 0; i != 20; ++i)
+    ASSERT_TRUE(solver->mustBeTrue(Query(constraints, expr), result));
+  bypassedQueries = stats::adaptiveBypassedQueries - queriesBefore;
+
+  delete solver;
+  AdaptiveSolverWindow = 200;
+}
+
+TEST(SolverTest, AdaptiveSolverBypassesCostlyLayer) {
+  uint64_t layerBypasses, bypassedQueries;
+  runAdaptiveSolver(createSlowLayer, layerBypasses, bypassedQueries);
+  EXPECT_EQ(1u, layerBypasses);
+  EXPECT_EQ(20u, bypassedQueries);
+}
+
+TEST(SolverTest, AdaptiveSolverKeepsProfitableLayer) {
+  uint64_t layerBypasses, bypassedQueries;
+  runAdaptiveSolver(createCachingLayer, layerBypasses, bypassedQueries);
+  EXPECT_EQ(0u, layerBypasses);
+  EXPECT_EQ(0u, bypassedQueries);
+}
+
+#ifdef ENABLE_Z3
+// Narrowing an x87 value to double can produce a denormal. The solver has to
+// flush it under -flush-denormals exactly like constant folding does.
+TEST(SolverTest, FExtFromFl80FlushesDenormals) {
+  Solver *solver = new Z3Solver();
+
+  llvm::APFloat tiny(llvm::APFloat::x87DoubleExtended, "0x1p-1060");
+  const Array *array = ac.CreateArray("fl80", 10);
+  ref<Expr> bits = Expr::createTempRead(array, Expr::Fl80);
+  ConstraintManager constraints;
+  constraints.addConstraint(
+      EqExpr::create(bits, ConstantExpr::alloc(tiny.bitcastToAPInt())));
+
+  for (unsigned flush = 0; flush != 2; ++flush) {
+    FlushDenormals = flush != 0;
+    ref<Expr> folded = ExplicitIntExpr::create(
+        FExtExpr::create(FConstantExpr::alloc(tiny), Expr::Fl64,
+                         llvm::APFloat::rmNearestTiesToEven),
+        Expr::Int64);
+    ref<Expr> solved = ExplicitIntExpr::create(
+        FExtExpr::create(ExplicitFloatExpr::create(bits, Expr::Fl80),
+                         Expr::Fl64, llvm::APFloat::rmNearestTiesToEven),
+        Expr::Int64);
+
+    ref<Expr> value;
+    ASSERT_TRUE(solver->getValue(Query(constraints, solved), value));
+    ASSERT_TRUE(isa<ConstantExpr>(folded));
+    uint64_t bitsFolded = cast<ConstantExpr>(folded)->getZExtValue();
+    uint64_t bitsSolved = cast<ConstantExpr>(value)->getZExtValue();
+    EXPECT_EQ(bitsFolded, bitsSolved);
+    EXPECT_EQ(flush != 0, bitsSolved == 0);
+  }
+  FlushDenormals = false;
+
+  delete solver;
+}
+#endif
+
 }